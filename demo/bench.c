@@ -0,0 +1,605 @@
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "body.h"
+#include "collision.h"
+#include "entities.h"
+#include "forces.h"
+#include "gravity.h"
+#include "list.h"
+#include "polygon.h"
+#include "scene.h"
+#include "sim.h"
+#include "snapshot.h"
+#include "timer.h"
+#include "vector.h"
+
+const vector_t BENCH_MIN = {0, 0};
+const vector_t BENCH_MAX = {1000, 500};
+const size_t DEFAULT_REPETITIONS = 15;
+const size_t DEFAULT_WARMUP = 3;
+const double MIN_BATCH_TIME = 0.005; // seconds; batches are sized to this
+const size_t MAX_BATCH_ITERATIONS = 1 << 24;
+const double BENCH_DT = 1.0 / 60;
+const unsigned int BENCH_SEED = 1;
+const double BENCH_ASTEROID_DENSITY = 0.1;
+const double BENCH_DRAG = 30;
+const double BENCH_G = 1e3;
+const double BENCH_SOFTENING = 20;
+const double BENCH_THETA = 0.5;
+const double BENCH_CELL_SIZE = 10;
+const size_t BENCH_SAMPLE_POINTS = 1024;
+// two-sided 95% Student-t critical values, indexed by degrees of freedom
+// minus 1; more degrees of freedom use the normal value Z_95
+const double T_95[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365,
+                       2.306,  2.262, 2.228, 2.201, 2.179, 2.160, 2.145,
+                       2.131,  2.120, 2.110, 2.101, 2.093, 2.086, 2.080,
+                       2.074,  2.069, 2.064, 2.060, 2.056, 2.052, 2.048,
+                       2.045,  2.042};
+const double Z_95 = 1.96;
+
+/**
+ * One benchmark, run with the parameters `n` and `m`. setup() builds a
+ * fixture, run() performs `iterations` operations on it and teardown()
+ * frees it. Results are reported per operation. Fixtures that run() changes
+ * can set reset(), which puts the fixture back before every batch, untimed,
+ * so every batch does the same work.
+ */
+typedef struct benchmark {
+  const char *name;
+  const char *op; // what one operation is
+  void *(*setup)(size_t n, size_t m);
+  void (*run)(void *fixture, size_t iterations);
+  void (*teardown)(void *fixture);
+  size_t n;
+  size_t m;
+  void (*reset)(void *fixture); // NULL if run() leaves the fixture as it was
+} benchmark_t;
+
+typedef struct stats {
+  double median;
+  double mean;
+  double stddev;
+  double min;
+  double max;
+  double ci95; // half-width of the 95% confidence interval of the mean
+} stats_t;
+
+double bench_rand(double min, double max) {
+  return min + (max - min) * rand() / RAND_MAX;
+}
+
+vector_t bench_rand_pos(void) {
+  return (vector_t){bench_rand(BENCH_MIN.x, BENCH_MAX.x),
+                    bench_rand(BENCH_MIN.y, BENCH_MAX.y)};
+}
+
+
+typedef struct vector_fixture {
+  vector_t *vectors;
+  size_t n;
+  double sink; // keeps the results live
+} vector_fixture_t;
+
+void *vector_setup(size_t n, size_t m) {
+  vector_fixture_t *fixture = malloc(sizeof(vector_fixture_t));
+  fixture->vectors = malloc(n * sizeof(vector_t));
+  for (size_t i = 0; i < n; i++) {
+    fixture->vectors[i] = bench_rand_pos();
+  }
+  fixture->n = n;
+  fixture->sink = 0;
+  return fixture;
+}
+
+void vector_run(void *aux, size_t iterations) {
+  vector_fixture_t *fixture = aux;
+  vector_t acc = VEC_ZERO;
+  for (size_t i = 0; i < iterations; i++) {
+    vector_t v = fixture->vectors[i % fixture->n];
+    acc = vec_add(acc, vec_multiply(0.5, vec_subtract(v, acc)));
+    acc = vec_rotate(acc, vec_dot(v, acc) * 1e-9);
+  }
+  fixture->sink += acc.x + acc.y;
+}
+
+void vector_teardown(void *aux) {
+  vector_fixture_t *fixture = aux;
+  free(fixture->vectors);
+  free(fixture);
+}
+
+
+list_t *make_ngon(vector_t center, double radius, size_t sides) {
+  list_t *points = list_init(sides, free);
+  for (size_t i = 0; i < sides; i++) {
+    vector_t *point = malloc(sizeof(vector_t));
+    *point = vec_add(center, vec_make(radius, 2 * M_PI * i / sides));
+    list_add(points, point);
+  }
+  return points;
+}
+
+void *polygon_setup(size_t n, size_t m) {
+  list_t *points = make_ngon(bench_rand_pos(), 20, n);
+  return polygon_init(points, VEC_ZERO, 0, 1, 1, 1);
+}
+
+void polygon_run(void *aux, size_t iterations) {
+  polygon_t *polygon = aux;
+  for (size_t i = 0; i < iterations; i++) {
+    polygon_rotate(polygon, 0.01, polygon_centroid(polygon));
+  }
+}
+
+void polygon_teardown(void *aux) { polygon_free(aux); }
+
+
+typedef struct bodies_fixture {
+  scene_t *scene; // owns every body
+  body_t **first; // n asteroids
+  body_t **second; // m bullets
+  size_t n;
+  size_t m;
+  size_t hits;
+  // where the asteroids started, for bodies_reset()
+  vector_t *start_centroids;
+  vector_t *start_velocities;
+} bodies_fixture_t;
+
+/**
+ * Builds a scene of `n` asteroids and `m` bullets at random positions.
+ */
+bodies_fixture_t *bodies_setup(size_t n, size_t m) {
+  bodies_fixture_t *fixture = malloc(sizeof(bodies_fixture_t));
+  fixture->scene = scene_init();
+  fixture->first = malloc(n * sizeof(body_t *));
+  fixture->second = malloc((m > 0 ? m : 1) * sizeof(body_t *));
+  fixture->n = n;
+  fixture->m = m;
+  fixture->hits = 0;
+  fixture->start_centroids = malloc(n * sizeof(vector_t));
+  fixture->start_velocities = malloc(n * sizeof(vector_t));
+  for (size_t i = 0; i < n; i++) {
+    body_t *asteroid = make_asteroid(bench_rand_pos(), bench_rand(10, 40),
+                                     VEC_ZERO, BENCH_ASTEROID_DENSITY);
+    body_set_velocity(asteroid, vec_make(bench_rand(0, 100),
+                                         bench_rand(0, 2 * M_PI)));
+    scene_add_body(fixture->scene, asteroid);
+    fixture->first[i] = asteroid;
+    fixture->start_centroids[i] = body_get_centroid(asteroid);
+    fixture->start_velocities[i] = body_get_velocity(asteroid);
+  }
+  for (size_t i = 0; i < m; i++) {
+    body_t *bullet = make_bullet(bench_rand_pos(), bench_rand(0, 2 * M_PI),
+                                 500, 5, 5, 0);
+    scene_add_body(fixture->scene, bullet);
+    fixture->second[i] = bullet;
+  }
+  return fixture;
+}
+
+void bodies_teardown(void *aux) {
+  bodies_fixture_t *fixture = aux;
+  scene_free(fixture->scene);
+  free(fixture->first);
+  free(fixture->second);
+  free(fixture->start_centroids);
+  free(fixture->start_velocities);
+  free(fixture);
+}
+
+/**
+ * Moves every asteroid back to where it started, so every batch of scene
+ * ticks starts from the same layout instead of wherever the last batch's
+ * forces left the bodies.
+ */
+void bodies_reset(void *aux) {
+  bodies_fixture_t *fixture = aux;
+  for (size_t i = 0; i < fixture->n; i++) {
+    body_t *asteroid = fixture->first[i];
+    body_set_centroid(asteroid, fixture->start_centroids[i]);
+    body_set_velocity(asteroid, fixture->start_velocities[i]);
+  }
+}
+
+void *collision_setup(size_t n, size_t m) { return bodies_setup(n, m); }
+
+void collision_run(void *aux, size_t iterations) {
+  bodies_fixture_t *fixture = aux;
+  size_t num_pairs = fixture->n * fixture->m;
+  for (size_t i = 0; i < iterations; i++) {
+    size_t pair = i % num_pairs;
+    body_t *asteroid = fixture->first[pair / fixture->m];
+    body_t *bullet = fixture->second[pair % fixture->m];
+    fixture->hits += find_collision(asteroid, bullet).collided;
+  }
+}
+
+
+void *drag_setup(size_t n, size_t m) {
+  bodies_fixture_t *fixture = bodies_setup(n, 0);
+  for (size_t i = 0; i < n; i++) {
+    create_drag(fixture->scene, BENCH_DRAG, fixture->first[i]);
+  }
+  return fixture;
+}
+
+void *gravity_setup(size_t n, size_t m) {
+  bodies_fixture_t *fixture = bodies_setup(n, 0);
+  for (size_t i = 0; i < n; i++) {
+    for (size_t j = i + 1; j < n; j++) {
+      create_newtonian_gravity(fixture->scene, BENCH_G, fixture->first[i],
+                               fixture->first[j]);
+    }
+  }
+  return fixture;
+}
+
+void scene_tick_run(void *aux, size_t iterations) {
+  bodies_fixture_t *fixture = aux;
+  for (size_t i = 0; i < iterations; i++) {
+    scene_tick(fixture->scene, BENCH_DT);
+  }
+}
+
+
+typedef struct gravity_fixture {
+  vector_t *positions;
+  double *masses;
+  size_t n;
+  gravity_tree_t *tree;
+  gravity_field_t *field;
+  double sink; // keeps the results live
+} gravity_fixture_t;
+
+/**
+ * Places `n` masses at random positions, for gravity_tree_run() to pull
+ * together or as the attractors of a field.
+ */
+gravity_fixture_t *gravity_fixture_init(size_t n) {
+  gravity_fixture_t *fixture = malloc(sizeof(gravity_fixture_t));
+  fixture->positions = malloc(n * sizeof(vector_t));
+  fixture->masses = malloc(n * sizeof(double));
+  for (size_t i = 0; i < n; i++) {
+    fixture->positions[i] = bench_rand_pos();
+    fixture->masses[i] = bench_rand(30, 500);
+  }
+  fixture->n = n;
+  fixture->tree = NULL;
+  fixture->field = NULL;
+  fixture->sink = 0;
+  return fixture;
+}
+
+void *gravity_tree_setup(size_t n, size_t m) {
+  gravity_fixture_t *fixture = gravity_fixture_init(n);
+  fixture->tree = gravity_tree_init(BENCH_G, BENCH_SOFTENING, BENCH_THETA);
+  return fixture;
+}
+
+/**
+ * One tick of mutual gravity, as the game does it: rebuild the tree, then
+ * find the pull on every body. Compare with gravity_scene_tick.
+ */
+void gravity_tree_run(void *aux, size_t iterations) {
+  gravity_fixture_t *fixture = aux;
+  for (size_t i = 0; i < iterations; i++) {
+    gravity_tree_build(fixture->tree, fixture->positions, fixture->masses,
+                       fixture->n);
+    for (size_t j = 0; j < fixture->n; j++) {
+      fixture->sink +=
+          gravity_tree_sample(fixture->tree, fixture->positions[j]).x;
+    }
+  }
+}
+
+void *gravity_field_setup(size_t n, size_t m) {
+  gravity_fixture_t *fixture = gravity_fixture_init(n);
+  fixture->field = gravity_field_init(
+      BENCH_MIN, BENCH_MAX, BENCH_CELL_SIZE, BENCH_G, BENCH_SOFTENING,
+      fixture->positions, fixture->masses, fixture->n);
+  // the attractors are baked into the field; sample somewhere else
+  fixture->positions =
+      realloc(fixture->positions, BENCH_SAMPLE_POINTS * sizeof(vector_t));
+  for (size_t i = 0; i < BENCH_SAMPLE_POINTS; i++) {
+    fixture->positions[i] = bench_rand_pos();
+  }
+  return fixture;
+}
+
+void gravity_field_run(void *aux, size_t iterations) {
+  gravity_fixture_t *fixture = aux;
+  for (size_t i = 0; i < iterations; i++) {
+    vector_t pos = fixture->positions[i % BENCH_SAMPLE_POINTS];
+    fixture->sink += gravity_field_sample(fixture->field, pos).x;
+  }
+}
+
+void gravity_teardown(void *aux) {
+  gravity_fixture_t *fixture = aux;
+  if (fixture->tree != NULL) {
+    gravity_tree_free(fixture->tree);
+  }
+  if (fixture->field != NULL) {
+    gravity_field_free(fixture->field);
+  }
+  free(fixture->positions);
+  free(fixture->masses);
+  free(fixture);
+}
+
+
+typedef struct match_fixture {
+  state_t *state;
+  snapshot_t *start; // the match at tick 0
+  snapshot_t *snapshot; // written by snapshot_run()
+  size_t tick;
+} match_fixture_t;
+
+/**
+ * The same kind of input script as bin/sim: both players turn in bursts
+ * and fire as often as the reload allows.
+ */
+uint32_t bench_input(size_t tick) {
+  uint32_t input = 0;
+  if ((tick / 20) % 3 == 0) {
+    input |= INPUT_P1_TURN;
+  }
+  if (tick % 30 == 0) {
+    input |= INPUT_P1_SHOOT;
+  }
+  if ((tick / 25) % 4 == 1) {
+    input |= INPUT_P2_TURN;
+  }
+  if (tick % 45 == 0) {
+    input |= INPUT_P2_SHOOT;
+  }
+  return input;
+}
+
+void *match_setup(size_t n, size_t m) {
+  match_fixture_t *fixture = malloc(sizeof(match_fixture_t));
+  fixture->state = sim_init(n, BENCH_SEED, OPPONENT_PLAYER);
+  fixture->start = snapshot_init(0);
+  fixture->snapshot = snapshot_init(0);
+  fixture->tick = 0;
+  sim_snapshot(fixture->state, fixture->start);
+  return fixture;
+}
+
+/**
+ * Puts the match back at tick 0, so every batch of ticks plays the same
+ * stretch of the match instead of wherever the last batch left off.
+ */
+void match_reset(void *aux) {
+  match_fixture_t *fixture = aux;
+  bool restored = sim_restore(fixture->state, fixture->start);
+  assert(restored);
+  fixture->tick = 0;
+  srand(BENCH_SEED);
+}
+
+void match_tick_run(void *aux, size_t iterations) {
+  match_fixture_t *fixture = aux;
+  for (size_t i = 0; i < iterations; i++) {
+    sim_tick(fixture->state, BENCH_DT, bench_input(fixture->tick++));
+  }
+}
+
+void snapshot_run(void *aux, size_t iterations) {
+  match_fixture_t *fixture = aux;
+  for (size_t i = 0; i < iterations; i++) {
+    sim_snapshot(fixture->state, fixture->snapshot);
+  }
+}
+
+void restore_run(void *aux, size_t iterations) {
+  match_fixture_t *fixture = aux;
+  for (size_t i = 0; i < iterations; i++) {
+    sim_restore(fixture->state, fixture->start);
+  }
+}
+
+void match_teardown(void *aux) {
+  match_fixture_t *fixture = aux;
+  sim_free(fixture->state);
+  snapshot_free(fixture->start);
+  snapshot_free(fixture->snapshot);
+  free(fixture);
+}
+
+const benchmark_t BENCHMARKS[] = {
+  {"vec_ops", "add, subtract, multiply, dot and rotate", vector_setup, vector_run,
+   vector_teardown, 1024, 0},
+  {"polygon_rotate", "rotation", polygon_setup, polygon_run,
+   polygon_teardown, 3, 0},
+  {"polygon_rotate", "rotation", polygon_setup, polygon_run,
+   polygon_teardown, 12, 0},
+  {"polygon_rotate", "rotation", polygon_setup, polygon_run,
+   polygon_teardown, 64, 0},
+  {"find_collision", "asteroid-bullet pair", collision_setup, collision_run,
+   bodies_teardown, 10, 16},
+  {"find_collision", "asteroid-bullet pair", collision_setup, collision_run,
+   bodies_teardown, 100, 16},
+  {"drag_scene_tick", "tick", drag_setup, scene_tick_run, bodies_teardown,
+   10, 0, bodies_reset},
+  {"drag_scene_tick", "tick", drag_setup, scene_tick_run, bodies_teardown,
+   100, 0, bodies_reset},
+  {"drag_scene_tick", "tick", drag_setup, scene_tick_run, bodies_teardown,
+   1000, 0, bodies_reset},
+  {"gravity_scene_tick", "tick", gravity_setup, scene_tick_run,
+   bodies_teardown, 10, 0, bodies_reset},
+  {"gravity_scene_tick", "tick", gravity_setup, scene_tick_run,
+   bodies_teardown, 100, 0, bodies_reset},
+  {"gravity_tree", "tick", gravity_tree_setup, gravity_tree_run,
+   gravity_teardown, 10, 0},
+  {"gravity_tree", "tick", gravity_tree_setup, gravity_tree_run,
+   gravity_teardown, 100, 0},
+  {"gravity_tree", "tick", gravity_tree_setup, gravity_tree_run,
+   gravity_teardown, 1000, 0},
+  {"gravity_field", "sample", gravity_field_setup, gravity_field_run,
+   gravity_teardown, 1, 0},
+  {"gravity_field", "sample", gravity_field_setup, gravity_field_run,
+   gravity_teardown, 16, 0}
+};
+
+// run on every map that sim_num_maps() finds, with n set to the map index
+const benchmark_t MAP_BENCHMARKS[] = {
+  {"sim_tick", "tick", match_setup, match_tick_run, match_teardown, 0, 0,
+   match_reset},
+  {"sim_snapshot", "snapshot", match_setup, snapshot_run, match_teardown, 0,
+   0},
+  {"sim_restore", "restore", match_setup, restore_run, match_teardown, 0, 0}
+};
+
+int compare_doubles(const void *a, const void *b) {
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+stats_t compute_stats(double *samples, size_t count) {
+  qsort(samples, count, sizeof(double), compare_doubles);
+  stats_t stats = {.min = samples[0], .max = samples[count - 1]};
+  stats.median = count % 2 == 1
+                     ? samples[count / 2]
+                     : (samples[count / 2 - 1] + samples[count / 2]) / 2;
+  double sum = 0;
+  for (size_t i = 0; i < count; i++) {
+    sum += samples[i];
+  }
+  stats.mean = sum / count;
+  double squares = 0;
+  for (size_t i = 0; i < count; i++) {
+    squares += (samples[i] - stats.mean) * (samples[i] - stats.mean);
+  }
+  stats.stddev = count > 1 ? sqrt(squares / (count - 1)) : 0;
+  // a t interval, since a run has only a few samples
+  size_t degrees = count - 1;
+  double critical = Z_95;
+  if (degrees >= 1 && degrees <= sizeof(T_95) / sizeof(T_95[0])) {
+    critical = T_95[degrees - 1];
+  }
+  stats.ci95 = critical * stats.stddev / sqrt(count);
+  return stats;
+}
+
+/**
+ * Times one batch of operations.
+ *
+ * @return the time per operation in nanoseconds
+ */
+double time_batch(const benchmark_t *bench, void *fixture,
+                  size_t iterations) {
+  if (bench->reset != NULL) {
+    bench->reset(fixture);
+  }
+  double start = timer_now();
+  bench->run(fixture, iterations);
+  return (timer_now() - start) * 1e9 / iterations;
+}
+
+/**
+ * Runs one benchmark: doubles the batch size until a batch takes at least
+ * MIN_BATCH_TIME, runs the warmup batches, then times `repetitions`
+ * batches of that size. Each batch is one sample.
+ */
+void run_benchmark(const benchmark_t *bench, size_t repetitions,
+                   size_t warmup, bool first) {
+  srand(BENCH_SEED);
+  void *fixture = bench->setup(bench->n, bench->m);
+  size_t iterations = 1;
+  while (iterations < MAX_BATCH_ITERATIONS &&
+         time_batch(bench, fixture, iterations) * iterations <
+             MIN_BATCH_TIME * 1e9) {
+    iterations *= 2;
+  }
+  for (size_t i = 0; i < warmup; i++) {
+    time_batch(bench, fixture, iterations);
+  }
+  double *samples = malloc(repetitions * sizeof(double));
+  for (size_t i = 0; i < repetitions; i++) {
+    samples[i] = time_batch(bench, fixture, iterations);
+  }
+  bench->teardown(fixture);
+  stats_t stats = compute_stats(samples, repetitions);
+  free(samples);
+
+  printf("%s\n    {\"name\": \"%s\", \"op\": \"%s\", \"n\": %zu, \"m\": %zu, "
+         "\"iterations\": %zu, \"repetitions\": %zu,\n"
+         "     \"ns_per_op\": {\"median\": %.3f, \"mean\": %.3f, "
+         "\"stddev\": %.3f, \"min\": %.3f, \"max\": %.3f, \"ci95\": %.3f}}",
+         first ? "" : ",", bench->name, bench->op, bench->n, bench->m,
+         iterations, repetitions, stats.median, stats.mean, stats.stddev,
+         stats.min, stats.max, stats.ci95);
+  fflush(stdout);
+}
+
+void print_usage(const char *program) {
+  fprintf(stderr,
+          "usage: %s [-r repetitions] [-w warmup] [-f filter]\n"
+          "  -r  timed batches per benchmark (default %zu)\n"
+          "  -w  untimed batches before timing (default %zu)\n"
+          "  -f  only run benchmarks whose name contains this string\n"
+          "Results are printed to stdout as JSON.\n",
+          program, DEFAULT_REPETITIONS, DEFAULT_WARMUP);
+}
+
+int main(int argc, char *argv[]) {
+  size_t repetitions = DEFAULT_REPETITIONS;
+  size_t warmup = DEFAULT_WARMUP;
+  const char *filter = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    bool has_value = i + 1 < argc;
+    if (strcmp(argv[i], "-r") == 0 && has_value) {
+      repetitions = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "-w") == 0 && has_value) {
+      warmup = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "-f") == 0 && has_value) {
+      filter = argv[++i];
+    } else {
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+  if (repetitions == 0) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  printf("{\n  \"repetitions\": %zu,\n  \"warmup\": %zu,\n"
+         "  \"min_batch_seconds\": %g,\n  \"benchmarks\": [",
+         repetitions, warmup, MIN_BATCH_TIME);
+  bool first = true;
+  size_t num_benchmarks = sizeof(BENCHMARKS) / sizeof(BENCHMARKS[0]);
+  for (size_t i = 0; i < num_benchmarks; i++) {
+    const benchmark_t *bench = &BENCHMARKS[i];
+    if (filter != NULL && strstr(bench->name, filter) == NULL) {
+      continue;
+    }
+    run_benchmark(bench, repetitions, warmup, first);
+    first = false;
+  }
+  size_t num_map_benchmarks =
+      sizeof(MAP_BENCHMARKS) / sizeof(MAP_BENCHMARKS[0]);
+  for (size_t map = 0; map < sim_num_maps(); map++) {
+    for (size_t i = 0; i < num_map_benchmarks; i++) {
+      benchmark_t bench = MAP_BENCHMARKS[i];
+      bench.n = map;
+      if (filter != NULL && strstr(bench.name, filter) == NULL) {
+        continue;
+      }
+      run_benchmark(&bench, repetitions, warmup, first);
+      first = false;
+    }
+  }
+  printf("\n  ]\n}\n");
+  return 0;
+}
@@ -6,12 +6,30 @@
 #include <time.h>
 #include <SDL2/SDL.h>
 
+#include "arena.h"
 #include "asset.h"
+#include "atlas.h"
 #include "asset_cache.h"
+#include "asset_table.h"
+#include "broadphase.h"
 #include "collision.h"
+#include "colliders.h"
 #include "forces.h"
+#include "glyph_cache.h"
+#include "gravity.h"
+#include "job_pool.h"
+#include "map_file.h"
+#include "planner.h"
+#include "preloader.h"
+#include "profiler.h"
+#include "render_batch.h"
+#include "replay.h"
+#include "sat.h"
 #include "sdl_wrapper.h"
 #include "shapes.h"
+#include "sim.h"
+#include "snapshot.h"
+#include "timer.h"
 #include "entities.h"
 #include "bot.h"
 
@@ -22,24 +40,99 @@ const vector_t MAX = {1000, 500};
 const size_t INITIAL_GAME_CAPACITY = 5;
 const size_t WIN_SCORE = 5;
 const size_t SCORE_HEIGHT = 30; // height of entire score bar
+const size_t FRAME_ARENA_SIZE = 64 * 1024;
+const size_t IDLE_ASSET_BUDGET = 32;
+const double PHYSICS_RATE = 60; // physics ticks per second
+const double MAX_FRAME_TIME = 0.25; // longer frames are slowed down
 const char *FONT_PATH = "assets/Roboto.ttf";
+const int FONT_SIZE = 18;
+const char *REPLAY_PATH = "last_match.replay";
 const char *GAME_OVER_MSG = "Game over! Winner is: Player ";
 const char *PLAYER_COLOR_NAMES[] = {"Red", "Blue"};
-const char *OPP_SELECTION_MSGS[] = {"Player vs. Player", "Play against AI"};
+const char *OPP_SELECTION_MSGS[] = {"Player vs. Player", "Play against AI",
+                                    "Play against planner AI"};
 const SDL_Rect MAP_SELECTION_BOX = (SDL_Rect){572, 262, 10, 10};
 const SDL_Rect OPP_SELECTION_BOX = (SDL_Rect){530, 325, 10, 10};
+const int HUD_FONT_SIZE = 16;
+const int HUD_MARGIN = 8; // from the right edge and the score bars
+const double FPS_SMOOTHING = 0.05; // weight of the newest frame
+const size_t PRELOAD_THREADS = 2;
+const vector_t LOADING_BAR_POS = {300, 230}; // bottom left corner
+const vector_t LOADING_BAR_SIZE = {400, 20};
+const SDL_Rect LOADING_TEXT_BOX = (SDL_Rect){300, 200, 400, 20};
+const rgb_color_t LOADING_BAR_COLOR = (rgb_color_t){0.3, 0.6, 1.0};
+#define LOADING_TEXT_LENGTH 32
+#define HUD_TEXT_LENGTH 64
+#define GAME_OVER_MSG_LENGTH 64
 const rgb_color_t BLACK = (rgb_color_t){.r = 1, .g = 1, .b = 1};
 const rgb_color_t WHITE = (rgb_color_t){1, 1, 1};
 
+#ifdef PROFILE
+// profiler constants
+const size_t PROFILER_CAPACITY = 1 << 16; // events kept for traces
+const char PROFILER_TOGGLE_KEY = 'p';
+const char PROFILER_TRACE_KEY = 't';
+const char *PROFILER_TRACE_PATH = "trace.json";
+const double PROFILER_TEXT_REFRESH = 0.25; // seconds between text updates
+const SDL_Rect PROFILER_TEXT_BOX = (SDL_Rect){10, 40, 220, 16}; // first line
+const int PROFILER_FONT_SIZE = 12;
+const vector_t PROFILER_GRAPH_POS = {680, 10}; // bottom left corner
+const vector_t PROFILER_GRAPH_SIZE = {300, 80};
+const double PROFILER_GRAPH_MAX_TIME = 2.0 / 60; // frame time at the top
+const double PROFILER_TARGET_TIME = 1.0 / 60;
+const rgb_color_t PROFILER_GOOD_COLOR = (rgb_color_t){0.2, 0.9, 0.2};
+const rgb_color_t PROFILER_SLOW_COLOR = (rgb_color_t){0.9, 0.2, 0.2};
+const rgb_color_t PROFILER_GRAPH_BG_COLOR = (rgb_color_t){0, 0, 0};
+const Uint8 PROFILER_GRAPH_BG_ALPHA = 160;
+#define PROFILER_GRAPH_FRAMES 120
+#define PROFILER_LINE_LENGTH 64
+#endif
+
+// Only bin/sim reads sim_get_timings(), and only the profiler records phase
+// times, so other builds skip reading the clock for them.
+#if defined(HEADLESS) || defined(PROFILE)
+#define PHASE_TIME() timer_now()
+#else
+#define PHASE_TIME() 0.0
+#endif
+
 // sound constants
 const char *SHOOT_SOUND_PATH = "assets/sounds/shoot.wav";
 const char *BOOST_SOUND_PATH = "assets/sounds/boost.wav";
 const char *BACKGROUND_TRACK = "assets/music/outro.ogg";
 
+// map constants
+const char *MAP_SOURCE_FORMAT = "assets/maps/%zu.map";
+const char *MAP_COMPILED_FORMAT = "assets/maps/%zu.mapb";
+const size_t INITIAL_MAP_CAPACITY = 4;
+#define MAP_PATH_LENGTH 64
+#define MAP_NUMBER_LENGTH 8
+
 // environment constants
 const double WALL_DIM = 1;
 const double ASTEROID_MASS_DENSITY = 0.1;
 const double ELASTICITY = 1;
+const double BROADPHASE_CELL_SIZE = 50;
+const size_t SHAPE_JOB_GRAIN = 64; // shapes transformed per job chunk
+const size_t PAIR_JOB_GRAIN = 32; // pairs tested per job chunk
+// off screen; where parked bullets and destroyed asteroids wait
+const vector_t PARKED_POS = {-1000, -1000};
+
+// asteroid spawning constants
+const double MIN_ASTEROID_RADIUS = 10;
+const double MAX_ASTEROID_RADIUS = 40;
+const double ASTEROID_GAP = 5; // kept clear around every spawned asteroid
+const double OCCUPANCY_CELL_SIZE = 10;
+const size_t NO_SAMPLE = SIZE_MAX; // an empty cell of the sample grid
+
+// gravity constants
+const double BLACKHOLE_G = 1; // map masses of black holes are in units of G
+const double GRAVITY_SOFTENING = 20; // the pull stops growing this close in
+const double GRAVITY_CELL_SIZE = 10; // spacing of the black hole field
+const double GRAVITY_THETA = 0.5; // Barnes-Hut opening angle
+const double BLACKHOLE_RADIUS = 20; // as drawn
+const size_t BLACKHOLE_SIDES = 24;
+const rgb_color_t BLACKHOLE_COLOR = (rgb_color_t){0.1, 0, 0.15};
 
 // ship constants
 const double SHIP_MASS = 10;
@@ -55,46 +148,73 @@ const double PLAYER_ROT_ACCEL = 3;
 const double BOOST_VELOCITY = 400;
 const double BOOST_ANGLE = -M_PI / 3;
 const double BOOST_ROT_SPEED = -3 * M_PI;
-const double DOUBLE_TAP_THRESH = 0.2 * CLOCKS_PER_SEC;
+const double DOUBLE_TAP_THRESH = 0.2 * CLOCKS_PER_SEC; // for the bot
+const double DOUBLE_TAP_TIME = 0.2;
 const double THRUST_POWER = 3000;
 const double DRAG_COEF = 30;
 const double ROT_DRAG_FACTOR = 7;
 const double RELOAD_TIME = 0.5;
 
+// planner constants
+const size_t PLANNER_HORIZON = 60; // ticks each rollout looks ahead
+const double PLANNER_BUDGET = 0.002; // seconds of planning per frame
+const size_t PLANNER_MAX_ROLLOUTS = 4096; // per frame
+const size_t SIM_PLANNER_ROLLOUTS = 64; // per tick in the headless sim
+
 // bullet constants
 const double BULLET_RADIUS = 5;
 const double BULLET_MASS = 5;
 const double BULLET_SPEED = 500;
+const size_t BULLET_POOL_SIZE = 16;
 
 double rand_double() { return (double)rand() / RAND_MAX; }
+void apply_input(state_t *state, double dt);
+void apply_planner_input(state_t *state);
+void spin_ships(state_t *state, double dt);
+void release_all_bullets(state_t *state);
+uint32_t collision_category(entity_type_t type);
 void toggle_play(state_t *state);
 void toggle_left_map_arrow(state_t *state);
 void toggle_right_map_arrow(state_t *state);
 void toggle_bot_arrow(state_t *state);
-void add_force_creators(state_t *state);
 
 enum mode {
+  LOADING, // decoding the home page's files
   HOME,
   GAME,
   POST_GAME
 };
 
-typedef struct map {
-  size_t num_blocks;
-  size_t num_asteroids;
-  size_t num_blackholes;
-  size_t num_bg;
-  const char *backdrop_path;
-  char **bg_paths;
-  vector_t *bg_pos;
-  vector_t *bg_sizes;
-  double *bg_depth;
-  vector_t *block_locations;
-  vector_t *block_sizes;
-  vector_t *blackhole_locations;
-  double *blackhole_masses;
-  vector_t *start_pos;
-} map_t;
+/**
+ * Bullets are allocated once per match and recycled. Inactive bullets stay
+ * in the scene, parked off screen, with their colliders deactivated.
+ */
+typedef struct bullet_pool {
+  body_t **bullets;
+  size_t *indices; // collider index of each bullet
+  size_t *free_slots; // stack of the slots of inactive bullets
+  size_t num_free;
+} bullet_pool_t;
+
+// opponent_t runs from OPPONENT_PLAYER to OPPONENT_PLANNER
+#define NUM_OPPONENTS (OPPONENT_PLANNER + 1)
+
+// entity_type_t runs from SHIP to BULLET
+#define NUM_ENTITY_TYPES (BULLET + 1)
+
+typedef struct collision_entry {
+  collision_handler_t handler;
+  bool swap; // whether the handler expects the bodies in the other order
+} collision_entry_t;
+
+/**
+ * The outcome of the narrow-phase test of one broad-phase pair.
+ */
+typedef struct contact {
+  collision_entry_t entry;
+  vector_t axis;
+  bool collided;
+} contact_t;
 
 struct state {
   enum mode mode; // Keeps track of what page game is on
@@ -102,24 +222,87 @@ struct state {
   size_t P2_score;
 
   size_t map_selected;
-  bool bot;
+  unsigned int seed; // seeds rand() when the map is laid out
+  opponent_t opponent;
+  planner_t *planner; // created when the planner first plays
   map_t map;
   
   list_t *home_assets;
   list_t *game_assets;
   list_t *post_game_assets;
 
+  render_batch_t *render_batch;
+
+  // static images and background layers packed into a few textures
+  atlas_t *atlas;
+  // every string drawn, from glyphs rasterized once
+  glyph_cache_t *glyph_cache;
+  // decodes images and sounds off the main thread
+  preloader_t *preloader;
+  double fps; // smoothed, for the HUD
+  // one per background layer, NULL for layers drawn from the atlas
+  asset_t **bg_assets;
+
+  // transient per-frame allocations, reset at the top of emscripten_main
+  arena_t *frame_arena;
+
+  // shared assets that are drawn repeatedly, such as the home page labels
+  asset_table_t *asset_table;
+
+  // score bars, rebuilt only when a score changes
+  polygon_t *score_bars[2];
+  size_t score_bar_values[2];
+
   body_t *player1;
   body_t *player2;
-  clock_t time_of_last_shot[2];
+  size_t player_indices[2]; // collider indices of the ships
+
+  // game clock, advanced by every tick; all gameplay timers use it
+  double time;
+  double time_of_last_shot[2];
+  bool turn_held[2];
+  double turn_pressed_at[2];
+  double turn_released_at[2];
+  double ship_spin[2]; // radians per second, slowed by ROT_DRAG_FACTOR
+  uint32_t input; // input_t bits held this tick
+  sim_timings_t timings;
+  replay_writer_t *replay_writer; // NULL unless the match is recorded
+
+  // fixed timestep loop: wall time not yet simulated, in seconds
+  double physics_dt;
+  double accumulator;
+  double last_frame_time;
   
   Mix_Chunk *shoot_sound;
   Mix_Chunk *boost_sound;
   Mix_Music *backing_track;
 
   scene_t *scene;
+  colliders_t *colliders;
+  broadphase_t *broadphase;
+  gravity_field_t *gravity_field; // NULL if the map has no black holes
+  gravity_tree_t *gravity_tree; // NULL unless the map has mutual gravity
+  bullet_pool_t *bullet_pool;
+  collision_entry_t collision_table[NUM_ENTITY_TYPES][NUM_ENTITY_TYPES];
+  uint32_t collision_masks[NUM_ENTITY_TYPES];
+  job_pool_t *job_pool;
+  contact_t *contacts; // one per broad-phase pair
+  size_t contact_capacity;
+  bool round_reset; // set when a hit resets the round mid-tick
+  size_t num_force_creators;
+  size_t num_bodies_drawn; // by the last render_bodies(), after culling
+  // the collider indices of the bodies passed to the running handler
+  size_t handler_indices[2];
   double dt;
   Uint8 *key_state;
+
+#ifdef PROFILE
+  bool profiler_visible;
+  bool profiler_keys_held[2]; // toggle and trace keys, for edge detection
+  double profiler_text_time; // when the overlay text was last rebuilt
+  char profiler_lines[NUM_PROFILE_PHASES + 1][PROFILER_LINE_LENGTH];
+  size_t num_profiler_lines;
+#endif
 };
 
 typedef struct button_info {
@@ -141,6 +324,7 @@ typedef struct image_info {
   const char *text;
 } image_info_t;
 
+#ifndef HEADLESS
 image_info_t home_images[] = {
   { .image_path = "assets/space.jpg",
     .image_box = (SDL_Rect){MIN.x, MIN.y, MAX.x, MAX.y}},
@@ -183,91 +367,75 @@ button_info_t button_templates[] = {
      .image_box = (SDL_Rect){725, 310, 75, 75},
      .handler = (void*)toggle_bot_arrow}
 };
+#endif
 
-map_t maps[] = {
-  {
-    .num_blocks = 3,
-    .num_asteroids = 10,
-    .num_bg = 3,
-    .backdrop_path = "assets/space1.png",
-    .bg_paths = (char *[]){"assets/neptune.png", "assets/planet1.png", "assets/earthlike.png"},
-    .bg_pos = (vector_t[]){(vector_t){400, 150}, (vector_t){500, 200}, (vector_t){250, 280}},
-    .bg_sizes = (vector_t[]){(vector_t){300, 300}, (vector_t){150, 150}, (vector_t){120, 120}},
-    .bg_depth = (double[]){6, 3, 2},
-    .block_locations = (vector_t[]){(vector_t){100, 100}, 
-    (vector_t){200, 200}, 
-    (vector_t){300, 300}},
-    .block_sizes = (vector_t[]){(vector_t){100, 100}, 
-    (vector_t){100, 100}, 
-    (vector_t){100, 100}},
-    .start_pos = (vector_t[]){(vector_t){100, 300}, 
-    (vector_t){700, 200}}
-  },
-  {
-    .num_blocks = 4,
-    .num_asteroids = 7,
-    .num_bg = 0,
-    .backdrop_path = "assets/space2.jpg",
-    .block_locations = (vector_t[]){(vector_t){100, 100},
-    (vector_t){250, 250},
-    (vector_t){400, 100},
-    (vector_t){100, 400}},
-    .block_sizes = (vector_t[]){(vector_t){100, 100},
-    (vector_t){75, 75},
-    (vector_t){100, 100},
-    (vector_t){75, 75}},
-    .start_pos = (vector_t[]){(vector_t){300, 100},
-    (vector_t){600, 400}}
-  },
-  {
-    .num_blocks = 5,
-    .num_asteroids = 12,
-    .num_bg = 0,
-    .backdrop_path = "assets/space3.jpg",
-    .block_locations = (vector_t[]){(vector_t){150, 150},
-    (vector_t){300, 300},
-    (vector_t){450, 150},
-    (vector_t){600, 300},
-    (vector_t){750, 150}},
-    .block_sizes = (vector_t[]){(vector_t){120, 120},
-    (vector_t){80, 80},
-    (vector_t){100, 100},
-    (vector_t){80, 80},
-    (vector_t){120, 120}},
-    .start_pos = (vector_t[]){(vector_t){50, 450},
-    (vector_t){950, 50}}
-  },
-  {
-    .num_blocks = 6,
-    .num_asteroids = 15,
-    .num_bg = 0,
-    .backdrop_path = "assets/space4.jpg",
-    .block_locations = (vector_t[]){(vector_t){600, 300},
-    (vector_t){200, 400},
-    (vector_t){350, 150},
-    (vector_t){500, 350},
-    (vector_t){650, 100},
-    (vector_t){800, 300}},
-    .block_sizes = (vector_t[]){(vector_t){90, 90},
-    (vector_t){110, 110},
-    (vector_t){95, 95},
-    (vector_t){110, 110},
-    (vector_t){90, 90},
-    (vector_t){95, 95}},
-    .start_pos = (vector_t[]){(vector_t){400, 50},
-    (vector_t){900, 450}}
-  }
-};
+// every map in assets/maps, in order of number; see load_maps()
+map_t **maps = NULL;
+size_t num_maps = 0;
 
-void reset_game(state_t *state) {
-  size_t n_bodies = scene_bodies(state->scene);
+/**
+ * Checks whether a file can be opened for reading.
+ *
+ * @param path the file
+ * @return true if the file exists and can be read
+ */
+bool file_exists(const char *path) {
+  FILE *file = fopen(path, "rb");
+  if (file == NULL) {
+    return false;
+  }
+  fclose(file);
+  return true;
+}
 
-  for (size_t i = 0; i < n_bodies; i++) {
-    body_t *body = scene_get_body(state->scene, i);
-    if (get_type(body) == BULLET) {
-      body_remove(body);
+/**
+ * Loads the maps numbered 1, 2, ... until one is missing. A map's compiled
+ * form ('make maps') is preferred, and its text is parsed if it has not
+ * been compiled or its compiled form is out of date. A map that exists but
+ * cannot be read exits the program rather than hiding the maps after it.
+ * Maps are loaded once and kept until the program exits.
+ */
+void load_maps(void) {
+  if (maps != NULL) {
+    return;
+  }
+  size_t capacity = INITIAL_MAP_CAPACITY;
+  maps = malloc(capacity * sizeof(map_t *));
+  assert(maps);
+  while (true) {
+    char compiled_path[MAP_PATH_LENGTH];
+    char source_path[MAP_PATH_LENGTH];
+    snprintf(compiled_path, sizeof(compiled_path), MAP_COMPILED_FORMAT,
+             num_maps + 1);
+    snprintf(source_path, sizeof(source_path), MAP_SOURCE_FORMAT,
+             num_maps + 1);
+    bool has_compiled = file_exists(compiled_path);
+    bool has_source = file_exists(source_path);
+    if (!has_compiled && !has_source) {
+      break;
+    }
+    map_t *map = has_compiled ? map_file_load(compiled_path) : NULL;
+    if (map == NULL && has_source) {
+      // map_file_parse() reports what is wrong with the text
+      map = map_file_parse(source_path);
     }
+    if (map == NULL) {
+      fprintf(stderr, "could not load map %zu from %s\n", num_maps + 1,
+              has_source ? source_path : compiled_path);
+      exit(EXIT_FAILURE);
+    }
+    if (num_maps == capacity) {
+      capacity *= 2;
+      maps = realloc(maps, capacity * sizeof(map_t *));
+      assert(maps);
+    }
+    maps[num_maps++] = map;
   }
+}
+
+void reset_game(state_t *state) {
+  state->round_reset = true;
+  release_all_bullets(state);
 
   // reset players's velocity and position
   body_set_centroid(state->player1, state->map.start_pos[0]);
@@ -294,11 +462,444 @@ void score_hit(body_t *body1, body_t *body2, vector_t axis, void *aux,
 }
 
 
+/**
+ * Adds a body to the scene and registers it with the collision system.
+ *
+ * @param state the state
+ * @param body the body to add
+ * @return the index of the body in the collider set
+ */
+size_t add_body(state_t *state, body_t *body) {
+  scene_add_body(state->scene, body);
+  entity_type_t type = get_type(body);
+  return colliders_add(state->colliders, body, collision_category(type),
+                       state->collision_masks[type]);
+}
+
+/**
+ * Allocates the bullet pool and adds every bullet to the scene, parked.
+ *
+ * @param state the state
+ */
+void bullet_pool_init(state_t *state) {
+  bullet_pool_t *pool = malloc(sizeof(bullet_pool_t));
+  assert(pool);
+  pool->bullets = malloc(BULLET_POOL_SIZE * sizeof(body_t *));
+  pool->indices = malloc(BULLET_POOL_SIZE * sizeof(size_t));
+  pool->free_slots = malloc(BULLET_POOL_SIZE * sizeof(size_t));
+  assert(pool->bullets && pool->indices && pool->free_slots);
+
+  for (size_t slot = 0; slot < BULLET_POOL_SIZE; slot++) {
+    body_t *bullet = make_bullet(PARKED_POS, 0, 0, BULLET_RADIUS,
+                                 BULLET_MASS, 0);
+    // bullets have no team, so the entity info records the pool slot instead
+    entity_info_t *info = body_get_info(bullet);
+    info->team = slot;
+    pool->bullets[slot] = bullet;
+    pool->indices[slot] = add_body(state, bullet);
+    colliders_set_active(state->colliders, pool->indices[slot], false);
+    // hand out low slots first
+    pool->free_slots[slot] = BULLET_POOL_SIZE - 1 - slot;
+  }
+  pool->num_free = BULLET_POOL_SIZE;
+  state->bullet_pool = pool;
+}
+
+void bullet_pool_free(bullet_pool_t *pool) {
+  // the bullets themselves are owned by the scene
+  free(pool->bullets);
+  free(pool->indices);
+  free(pool->free_slots);
+  free(pool);
+}
+
+/**
+ * Takes a body out of play without removing it from the scene: its collider
+ * is deactivated and it waits off screen, so the set of bodies stays fixed
+ * for the whole match. Bodies are only added while a map is set up, so at
+ * most BULLET_POOL_SIZE bullets and the map's asteroids, which map files
+ * cap, are ever parked at once.
+ *
+ * @param state the state
+ * @param index the collider index of the body
+ */
+void park_body(state_t *state, size_t index) {
+  body_t *body = colliders_get_body(state->colliders, index);
+  colliders_set_active(state->colliders, index, false);
+  body_reset(body);
+  body_set_centroid(body, PARKED_POS);
+  body_set_velocity(body, VEC_ZERO);
+}
+
+/**
+ * Takes a bullet from the pool and launches it from the nose of a ship.
+ *
+ * @param state the state
+ * @param ship the ship firing the bullet
+ * @return false if every bullet is already in flight
+ */
+bool fire_bullet(state_t *state, body_t *ship) {
+  bullet_pool_t *pool = state->bullet_pool;
+  if (pool->num_free == 0) {
+    return false;
+  }
+  size_t slot = pool->free_slots[--pool->num_free];
+  body_t *bullet = pool->bullets[slot];
+  double angle = body_get_rotation(ship);
+  body_reset(bullet);
+  body_set_centroid(bullet, vec_add(body_get_centroid(ship),
+                                    vec_make(SHIP_HEIGHT, angle)));
+  body_set_velocity(bullet, vec_make(BULLET_SPEED, angle));
+  colliders_set_active(state->colliders, pool->indices[slot], true);
+  return true;
+}
+
+/**
+ * Parks a bullet and returns it to the pool. Does nothing if the bullet is
+ * already parked.
+ *
+ * @param state the state
+ * @param bullet a bullet from the pool
+ */
+void release_bullet(state_t *state, body_t *bullet) {
+  bullet_pool_t *pool = state->bullet_pool;
+  entity_info_t *info = body_get_info(bullet);
+  size_t slot = info->team;
+  assert(slot < BULLET_POOL_SIZE && pool->bullets[slot] == bullet);
+  size_t index = pool->indices[slot];
+  if (!colliders_is_active(state->colliders, index)) {
+    return;
+  }
+  park_body(state, index);
+  pool->free_slots[pool->num_free++] = slot;
+}
+
+void release_all_bullets(state_t *state) {
+  bullet_pool_t *pool = state->bullet_pool;
+  for (size_t slot = 0; slot < BULLET_POOL_SIZE; slot++) {
+    release_bullet(state, pool->bullets[slot]);
+  }
+}
+
+/**
+ * Takes a body passed to the running collision handler out of play: bullets
+ * go back to the pool, anything else is parked.
+ *
+ * @param state the state
+ * @param body the body to destroy
+ */
+void destroy_body(state_t *state, body_t *body) {
+  if (get_type(body) == BULLET) {
+    release_bullet(state, body);
+    return;
+  }
+  size_t index = state->handler_indices[0];
+  if (colliders_get_body(state->colliders, index) != body) {
+    index = state->handler_indices[1];
+  }
+  assert(colliders_get_body(state->colliders, index) == body);
+  park_body(state, index);
+}
+
+void elastic_collision(body_t *body1, body_t *body2, vector_t axis, void *aux,
+                       double elasticity) {
+  // orient the axis from body1 towards body2
+  vector_t diff =
+      vec_subtract(body_get_centroid(body2), body_get_centroid(body1));
+  if (vec_dot(axis, diff) < 0) {
+    axis = vec_negate(axis);
+  }
+  double u1 = vec_dot(body_get_velocity(body1), axis);
+  double u2 = vec_dot(body_get_velocity(body2), axis);
+  if (u1 <= u2) { // already separating
+    return;
+  }
+
+  double m1 = body_get_mass(body1);
+  double m2 = body_get_mass(body2);
+  double reduced_mass;
+  if (m1 == INFINITY) {
+    reduced_mass = m2;
+  } else if (m2 == INFINITY) {
+    reduced_mass = m1;
+  } else {
+    reduced_mass = m1 * m2 / (m1 + m2);
+  }
+  double impulse = reduced_mass * (1 + elasticity) * (u2 - u1);
+  body_add_impulse(body1, vec_multiply(impulse, axis));
+  body_add_impulse(body2, vec_multiply(-impulse, axis));
+}
+
+void destructive_collision(body_t *body1, body_t *body2, vector_t axis,
+                           void *aux, double force_const) {
+  destroy_body(aux, body1);
+  destroy_body(aux, body2);
+}
+
+void destroy_first_collision(body_t *body1, body_t *body2, vector_t axis,
+                             void *aux, double force_const) {
+  destroy_body(aux, body1);
+}
+
+typedef struct collision_rule {
+  entity_type_t type1;
+  entity_type_t type2;
+  collision_handler_t handler; // called with bodies of type1 and type2
+} collision_rule_t;
+
+// every pair of entity types that interacts; all others pass through
+const collision_rule_t COLLISION_RULES[] = {
+  {SHIP, SHIP, elastic_collision},
+  {SHIP, ASTEROID, elastic_collision},
+  {SHIP, WALL, elastic_collision},
+  {SHIP, BULLET, (collision_handler_t)score_hit},
+  {ASTEROID, ASTEROID, elastic_collision},
+  {ASTEROID, WALL, elastic_collision},
+  {BULLET, BULLET, destructive_collision},
+  {BULLET, ASTEROID, destructive_collision},
+  {BULLET, WALL, destroy_first_collision}
+};
+
+uint32_t collision_category(entity_type_t type) { return 1u << type; }
+
+/**
+ * Expands COLLISION_RULES into a handler lookup by pair of types and a
+ * collision mask per type.
+ *
+ * @param state the state
+ */
+void collision_table_init(state_t *state) {
+  for (size_t i = 0; i < NUM_ENTITY_TYPES; i++) {
+    state->collision_masks[i] = 0;
+    for (size_t j = 0; j < NUM_ENTITY_TYPES; j++) {
+      state->collision_table[i][j] =
+          (collision_entry_t){.handler = NULL, .swap = false};
+    }
+  }
+
+  size_t n_rules = sizeof(COLLISION_RULES) / sizeof(COLLISION_RULES[0]);
+  for (size_t i = 0; i < n_rules; i++) {
+    collision_rule_t rule = COLLISION_RULES[i];
+    state->collision_table[rule.type1][rule.type2] =
+        (collision_entry_t){.handler = rule.handler, .swap = false};
+    if (rule.type1 != rule.type2) {
+      state->collision_table[rule.type2][rule.type1] =
+          (collision_entry_t){.handler = rule.handler, .swap = true};
+    }
+    state->collision_masks[rule.type1] |= collision_category(rule.type2);
+    state->collision_masks[rule.type2] |= collision_category(rule.type1);
+  }
+}
+
+void transform_shapes_job(void *aux, size_t start, size_t end) {
+  colliders_transform_shapes(aux, start, end);
+}
+
+typedef struct narrow_phase {
+  state_t *state;
+  broadphase_pair_t *pairs;
+} narrow_phase_t;
+
+/**
+ * Tests a chunk of broad-phase pairs with SAT and records the results in
+ * state->contacts. Reads bodies but never modifies them.
+ */
+void narrow_phase_job(void *aux, size_t start, size_t end) {
+  narrow_phase_t *narrow_phase = aux;
+  state_t *state = narrow_phase->state;
+  colliders_t *colliders = state->colliders;
+  for (size_t i = start; i < end; i++) {
+    broadphase_pair_t pair = narrow_phase->pairs[i];
+    contact_t *contact = &state->contacts[i];
+    contact->collided = false;
+    body_t *body1 = colliders_get_body(colliders, pair.first);
+    body_t *body2 = colliders_get_body(colliders, pair.second);
+    contact->entry = state->collision_table[get_type(body1)][get_type(body2)];
+    if (contact->entry.handler == NULL) {
+      continue;
+    }
+    sat_polygon_t shape1 = colliders_get_world_shape(colliders, pair.first);
+    sat_polygon_t shape2 = colliders_get_world_shape(colliders, pair.second);
+    collision_info_t collision = sat_find_collision(&shape1, &shape2);
+    contact->collided = collision.collided;
+    contact->axis = collision.axis;
+  }
+}
+
+/**
+ * Finds candidate pairs with the broad-phase grid and runs the narrow-phase
+ * collision test on those pairs only, spread over the job pool. Handlers are
+ * then called on the calling thread in broad-phase order, so the outcome
+ * does not depend on the number of threads.
+ *
+ * @param state the state
+ */
+void resolve_collisions(state_t *state) {
+  PROFILE_BEGIN(broadphase_start);
+  colliders_t *colliders = state->colliders;
+  broadphase_t *broadphase = state->broadphase;
+  colliders_update(colliders);
+  broadphase_clear(broadphase);
+  size_t n_colliders = colliders_size(colliders);
+  for (size_t i = 0; i < n_colliders; i++) {
+    if (!colliders_is_active(colliders, i)) {
+      continue;
+    }
+    vector_t min, max;
+    colliders_get_bounds(colliders, i, &min, &max);
+    broadphase_add(broadphase, i, min, max, colliders_is_static(colliders, i),
+                   colliders_get_category(colliders, i),
+                   colliders_get_mask(colliders, i));
+  }
+
+  broadphase_pair_t *pairs;
+  size_t n_pairs = broadphase_pairs(broadphase, &pairs);
+  if (n_pairs > state->contact_capacity) {
+    state->contact_capacity = n_pairs * 2;
+    state->contacts =
+        realloc(state->contacts, state->contact_capacity * sizeof(contact_t));
+    assert(state->contacts);
+  }
+  PROFILE_END(PROFILE_BROADPHASE, broadphase_start);
+
+  PROFILE_BEGIN(narrowphase_start);
+  job_pool_run(state->job_pool, n_colliders, SHAPE_JOB_GRAIN,
+               transform_shapes_job, colliders);
+  narrow_phase_t narrow_phase = {.state = state, .pairs = pairs};
+  job_pool_run(state->job_pool, n_pairs, PAIR_JOB_GRAIN, narrow_phase_job,
+               &narrow_phase);
+  PROFILE_END(PROFILE_NARROWPHASE, narrowphase_start);
+
+  PROFILE_BEGIN(handlers_start);
+  state->round_reset = false;
+  for (size_t i = 0; i < n_pairs && !state->round_reset; i++) {
+    contact_t contact = state->contacts[i];
+    if (!contact.collided) {
+      continue;
+    }
+    // an earlier handler in this pass may have destroyed either body
+    if (!colliders_is_active(colliders, pairs[i].first) ||
+        !colliders_is_active(colliders, pairs[i].second)) {
+      continue;
+    }
+    body_t *body1 = colliders_get_body(colliders, pairs[i].first);
+    body_t *body2 = colliders_get_body(colliders, pairs[i].second);
+    state->handler_indices[0] = pairs[i].first;
+    state->handler_indices[1] = pairs[i].second;
+    if (contact.entry.swap) {
+      contact.entry.handler(body2, body1, contact.axis, state, ELASTICITY);
+    } else {
+      contact.entry.handler(body1, body2, contact.axis, state, ELASTICITY);
+    }
+  }
+  PROFILE_END(PROFILE_HANDLERS, handlers_start);
+}
+
+/**
+ * Slows every active ship and asteroid in proportion to its velocity. This
+ * runs over the colliders instead of as a drag force creator per body, so
+ * parked asteroids cost nothing.
+ *
+ * @param state the state
+ */
+void apply_drag(state_t *state) {
+  colliders_t *colliders = state->colliders;
+  uint32_t dragged = collision_category(SHIP) | collision_category(ASTEROID);
+  size_t n_colliders = colliders_size(colliders);
+  for (size_t i = 0; i < n_colliders; i++) {
+    if (!colliders_is_active(colliders, i) ||
+        !(colliders_get_category(colliders, i) & dragged)) {
+      continue;
+    }
+    body_t *body = colliders_get_body(colliders, i);
+    body_add_force(body, vec_multiply(-DRAG_COEF, body_get_velocity(body)));
+  }
+}
+
+/**
+ * Pulls every moving body towards the map's black holes, and the moving
+ * bodies towards each other on maps with mutual gravity. The black holes
+ * never move, so their pull comes from a precomputed field; the bodies'
+ * pull on each other comes from a Barnes-Hut tree rebuilt every tick.
+ *
+ * @param state the state
+ */
+void apply_gravity(state_t *state) {
+  if (state->gravity_field == NULL && state->gravity_tree == NULL) {
+    return;
+  }
+  colliders_t *colliders = state->colliders;
+  size_t n_colliders = colliders_size(colliders);
+  body_t **bodies =
+      arena_alloc(state->frame_arena, n_colliders * sizeof(body_t *));
+  vector_t *positions =
+      arena_alloc(state->frame_arena, n_colliders * sizeof(vector_t));
+  double *masses =
+      arena_alloc(state->frame_arena, n_colliders * sizeof(double));
+  size_t n = 0;
+  for (size_t i = 0; i < n_colliders; i++) {
+    body_t *body = colliders_get_body(colliders, i);
+    if (!colliders_is_active(colliders, i) ||
+        colliders_is_static(colliders, i)) {
+      continue;
+    }
+    bodies[n] = body;
+    positions[n] = body_get_centroid(body);
+    masses[n++] = body_get_mass(body);
+  }
+
+  if (state->gravity_tree != NULL) {
+    gravity_tree_build(state->gravity_tree, positions, masses, n);
+  }
+  for (size_t i = 0; i < n; i++) {
+    vector_t acceleration = VEC_ZERO;
+    if (state->gravity_field != NULL) {
+      acceleration = gravity_field_sample(state->gravity_field, positions[i]);
+    }
+    if (state->gravity_tree != NULL) {
+      vector_t pull = gravity_tree_sample(state->gravity_tree, positions[i]);
+      acceleration = vec_add(acceleration, pull);
+    }
+    body_add_force(bodies[i], vec_multiply(masses[i], acceleration));
+  }
+}
+
+void game_tick(state_t *state, double dt) {
+  PROFILE_BEGIN(tick_start);
+  colliders_save_transforms(state->colliders);
+  double start = PHASE_TIME();
+  if (state->opponent == OPPONENT_PLANNER) {
+    apply_planner_input(state);
+  }
+  if (state->replay_writer != NULL) {
+    replay_writer_record(state->replay_writer, state, state->input, dt);
+  }
+  apply_input(state, dt);
+  double input_done = PHASE_TIME();
+  PROFILE_RECORD(PROFILE_INPUT, start, input_done);
+  resolve_collisions(state);
+  double collisions_done = PHASE_TIME();
+  spin_ships(state, dt);
+  apply_drag(state);
+  apply_gravity(state);
+  scene_tick(state->scene, dt);
+  // bounds follow the bodies as they move, for culling before rendering
+  colliders_update(state->colliders);
+  double scene_done = PHASE_TIME();
+  PROFILE_RECORD(PROFILE_SCENE_TICK, collisions_done, scene_done);
+
+  state->timings.input += input_done - start;
+  state->timings.collisions += collisions_done - input_done;
+  state->timings.scene += scene_done - collisions_done;
+  state->time += dt;
+  PROFILE_END(PROFILE_TICK, tick_start);
+}
+
 void add_ship(state_t *state, vector_t pos, size_t team) {
   vector_t velocity = vec_make(INIT_SHIP_SPEED, INIT_SHIP_ANGLES[team]);
   body_t *ship_body = make_ship(pos, team, velocity, INIT_SHIP_ANGLES[team], 
                                 SHIP_BASE, SHIP_HEIGHT, SHIP_MASS);
-  scene_add_body(state->scene, ship_body);
+  state->player_indices[team] = add_body(state, ship_body);
 }
 
 void add_bounds(state_t *state) {
@@ -318,10 +919,10 @@ void add_bounds(state_t *state) {
       make_rectangle((vector_t){MAX.x / 2, 0}, MAX.x, WALL_DIM);
   body_t *ground = body_init_with_info(ground_shape, INFINITY, WHITE,
                                        entity_info_init(WALL, 100), free);
-  scene_add_body(state->scene, wall1);
-  scene_add_body(state->scene, wall2);
-  scene_add_body(state->scene, ceiling);
-  scene_add_body(state->scene, ground);
+  add_body(state, wall1);
+  add_body(state, wall2);
+  add_body(state, ceiling);
+  add_body(state, ground);
 }
 
 void add_obstacles(state_t *state){
@@ -330,34 +931,278 @@ void add_obstacles(state_t *state){
     list_t *block_shape = make_rectangle(state->map.block_locations[i], state->map.block_sizes[i].x, state->map.block_sizes[i].y);
     body_t *block = body_init_with_info(block_shape, INFINITY, WHITE,
                                       entity_info_init(WALL, 100), free);
-    scene_add_body(state->scene, block);
+    add_body(state, block);
   }
 }
 
-void add_asteroids(state_t *state){
-  for(size_t i = 0; i < state->map.num_asteroids; i++){
-    bool pos_found = false;
-    vector_t pos = (vector_t) {rand_double()*MAX.x, rand_double()*MAX.y};
-    body_t *asteroid = make_asteroid(pos, 10 + rand_double() * 30, VEC_ZERO, 
-                                     ASTEROID_MASS_DENSITY);
-    while(!pos_found){
-      pos_found = true;
-      pos = (vector_t) {rand_double()*MAX.x, rand_double()*MAX.y};
-      body_set_centroid(asteroid, pos);
-      size_t n_bodies = scene_bodies(state->scene);
-      
-      for (size_t i = 0; i < n_bodies; i++) {
-        body_t *body = scene_get_body(state->scene, i);
-        if(find_collision(body, asteroid).collided){
-          pos_found = false;
+/**
+ * Marks the cells of the occupancy grid that overlap a box as taken.
+ *
+ * @param is_free the occupancy grid, row by row
+ * @param cols the number of columns in the grid
+ * @param rows the number of rows in the grid
+ * @param min the bottom left corner of the box
+ * @param max the top right corner of the box
+ */
+void occupy_cells(bool *is_free, size_t cols, size_t rows, vector_t min,
+                  vector_t max) {
+  double first_col = floor((min.x - MIN.x) / OCCUPANCY_CELL_SIZE);
+  double last_col = floor((max.x - MIN.x) / OCCUPANCY_CELL_SIZE);
+  double first_row = floor((min.y - MIN.y) / OCCUPANCY_CELL_SIZE);
+  double last_row = floor((max.y - MIN.y) / OCCUPANCY_CELL_SIZE);
+  if (last_col < 0 || first_col >= cols || last_row < 0 || first_row >= rows) {
+    return;
+  }
+  size_t col_end = fmin(last_col, cols - 1);
+  size_t row_end = fmin(last_row, rows - 1);
+  for (size_t row = fmax(first_row, 0); row <= row_end; row++) {
+    for (size_t col = fmax(first_col, 0); col <= col_end; col++) {
+      is_free[row * cols + col] = false;
+    }
+  }
+}
+
+/**
+ * Scatters the map's asteroids by Poisson-disk sampling, keeping them apart
+ * from each other and clear of every body already in the scene.
+ *
+ * An occupancy grid marks the cells near walls, blocks, ships and black
+ * holes. Every free cell is tried once, in random order, with a random
+ * point inside it, which is kept unless a background grid holding at most
+ * one asteroid per cell has another asteroid too close. Placement takes
+ * time linear in the area of the map and always finishes; if not every
+ * asteroid fits, fewer are placed.
+ *
+ * @param state the state
+ */
+void add_asteroids(state_t *state) {
+  colliders_t *colliders = state->colliders;
+  double clearance = MAX_ASTEROID_RADIUS + ASTEROID_GAP;
+  size_t cols = ceil((MAX.x - MIN.x) / OCCUPANCY_CELL_SIZE);
+  size_t rows = ceil((MAX.y - MIN.y) / OCCUPANCY_CELL_SIZE);
+  bool *is_free = malloc(cols * rows * sizeof(bool));
+  assert(is_free);
+  for (size_t cell = 0; cell < cols * rows; cell++) {
+    is_free[cell] = true;
+  }
+  // the exact boxes of the shapes, since the bounds of long walls are loose
+  for (size_t i = 0; i < colliders_size(colliders); i++) {
+    if (!colliders_is_active(colliders, i)) {
+      continue;
+    }
+    sat_polygon_t shape = colliders_get_shape(colliders, i);
+    vector_t min = {INFINITY, INFINITY};
+    vector_t max = {-INFINITY, -INFINITY};
+    for (size_t j = 0; j < shape.num_vertices; j++) {
+      min = (vector_t){fmin(min.x, shape.xs[j]), fmin(min.y, shape.ys[j])};
+      max = (vector_t){fmax(max.x, shape.xs[j]), fmax(max.y, shape.ys[j])};
+    }
+    occupy_cells(is_free, cols, rows,
+                 vec_subtract(min, (vector_t){clearance, clearance}),
+                 vec_add(max, (vector_t){clearance, clearance}));
+  }
+  double blackhole_clearance = clearance + BLACKHOLE_RADIUS;
+  for (size_t i = 0; i < state->map.num_blackholes; i++) {
+    vector_t location = state->map.blackhole_locations[i];
+    occupy_cells(
+        is_free, cols, rows,
+        vec_subtract(location,
+                     (vector_t){blackhole_clearance, blackhole_clearance}),
+        vec_add(location,
+                (vector_t){blackhole_clearance, blackhole_clearance}));
+  }
+  size_t *free_cells = malloc(cols * rows * sizeof(size_t));
+  assert(free_cells);
+  size_t num_free = 0;
+  for (size_t cell = 0; cell < cols * rows; cell++) {
+    if (is_free[cell]) {
+      free_cells[num_free++] = cell;
+    }
+  }
+
+  // a sample cell's diagonal is the spacing, so it holds at most one
+  // asteroid and only the 5x5 cells around a point can hold its neighbors
+  double spacing = 2 * MAX_ASTEROID_RADIUS + ASTEROID_GAP;
+  double sample_cell_size = spacing / sqrt(2);
+  size_t sample_cols = ceil((MAX.x - MIN.x) / sample_cell_size);
+  size_t sample_rows = ceil((MAX.y - MIN.y) / sample_cell_size);
+  size_t *sample_grid = malloc(sample_cols * sample_rows * sizeof(size_t));
+  vector_t *placed = malloc(state->map.num_asteroids * sizeof(vector_t));
+  assert(sample_grid && (placed || state->map.num_asteroids == 0));
+  for (size_t cell = 0; cell < sample_cols * sample_rows; cell++) {
+    sample_grid[cell] = NO_SAMPLE;
+  }
+
+  size_t num_placed = 0;
+  for (size_t i = 0; i < num_free && num_placed < state->map.num_asteroids;
+       i++) {
+    // draw the free cells in random order, shuffling as they are drawn
+    size_t pick = i + rand() % (num_free - i);
+    size_t cell = free_cells[pick];
+    free_cells[pick] = free_cells[i];
+    vector_t pos = {
+        MIN.x + ((cell % cols) + rand_double()) * OCCUPANCY_CELL_SIZE,
+        MIN.y + ((cell / cols) + rand_double()) * OCCUPANCY_CELL_SIZE};
+    size_t sample_col = fmin((pos.x - MIN.x) / sample_cell_size,
+                             sample_cols - 1);
+    size_t sample_row = fmin((pos.y - MIN.y) / sample_cell_size,
+                             sample_rows - 1);
+    bool too_close = false;
+    for (size_t row = sample_row > 2 ? sample_row - 2 : 0;
+         row <= sample_row + 2 && row < sample_rows && !too_close; row++) {
+      for (size_t col = sample_col > 2 ? sample_col - 2 : 0;
+           col <= sample_col + 2 && col < sample_cols; col++) {
+        size_t neighbor = sample_grid[row * sample_cols + col];
+        if (neighbor != NO_SAMPLE &&
+            vec_get_length(vec_subtract(placed[neighbor], pos)) < spacing) {
+          too_close = true;
           break;
         }
       }
     }
-    scene_add_body(state->scene, asteroid);
+    if (too_close) {
+      continue;
+    }
+    sample_grid[sample_row * sample_cols + sample_col] = num_placed;
+    placed[num_placed++] = pos;
+
+    double radius = MIN_ASTEROID_RADIUS +
+                    rand_double() * (MAX_ASTEROID_RADIUS - MIN_ASTEROID_RADIUS);
+    add_body(state,
+             make_asteroid(pos, radius, VEC_ZERO, ASTEROID_MASS_DENSITY));
+  }
+  free(is_free);
+  free(free_cells);
+  free(sample_grid);
+  free(placed);
+}
+
+#ifndef HEADLESS
+/**
+ * Gets the image of one of a map's background layers.
+ *
+ * @param map the map
+ * @param layer 0 for the backdrop, or 1 + the index of a parallax layer
+ * @return the image path, or NULL if the map has no backdrop
+ */
+const char *bg_layer_path(map_t map, size_t layer) {
+  return layer == 0 ? map.backdrop_path : map.bg_paths[layer - 1];
+}
+
+/**
+ * Gets where one of a map's background layers is drawn, in window pixels.
+ *
+ * @param map the map
+ * @param layer 0 for the backdrop, or 1 + the index of a parallax layer
+ * @return the layer's box
+ */
+SDL_Rect bg_layer_box(map_t map, size_t layer) {
+  if (layer == 0) {
+    return (SDL_Rect){
+      .x = MIN.x, .y = MIN.y, .w = MAX.x - MIN.x, .h = MAX.y - MIN.y};
+  }
+  return (SDL_Rect){.x = map.bg_pos[layer - 1].x,
+                    .y = map.bg_pos[layer - 1].y,
+                    .w = map.bg_sizes[layer - 1].x,
+                    .h = map.bg_sizes[layer - 1].y};
+}
+
+/**
+ * Queues the images of a page for the preloader.
+ *
+ * @param state the state
+ * @param info the image infos of a page
+ * @param info_size the size of the array of image info's
+ */
+void preload_images(state_t *state, image_info_t info[], size_t info_size) {
+  for (size_t i = 0; i < info_size; i++) {
+    if (info[i].image_path != NULL) {
+      preloader_request(state->preloader, info[i].image_path, PRELOAD_IMAGE);
+    }
   }
 }
 
+/**
+ * Queues the files the game needs before the home page can be shown:
+ * its images, the music and the sound effects. The post game page's images
+ * come last, since they are not needed for a while.
+ *
+ * @param state the state
+ */
+void preload_startup(state_t *state) {
+  preload_images(state, home_images,
+                 sizeof(home_images) / sizeof(home_images[0]));
+  preloader_request(state->preloader, BACKGROUND_TRACK, PRELOAD_MUSIC);
+  preloader_request(state->preloader, SHOOT_SOUND_PATH, PRELOAD_SOUND);
+  preloader_request(state->preloader, BOOST_SOUND_PATH, PRELOAD_SOUND);
+  preload_images(state, post_game_images,
+                 sizeof(post_game_images) / sizeof(post_game_images[0]));
+}
+
+/**
+ * Queues a map's background layers for the preloader. Maps already queued
+ * are skipped, so this is cheap to call every frame.
+ *
+ * @param state the state
+ * @param map the index of the map
+ */
+void preload_map(state_t *state, size_t map) {
+  for (size_t layer = 0; layer <= maps[map]->num_bg; layer++) {
+    const char *path = bg_layer_path(*maps[map], layer);
+    if (path != NULL) {
+      preloader_request(state->preloader, path, PRELOAD_IMAGE);
+    }
+  }
+}
+
+/**
+ * Takes every file the preloader has decoded: images are uploaded to the
+ * atlas in one batch, sounds are kept and music starts playing.
+ *
+ * @param state the state
+ */
+void receive_preloaded(state_t *state) {
+  // files are only requested on this thread, so no more than `requested`
+  // can arrive here
+  size_t decoded, requested;
+  preloader_progress(state->preloader, &decoded, &requested);
+  const char **paths =
+      arena_alloc(state->frame_arena, requested * sizeof(char *));
+  SDL_Surface **images =
+      arena_alloc(state->frame_arena, requested * sizeof(SDL_Surface *));
+  size_t num_images = 0;
+  preload_result_t result;
+  while (preloader_poll(state->preloader, &result)) {
+    switch (result.type) {
+      case PRELOAD_IMAGE:
+        paths[num_images] = result.path;
+        images[num_images++] = result.image;
+        break;
+      case PRELOAD_SOUND:
+        if (strcmp(result.path, SHOOT_SOUND_PATH) == 0) {
+          state->shoot_sound = result.sound;
+        } else {
+          state->boost_sound = result.sound;
+        }
+        break;
+      case PRELOAD_MUSIC:
+        state->backing_track = result.music;
+        if (result.music != NULL) {
+          sdl_play_music(result.music);
+        }
+        break;
+    }
+  }
+
+  atlas_add_images(state->atlas, paths, images, num_images);
+  for (size_t i = 0; i < num_images; i++) {
+    if (images[i] != NULL) {
+      SDL_FreeSurface(images[i]);
+    }
+  }
+}
+#endif
+
 /**
  * Initializes map elements such as ships, obstacles, asteroids, and background images
  * and adds them to the scene and state.
@@ -365,163 +1210,672 @@ void add_asteroids(state_t *state){
  * @param state the state
  */
 void map_init(state_t *state){
-  map_t map = maps[state->map_selected];
+  map_t map = *maps[state->map_selected];
   state->map = map;
 
   add_ship(state, map.start_pos[0], 0);
   add_ship(state, map.start_pos[1], 1);
+  bullet_pool_init(state);
 
   add_obstacles(state);
   add_asteroids(state);
 
-  if (map.backdrop_path != NULL) {
-    SDL_Rect background_bbox = (SDL_Rect){
-      .x = MIN.x, .y = MIN.y, .w = MAX.x - MIN.x, .h = MAX.y - MIN.y};
-    asset_t *background_asset =
-      asset_make_image(map.backdrop_path, background_bbox);
-    list_add(state->game_assets, background_asset);
+  if (state->gravity_field != NULL) {
+    gravity_field_free(state->gravity_field);
+    state->gravity_field = NULL;
   }
-  
-  for(size_t i = 0; i < map.num_bg; i++){
-    SDL_Rect background_bbox = (SDL_Rect){
-      .x = map.bg_pos[i].x, .y = map.bg_pos[i].y, .w = map.bg_sizes[i].x, .h = map.bg_sizes[i].y};
-    asset_t *background_asset =
-      asset_make_image(map.bg_paths[i], background_bbox);
+  if (map.num_blackholes > 0) {
+    state->gravity_field = gravity_field_init(
+        MIN, MAX, GRAVITY_CELL_SIZE, BLACKHOLE_G, GRAVITY_SOFTENING,
+        map.blackhole_locations, map.blackhole_masses, map.num_blackholes);
+  }
+  if (state->gravity_tree != NULL) {
+    gravity_tree_free(state->gravity_tree);
+    state->gravity_tree = NULL;
+  }
+  if (map.mutual_gravity > 0) {
+    state->gravity_tree = gravity_tree_init(map.mutual_gravity,
+                                            GRAVITY_SOFTENING, GRAVITY_THETA);
+  }
+
+#ifndef HEADLESS
+  // layer 0 is the backdrop, followed by the parallax layers
+  free(state->bg_assets);
+  state->bg_assets = calloc(map.num_bg + 1, sizeof(asset_t *));
+  assert(state->bg_assets);
+  for (size_t layer = 0; layer <= map.num_bg; layer++) {
+    const char *path = bg_layer_path(map, layer);
+    size_t index;
+    if (path == NULL || atlas_find(state->atlas, path, &index)) {
+      continue;
+    }
+    asset_t *background_asset = asset_make_image(path, bg_layer_box(map, layer));
     list_add(state->game_assets, background_asset);
+    state->bg_assets[layer] = background_asset;
+  }
+#endif
+}
+
+void handle_turn(body_t *ship, double time_held, double dt) {
+  // increase rotation speed at log rate
+  double rot_speed = PLAYER_ROT_SPEED * fmin(2, 1 + log(time_held * PLAYER_ROT_ACCEL + 1));
+  double da = rot_speed * dt;
+  double curr_angle = body_get_rotation(ship);
+  body_set_rotation(ship, curr_angle + da);
+}
+
+void play_sound(Mix_Chunk *sound) {
+#ifndef HEADLESS
+  // sounds are NULL until the preloader has decoded them
+  if (sound != NULL) {
+    sdl_play_sound(sound);
+  }
+#endif
+}
+
+void handle_boost(state_t *state, size_t player,
+                  double time_since_last_release) {
+  if (time_since_last_release < DOUBLE_TAP_TIME) {
+    body_t *ship = player == 0 ? state->player1 : state->player2;
+    double angle = body_get_rotation(ship);
+    vector_t boost_impulse = vec_make(body_get_mass(ship) * BOOST_VELOCITY, angle + BOOST_ANGLE);
+    body_add_impulse(ship, boost_impulse);
+    state->ship_spin[player] += BOOST_ROT_SPEED;
+    play_sound(state->boost_sound);
+  }
+}
+
+/**
+ * Turns the ships by their spin and slows the spin down. Spin is kept in
+ * the state rather than the bodies so that snapshots can capture it.
+ *
+ * @param state the state
+ * @param dt the length of the tick
+ */
+void spin_ships(state_t *state, double dt) {
+  body_t *ships[] = {state->player1, state->player2};
+  for (size_t i = 0; i < 2; i++) {
+    double spin = state->ship_spin[i];
+    body_set_rotation(ships[i], body_get_rotation(ships[i]) + spin * dt);
+    state->ship_spin[i] -= spin * ROT_DRAG_FACTOR * dt;
+  }
+}
+
+/**
+ * Turns a ship while its turn key is held, and boosts it when the key is
+ * released twice in quick succession.
+ *
+ * @param state the state
+ * @param player the index of the player owning the ship
+ * @param held whether the turn key is held this tick
+ * @param dt the length of the tick
+ */
+void handle_turn_key(state_t *state, size_t player, bool held, double dt) {
+  body_t *ship = player == 0 ? state->player1 : state->player2;
+  double now = state->time;
+  if (held) {
+    if (!state->turn_held[player]) {
+      state->turn_pressed_at[player] = now;
+    }
+    state->turn_held[player] = true;
+    double time_held = fmax(dt, now - state->turn_pressed_at[player]);
+    handle_turn(ship, time_held, dt);
+  } else if (state->turn_held[player]) {
+    state->turn_held[player] = false;
+    handle_boost(state, player, now - state->turn_released_at[player]);
+    state->turn_released_at[player] = now;
+  }
+}
+
+void handle_shoot(state_t *state, body_t *ship) {
+  // check if player has shot before reload time is up
+  size_t player = ship == state->player1 ? 0 : 1;
+  double now = state->time;
+  if (now - state->time_of_last_shot[player] < RELOAD_TIME) {
+    return;
+  }
+
+  if (!fire_bullet(state, ship)) {
+    return;
+  }
+  play_sound(state->shoot_sound);
+
+  // update time of last shot by player
+  state->time_of_last_shot[player] = now;
+}
+
+/**
+ * Applies the keys held this tick to the ships.
+ *
+ * @param state the state
+ * @param dt the length of the tick
+ */
+void apply_input(state_t *state, double dt) {
+  uint32_t input = state->input;
+  handle_turn_key(state, 0, input & INPUT_P1_TURN, dt);
+  handle_turn_key(state, 1, input & INPUT_P2_TURN, dt);
+  if (input & INPUT_P1_SHOOT) {
+    handle_shoot(state, state->player1);
+  }
+  if (input & INPUT_P2_SHOOT) {
+    handle_shoot(state, state->player2);
+  }
+}
+
+uint32_t input_from_keys(const Uint8 *key_state) {
+  uint32_t input = 0;
+  if (key_state[P1_TURN]) {
+    input |= INPUT_P1_TURN;
+  }
+  if (key_state[P1_SHOOT]) {
+    input |= INPUT_P1_SHOOT;
+  }
+  if (key_state[P2_TURN]) {
+    input |= INPUT_P2_TURN;
+  }
+  if (key_state[P2_SHOOT]) {
+    input |= INPUT_P2_SHOOT;
+  }
+  return input;
+}
+
+void keys_from_input(Uint8 *key_state, uint32_t input) {
+  key_state[P1_TURN] = (input & INPUT_P1_TURN) != 0;
+  key_state[P1_SHOOT] = (input & INPUT_P1_SHOOT) != 0;
+  key_state[P2_TURN] = (input & INPUT_P2_TURN) != 0;
+  key_state[P2_SHOOT] = (input & INPUT_P2_SHOOT) != 0;
+}
+
+/**
+ * Lets the bot write player 2's keys into `key_state`.
+ *
+ * @param state the state
+ * @param key_state the keys held this tick
+ */
+void run_bot(state_t *state, Uint8 *key_state) {
+  double start = PHASE_TIME();
+  game_info_t *info = arena_alloc(state->frame_arena, sizeof(game_info_t));
+  *info = (game_info_t) {
+    .p1 = state->player1,
+    .p2 = state->player2,
+    .bullet_speed = BULLET_SPEED,
+    .bullet_radius = BULLET_RADIUS,
+    .ship_base = SHIP_BASE,
+    .ship_height = SHIP_HEIGHT,
+    .ship_rot_speed = PLAYER_ROT_SPEED, 
+    .double_tap_thresh = DOUBLE_TAP_THRESH,
+    .scene = state->scene,
+    .dt = state->dt
+  };
+  bot_move(key_state, info, state->player2);
+  double end = PHASE_TIME();
+  state->timings.bot += end - start;
+  PROFILE_RECORD(PROFILE_BOT, start, end);
+}
+
+planner_body_t planner_body(colliders_t *colliders, size_t index) {
+  body_t *body = colliders_get_body(colliders, index);
+  return (planner_body_t){.position = body_get_centroid(body),
+                          .velocity = body_get_velocity(body),
+                          .angle = body_get_rotation(body),
+                          .radius = colliders_get_radius(colliders, index),
+                          .mass = body_get_mass(body)};
+}
+
+/**
+ * Copies the bodies the planner simulates into a planner_world_t allocated
+ * from the frame arena.
+ *
+ * @param state the state
+ * @return a snapshot of the arena from player 2's point of view
+ */
+planner_world_t *make_planner_world(state_t *state) {
+  colliders_t *colliders = state->colliders;
+  size_t n_colliders = colliders_size(colliders);
+  planner_world_t *world = arena_alloc(state->frame_arena,
+                                       sizeof(planner_world_t));
+  world->asteroids =
+      arena_alloc(state->frame_arena, n_colliders * sizeof(planner_body_t));
+  world->bullets =
+      arena_alloc(state->frame_arena, n_colliders * sizeof(planner_body_t));
+  world->obstacles =
+      arena_alloc(state->frame_arena, n_colliders * sizeof(planner_box_t));
+  world->num_asteroids = 0;
+  world->num_bullets = 0;
+  world->num_obstacles = 0;
+  world->min = MIN;
+  world->max = MAX;
+
+  for (size_t i = 0; i < n_colliders; i++) {
+    body_t *body = colliders_get_body(colliders, i);
+    if (!colliders_is_active(colliders, i)) {
+      continue;
+    }
+    switch (get_type(body)) {
+    case SHIP:
+      if (body == state->player2) {
+        world->self = planner_body(colliders, i);
+      } else {
+        world->target = planner_body(colliders, i);
+      }
+      break;
+    case ASTEROID:
+      world->asteroids[world->num_asteroids++] = planner_body(colliders, i);
+      break;
+    case BULLET:
+      world->bullets[world->num_bullets] = planner_body(colliders, i);
+      world->bullets[world->num_bullets++].radius = BULLET_RADIUS;
+      break;
+    case WALL: {
+      sat_polygon_t shape = colliders_get_shape(colliders, i);
+      planner_box_t box = {{INFINITY, INFINITY}, {-INFINITY, -INFINITY}};
+      for (size_t j = 0; j < shape.num_vertices; j++) {
+        box.min.x = fmin(box.min.x, shape.xs[j]);
+        box.min.y = fmin(box.min.y, shape.ys[j]);
+        box.max.x = fmax(box.max.x, shape.xs[j]);
+        box.max.y = fmax(box.max.y, shape.ys[j]);
+      }
+      world->obstacles[world->num_obstacles++] = box;
+      break;
+    }
+    default:
+      break;
+    }
+  }
+
+  world->turn_held = state->turn_held[1];
+  world->time_since_turn_press = state->time - state->turn_pressed_at[1];
+  world->time_since_turn_release = state->time - state->turn_released_at[1];
+  world->time_since_shot = state->time - state->time_of_last_shot[1];
+  return world;
+}
+
+/**
+ * Lets the planner improve player 2's plan. Its keys are then read one tick
+ * at a time by apply_planner_input().
+ *
+ * @param state the state
+ * @param deadline the timer_now() time by which to stop planning
+ * @param max_rollouts the largest number of rollouts to run
+ */
+void run_planner(state_t *state, double deadline, size_t max_rollouts) {
+  double start = PHASE_TIME();
+  if (state->planner == NULL) {
+    planner_params_t params = {
+      .dt = state->physics_dt,
+      .horizon = PLANNER_HORIZON,
+      .thrust = THRUST_POWER,
+      .drag = DRAG_COEF,
+      .rot_drag = ROT_DRAG_FACTOR,
+      .rot_speed = PLAYER_ROT_SPEED,
+      .rot_accel = PLAYER_ROT_ACCEL,
+      .boost_velocity = BOOST_VELOCITY,
+      .boost_angle = BOOST_ANGLE,
+      .boost_rot_speed = BOOST_ROT_SPEED,
+      .double_tap_time = DOUBLE_TAP_TIME,
+      .reload_time = RELOAD_TIME,
+      .bullet_speed = BULLET_SPEED,
+      .bullet_radius = BULLET_RADIUS,
+      .ship_height = SHIP_HEIGHT
+    };
+    state->planner = planner_init(params, state->job_pool, rand());
+  }
+  planner_plan(state->planner, make_planner_world(state), deadline,
+               max_rollouts);
+  double end = PHASE_TIME();
+  state->timings.bot += end - start;
+  PROFILE_RECORD(PROFILE_PLANNER, start, end);
+}
+
+/**
+ * Replaces player 2's keys with the next tick of the planner's plan.
+ *
+ * @param state the state
+ */
+void apply_planner_input(state_t *state) {
+  if (state->planner == NULL) {
+    return;
+  }
+  uint32_t keys = planner_next_input(state->planner);
+  state->input &= ~(INPUT_P2_TURN | INPUT_P2_SHOOT);
+  if (keys & PLANNER_TURN) {
+    state->input |= INPUT_P2_TURN;
+  }
+  if (keys & PLANNER_SHOOT) {
+    state->input |= INPUT_P2_SHOOT;
+  }
+}
+
+/**
+ * Called by the SDL wrapper with this frame's keys. Records them as the
+ * input applied on the next tick.
+ *
+ * @param state the state
+ */
+void on_key(state_t *state) {
+  if (state->mode != GAME || !state->key_state) { 
+    return; 
+  }
+
+  state->input = input_from_keys(state->key_state);
+  free(state->key_state);
+  state->key_state = NULL;
+}
+
+/**
+ * Gives the ships their thrust. Drag is applied by apply_drag() instead.
+ *
+ * @param state the state
+ */
+void add_force_creators(state_t *state) {
+  for (size_t i = 0; i < scene_bodies(state->scene); i++) {
+    body_t *body = scene_get_body(state->scene, i);
+    if (get_type(body) == SHIP) {
+      create_thrust(state->scene, THRUST_POWER, body);
+      state->num_force_creators++;
+    }
+  }
+}
+
+/**
+ * Called when the play button is clicked. Initializes the game page based on home page
+ * selections.
+ * 
+ * @param state the state
+ */
+void toggle_play(state_t *state) {
+  state->mode = GAME;
+#ifndef HEADLESS
+  // the map was prefetched on the home page; wait for whatever is left
+  preload_map(state, state->map_selected);
+  preloader_finish(state->preloader);
+  receive_preloaded(state);
+#endif
+  // the seed alone decides the layout, so replays can rebuild it
+  srand(state->seed);
+  map_init(state);
+  state->player1 = scene_get_body(state->scene, 0);
+  state->player2 = scene_get_body(state->scene, 1);
+  state->accumulator = 0;
+
+  add_force_creators(state);
+#ifndef HEADLESS
+  sim_record(state, REPLAY_PATH);
+#endif
+}
+
+/**
+ * Allocates the state shared by the game and the headless simulation.
+ * Rendering and audio fields are left empty.
+ *
+ * @return the new state
+ */
+state_t *state_init(void) {
+  state_t *state = calloc(1, sizeof(state_t));
+  assert(state);
+  state->mode = HOME;
+  state->P1_score = 0;
+  state->P2_score = 0;
+  state->opponent = OPPONENT_PLAYER;
+  state->planner = NULL;
+  load_maps();
+  assert(num_maps > 0);
+  state->map_selected = 0;
+  state->seed = 0;
+  state->time = 0;
+  for (size_t i = 0; i < 2; i++) {
+    state->time_of_last_shot[i] = -RELOAD_TIME;
+    state->turn_held[i] = false;
+    state->turn_pressed_at[i] = -INFINITY;
+    state->turn_released_at[i] = -INFINITY;
+    state->ship_spin[i] = 0;
+  }
+  state->input = 0;
+  state->timings = (sim_timings_t){0};
+  state->replay_writer = NULL;
+  state->physics_dt = 1 / PHYSICS_RATE;
+  state->accumulator = 0;
+  state->last_frame_time = timer_now();
+  state->dt = 0;
+  state->key_state = NULL;
+  state->bullet_pool = NULL;
+  state->gravity_field = NULL;
+  state->gravity_tree = NULL;
+  collision_table_init(state);
+  state->job_pool = job_pool_init(1);
+  state->contacts = NULL;
+  state->contact_capacity = 0;
+  state->round_reset = false;
+  state->num_force_creators = 0;
+  state->num_bodies_drawn = 0;
+  state->frame_arena = arena_init(FRAME_ARENA_SIZE);
+  state->scene = scene_init();
+  state->colliders = colliders_init(INITIAL_GAME_CAPACITY);
+  state->broadphase = broadphase_init(MIN, MAX, BROADPHASE_CELL_SIZE);
+  return state;
+}
+
+void state_free(state_t *state) {
+  if (state->replay_writer != NULL) {
+    replay_writer_free(state->replay_writer);
+  }
+  scene_free(state->scene);
+  colliders_free(state->colliders);
+  broadphase_free(state->broadphase);
+  if (state->gravity_field != NULL) {
+    gravity_field_free(state->gravity_field);
+  }
+  if (state->gravity_tree != NULL) {
+    gravity_tree_free(state->gravity_tree);
+  }
+  if (state->bullet_pool != NULL) {
+    bullet_pool_free(state->bullet_pool);
+  }
+  arena_free(state->frame_arena);
+  if (state->planner != NULL) {
+    planner_free(state->planner);
+  }
+  job_pool_free(state->job_pool);
+  free(state->contacts);
+  free(state);
+}
+
+size_t sim_num_maps(void) {
+  load_maps();
+  return num_maps;
+}
+
+state_t *sim_init(size_t map, unsigned int seed, opponent_t opponent) {
+  assert(map < sim_num_maps());
+  state_t *state = state_init();
+  state->map_selected = map;
+  state->seed = seed;
+  state->opponent = opponent;
+  toggle_play(state);
+  return state;
+}
+
+void sim_tick(state_t *state, double dt, uint32_t input) {
+  arena_reset(state->frame_arena);
+  state->dt = dt;
+  state->physics_dt = dt;
+  if (state->opponent == OPPONENT_PLANNER) {
+    run_planner(state, INFINITY, SIM_PLANNER_ROLLOUTS);
+  } else if (state->opponent == OPPONENT_BOT) {
+    // the bot reads and writes an SDL-style key array
+    Uint8 key_state[SDL_NUM_SCANCODES] = {0};
+    keys_from_input(key_state, input & (INPUT_P1_TURN | INPUT_P1_SHOOT));
+    run_bot(state, key_state);
+    input = input_from_keys(key_state);
   }
+  state->input = input;
+  game_tick(state, dt);
 }
 
-void handle_turn(body_t *ship, double time_held, double dt) {
-  // increase rotation speed at log rate
-  double rot_speed = PLAYER_ROT_SPEED * fmin(2, 1 + log(time_held * PLAYER_ROT_ACCEL + 1));
-  double da = rot_speed * dt;
-  double curr_angle = body_get_rotation(ship);
-  body_set_rotation(ship, curr_angle + da);
+bool sim_is_over(state_t *state) {
+  return state->P1_score >= WIN_SCORE || state->P2_score >= WIN_SCORE;
 }
 
-void handle_boost(body_t *ship, double time_since_turn_pressed, 
-                  double time_since_turn_released, Mix_Chunk *boost_sound) {
-  if (time_since_turn_pressed < time_since_turn_released && 
-      time_since_turn_released < DOUBLE_TAP_THRESH) {
-    double angle = body_get_rotation(ship);
-    vector_t boost_impulse = vec_make(body_get_mass(ship) * BOOST_VELOCITY, angle + BOOST_ANGLE);
-    body_add_impulse(ship, boost_impulse);
-    body_add_rot_impulse(ship, body_get_rot_inertia(ship) * BOOST_ROT_SPEED);
-    sdl_play_sound(boost_sound);
-  }
+void sim_get_scores(state_t *state, size_t *p1_score, size_t *p2_score) {
+  *p1_score = state->P1_score;
+  *p2_score = state->P2_score;
 }
 
-void handle_shoot(state_t *state, body_t *ship) {
-  // check if player has shot before reload time is up
-  double now = clock();
-  double time_since_shot;
-  if (ship == state->player1) {
-    time_since_shot = now - state->time_of_last_shot[0];
-  } else {
-    time_since_shot = now - state->time_of_last_shot[1];
-  }
-  time_since_shot = time_since_shot / CLOCKS_PER_SEC;
-  if (time_since_shot < RELOAD_TIME) {
-    return;
-  }
+size_t sim_planner_rollouts(state_t *state) {
+  return state->planner != NULL ? planner_rollouts(state->planner) : 0;
+}
 
-  sdl_play_sound(state->shoot_sound);
-  
-  vector_t ship_centroid = body_get_centroid(ship);
-  double ship_angle = body_get_rotation(ship);
-  body_t *bullet = make_bullet(ship_centroid, ship_angle, BULLET_SPEED, BULLET_RADIUS,
-                               BULLET_MASS, SHIP_HEIGHT);
-  scene_t *scene = state->scene;
-  scene_add_body(scene, bullet);
-  for (int i = 0; i < scene_bodies(scene); i++) {
-    body_t *body = scene_get_body(scene, i);
-    if (body == bullet) {
-      continue;
-    }
-    if (get_type(body) == BULLET || get_type(body) == ASTEROID) {
-      create_destructive_collision(scene, body, bullet);
-    } else if (get_type(body) == WALL) {
-      create_destroy_first_collision(scene, bullet, body);
-    } else if (get_type(body) == SHIP) {
-      create_collision(scene, body, bullet, (collision_handler_t) score_hit, state, ELASTICITY);
-    }
-  }
+size_t sim_bodies(state_t *state) { return scene_bodies(state->scene); }
 
-  // update time of last shot by player
-  if (ship == state->player1) {
-    state->time_of_last_shot[0] = now;
-  } else {
-    state->time_of_last_shot[1] = now;
-  }
-}
+sim_timings_t sim_get_timings(state_t *state) { return state->timings; }
 
-void on_key(state_t *state) {
-  if (state->mode != GAME || !state->key_state) { 
-    return; 
+bool sim_record(state_t *state, const char *path) {
+  if (state->replay_writer != NULL) {
+    replay_writer_free(state->replay_writer);
   }
+  state->replay_writer =
+      replay_writer_init(path, state->map_selected, state->seed);
+  return state->replay_writer != NULL;
+}
 
-  body_t *p1 = state->player1;
-  body_t *p2 = state->player2;
+/**
+ * Everything in a snapshot besides the bodies. Fields are 8 bytes wide so
+ * the layout is the same in native and web builds.
+ */
+typedef struct match_record {
+  uint64_t map;
+  uint64_t num_bodies;
+  uint64_t scores[2];
+  double time;
+  double time_of_last_shot[2];
+  uint64_t turn_held[2];
+  double turn_pressed_at[2];
+  double turn_released_at[2];
+  double ship_spin[2];
+  uint64_t input;
+  uint64_t num_free_bullets;
+} match_record_t;
 
-  double dt = state->dt;
-  double now = clock(); 
+/**
+ * The state of one body in a snapshot. Bodies are stored in collider order,
+ * which stays fixed for a match since destroyed bodies are only parked.
+ */
+typedef struct body_record {
+  vector_t centroid;
+  vector_t velocity;
+  double rotation;
+  uint64_t active;
+} body_record_t;
+
+void sim_snapshot(state_t *state, snapshot_t *snapshot) {
+  colliders_t *colliders = state->colliders;
+  bullet_pool_t *pool = state->bullet_pool;
+  size_t n_colliders = colliders_size(colliders);
+  match_record_t match = {
+    .map = state->map_selected,
+    .num_bodies = n_colliders,
+    .scores = {state->P1_score, state->P2_score},
+    .time = state->time,
+    .input = state->input,
+    .num_free_bullets = pool->num_free
+  };
+  for (size_t i = 0; i < 2; i++) {
+    match.time_of_last_shot[i] = state->time_of_last_shot[i];
+    match.turn_held[i] = state->turn_held[i];
+    match.turn_pressed_at[i] = state->turn_pressed_at[i];
+    match.turn_released_at[i] = state->turn_released_at[i];
+    match.ship_spin[i] = state->ship_spin[i];
+  }
 
-  Uint8 *key_state = state->key_state;
-  if (key_state[P1_TURN]) {
-    double time_held = fmax(dt, get_time_held(P1_TURN));
-    handle_turn(p1, time_held, dt);
-    set_last_press(P1_TURN);
-  } else {
-    double time_since_last_press = now - get_last_press(P1_TURN);
-    double time_since_last_release = now - get_last_release(P1_TURN);
-    if (time_since_last_press < time_since_last_release) {
-      handle_boost(p1, time_since_last_press, time_since_last_release, state->boost_sound);
-      set_last_release(P1_TURN);
-    }
+  snapshot_clear(snapshot);
+  snapshot_write(snapshot, &match, sizeof(match));
+  // the whole free stack, so the layout does not depend on how much is used
+  for (size_t i = 0; i < BULLET_POOL_SIZE; i++) {
+    uint64_t slot = i < pool->num_free ? pool->free_slots[i] : 0;
+    snapshot_write(snapshot, &slot, sizeof(slot));
+  }
+  for (size_t i = 0; i < n_colliders; i++) {
+    body_t *body = colliders_get_body(colliders, i);
+    body_record_t record = {
+      .centroid = body_get_centroid(body),
+      .velocity = body_get_velocity(body),
+      .rotation = body_get_rotation(body),
+      .active = colliders_is_active(colliders, i)
+    };
+    snapshot_write(snapshot, &record, sizeof(record));
   }
+}
 
-  if (key_state[P2_TURN]) {
-    double time_held = fmax(dt, get_time_held(P2_TURN));
-    handle_turn(p2, time_held, dt);
-    set_last_press(P2_TURN);
-  } else {
-    double time_since_last_press = now - get_last_press(P2_TURN);
-    double time_since_last_release = now - get_last_release(P2_TURN);
-    if (time_since_last_press < time_since_last_release) {
-      handle_boost(p2, time_since_last_press, time_since_last_release, state->boost_sound);
-      set_last_release(P2_TURN);
+bool sim_restore(state_t *state, snapshot_t *snapshot) {
+  colliders_t *colliders = state->colliders;
+  bullet_pool_t *pool = state->bullet_pool;
+  size_t n_colliders = colliders_size(colliders);
+  size_t offset = 0;
+  match_record_t match;
+  size_t expected_size = sizeof(match) + BULLET_POOL_SIZE * sizeof(uint64_t) +
+                         n_colliders * sizeof(body_record_t);
+  // check everything up front so a bad snapshot leaves the match untouched
+  if (snapshot_size(snapshot) != expected_size ||
+      !snapshot_read(snapshot, &offset, &match, sizeof(match)) ||
+      match.map != state->map_selected || match.num_bodies != n_colliders ||
+      match.num_free_bullets > BULLET_POOL_SIZE) {
+    return false;
+  }
+  size_t slots_offset = offset;
+  for (size_t i = 0; i < BULLET_POOL_SIZE; i++) {
+    uint64_t slot;
+    snapshot_read(snapshot, &offset, &slot, sizeof(slot));
+    if (slot >= BULLET_POOL_SIZE) {
+      return false;
     }
   }
-
-  if (key_state[P1_SHOOT]) {
-    handle_shoot(state, p1);
-    set_last_press(P1_SHOOT);
+  offset = slots_offset;
+
+  state->P1_score = match.scores[0];
+  state->P2_score = match.scores[1];
+  state->time = match.time;
+  state->input = match.input;
+  for (size_t i = 0; i < 2; i++) {
+    state->time_of_last_shot[i] = match.time_of_last_shot[i];
+    state->turn_held[i] = match.turn_held[i];
+    state->turn_pressed_at[i] = match.turn_pressed_at[i];
+    state->turn_released_at[i] = match.turn_released_at[i];
+    state->ship_spin[i] = match.ship_spin[i];
   }
-
-  if (key_state[P2_SHOOT]) {
-    handle_shoot(state, p2);
-    set_last_press(P2_SHOOT);
+  pool->num_free = match.num_free_bullets;
+  for (size_t i = 0; i < BULLET_POOL_SIZE; i++) {
+    uint64_t slot;
+    snapshot_read(snapshot, &offset, &slot, sizeof(slot));
+    pool->free_slots[i] = slot;
   }
-
-  free(key_state);
-  state->key_state = NULL;
+  for (size_t i = 0; i < n_colliders; i++) {
+    body_record_t record;
+    snapshot_read(snapshot, &offset, &record, sizeof(record));
+    body_t *body = colliders_get_body(colliders, i);
+    body_reset(body);
+    body_set_centroid(body, record.centroid);
+    body_set_velocity(body, record.velocity);
+    body_set_rotation(body, record.rotation);
+    colliders_set_active(colliders, i, record.active);
+  }
+  // a restore is a jump, so don't interpolate across it
+  colliders_save_transforms(colliders);
+  return true;
 }
 
-/**
- * Called when the play button is clicked. Initializes the game page based on home page
- * selections.
- * 
- * @param state the state
- */
-void toggle_play(state_t *state) {
-  state->mode = GAME;
-  map_init(state);
-  state->player1 = scene_get_body(state->scene, 0);
-  state->player2 = scene_get_body(state->scene, 1);
-
-  add_force_creators(state);
+void sim_set_threads(state_t *state, size_t num_threads) {
+  // the planner shares the pool, so it is recreated on its next turn
+  if (state->planner != NULL) {
+    planner_free(state->planner);
+    state->planner = NULL;
+  }
+  job_pool_free(state->job_pool);
+  state->job_pool = job_pool_init(num_threads);
 }
 
+void sim_free(state_t *state) { state_free(state); }
+
+#ifndef HEADLESS
 /**
  * Called when left arrow button is clicked to toggle between map options. Updates map
  * selection in the state by decrementing the map option.
@@ -530,7 +1884,7 @@ void toggle_play(state_t *state) {
  */
 void toggle_left_map_arrow(state_t *state) {
   if (state->map_selected == 0) {
-    state->map_selected = 3;
+    state->map_selected = num_maps - 1;
     return;
   }
   state->map_selected--;
@@ -544,7 +1898,7 @@ void toggle_left_map_arrow(state_t *state) {
  */
 void toggle_right_map_arrow(state_t *state) {
   state->map_selected++;
-  state->map_selected %= 4;
+  state->map_selected %= num_maps;
 }
 
 /**
@@ -554,7 +1908,7 @@ void toggle_right_map_arrow(state_t *state) {
  * @param state the state
  */
 void toggle_bot_arrow(state_t *state) {
-  state->bot = !state->bot;
+  state->opponent = (state->opponent + 1) % NUM_OPPONENTS;
 }
 
 /**
@@ -612,22 +1966,30 @@ asset_t *create_button_from_info(state_t *state, button_info_t info) {
 }
 
 /**
- * Using `info`, initializes an image and adds to list.
+ * Using `info`, initializes an image and adds to list. Images in the atlas
+ * are drawn by render_atlas_images() and text the glyph cache can draw by
+ * render_info_text() instead.
  *
+ * @param state the state
  * @param list list to add the image asset to
  * @param info the image info struct used to initialize the image
  * @param info_size the size of the array of image info's
  */
-void add_image_from_info(list_t *list, image_info_t info[], size_t info_size) {
+void add_image_from_info(state_t *state, list_t *list, image_info_t info[],
+                         size_t info_size) {
   for (size_t i = 0; i < info_size; i++) {
     image_info_t img = info[i];
     asset_t *image_asset = NULL;
     asset_t *text_asset = NULL;
-    if (img.image_path != NULL) {
+    size_t index;
+    if (img.image_path != NULL &&
+        !atlas_find(state->atlas, img.image_path, &index)) {
       image_asset = asset_make_image(img.image_path, img.image_box);
       list_add(list, image_asset);
     }
-    if (img.font_path != NULL) {
+    if (img.font_path != NULL &&
+        !glyph_cache_load_font(state->glyph_cache, img.font_path, FONT_SIZE,
+                               &index)) {
       text_asset = asset_make_text(img.font_path, img.text_box, img.text,
                                   img.text_color);
       list_add(list, text_asset);
@@ -657,44 +2019,10 @@ void create_buttons(state_t *state) {
 void home_init(state_t *state) {
   size_t size = sizeof(home_images) / sizeof(home_images[0]);
   
-  add_image_from_info(state->home_assets, home_images, size);
+  add_image_from_info(state, state->home_assets, home_images, size);
   create_buttons(state);
 }
 
-void add_force_creators(state_t *state) {
-  for (size_t i = 0; i < scene_bodies(state->scene); i++) {
-    body_t *body = scene_get_body(state->scene, i);
-    switch (get_type(body)) {
-    case SHIP:
-      create_thrust(state->scene, THRUST_POWER, body);
-      create_drag(state->scene, DRAG_COEF, body);
-      double rot_inertia = body_get_rot_inertia(body);
-      double rot_drag_coef = ROT_DRAG_FACTOR * rot_inertia;
-      create_rot_drag(state->scene, rot_drag_coef, body);
-      for (size_t j = i+1; j < scene_bodies(state->scene); j++) {
-        body_t *body2 = scene_get_body(state->scene, j);
-        entity_type_t t = get_type(body2);
-        if(t == SHIP || t == ASTEROID || t == WALL){
-          create_compound_collision(state->scene, body, body2, ELASTICITY);
-        }
-      }
-      break;
-    case ASTEROID:
-      create_drag(state->scene, DRAG_COEF, body);
-      for (size_t j = i+1; j < scene_bodies(state->scene); j++) {
-        body_t *body2 = scene_get_body(state->scene, j);
-        entity_type_t t = get_type(body2);
-        if(t == ASTEROID || t == WALL){
-          create_compound_collision(state->scene, body, body2, ELASTICITY);
-        }
-      }
-      break;
-    default:
-      break;
-    }
-  }
-}
-
 /**
  * Renders a list of assets to the screen.
  * 
@@ -707,59 +2035,248 @@ void render_assets(list_t *assets) {
   }
 }
 
+/**
+ * Draws the images in `info` that are in the atlas, in one batch per atlas
+ * page. Call before render_assets() so text and buttons land on top.
+ *
+ * @param state the state
+ * @param info the image infos of a page
+ * @param info_size the size of the array of image info's
+ */
+void render_atlas_images(state_t *state, image_info_t info[],
+                         size_t info_size) {
+  if (state->atlas == NULL) {
+    return;
+  }
+  atlas_begin(state->atlas);
+  for (size_t i = 0; i < info_size; i++) {
+    size_t index;
+    if (info[i].image_path != NULL &&
+        atlas_find(state->atlas, info[i].image_path, &index)) {
+      atlas_add_image(state->atlas, index, info[i].image_box);
+    }
+  }
+  atlas_flush(state->atlas);
+}
+
+/**
+ * Adds a line of text to the glyph cache's batch, or draws it as a text
+ * asset right away if the glyph cache cannot open the font.
+ *
+ * @param state the state
+ * @param font_path the path to the font file
+ * @param font_size the size of the font; text assets use their own size
+ * @param text the string to draw
+ * @param box the box the text is drawn in; glyphs start at its top left
+ * @param color the color of the text
+ */
+void render_text(state_t *state, const char *font_path, int font_size,
+                 const char *text, SDL_Rect box, rgb_color_t color) {
+  size_t font;
+  if (glyph_cache_load_font(state->glyph_cache, font_path, font_size, &font)) {
+    glyph_cache_add_text(state->glyph_cache, font, text, box.x, box.y, color);
+    return;
+  }
+  asset_t *asset = asset_table_acquire_text(state->asset_table, font_path,
+                                            box, text, color);
+  asset_render(asset);
+  asset_table_release(state->asset_table, asset);
+}
+
+/**
+ * Draws the text in `info` with the glyph cache. Text the glyph cache
+ * cannot draw has its own asset and is drawn by render_assets().
+ *
+ * @param state the state
+ * @param info the image infos of a page
+ * @param info_size the size of the array of image info's
+ */
+void render_info_text(state_t *state, image_info_t info[], size_t info_size) {
+  glyph_cache_begin(state->glyph_cache);
+  for (size_t i = 0; i < info_size; i++) {
+    size_t font;
+    if (info[i].font_path != NULL &&
+        glyph_cache_load_font(state->glyph_cache, info[i].font_path,
+                              FONT_SIZE, &font)) {
+      glyph_cache_add_text(state->glyph_cache, font, info[i].text,
+                           info[i].text_box.x, info[i].text_box.y,
+                           info[i].text_color);
+    }
+  }
+  glyph_cache_flush(state->glyph_cache);
+}
+
+/**
+ * Returns whether any part of a box seen through a camera lands in the
+ * window. The camera is scaled to fit the window, so the window can show
+ * more than the camera rectangle along one axis.
+ *
+ * @param box the box, in window-oriented camera coordinates
+ * @param cam_center the position at the center of the window
+ * @param cam_size the width and height of the camera rectangle
+ * @return false if the box is entirely off screen
+ */
+bool box_in_view(SDL_Rect box, vector_t cam_center, vector_t cam_size) {
+  vector_t window_center = vec_multiply(0.5, vec_subtract(MAX, MIN));
+  double scale = fmin(window_center.x / (cam_size.x / 2),
+                      window_center.y / (cam_size.y / 2));
+  vector_t half_view = vec_multiply(1 / scale, window_center);
+  return box.x <= cam_center.x + half_view.x &&
+         box.x + box.w >= cam_center.x - half_view.x &&
+         box.y <= cam_center.y + half_view.y &&
+         box.y + box.h >= cam_center.y - half_view.y;
+}
+
+/**
+ * Draws one background layer seen through a camera, unless it is out of
+ * view, from the atlas if it was packed and from its own asset otherwise.
+ *
+ * @param state the state
+ * @param layer 0 for the backdrop, or 1 + the index of a parallax layer
+ * @param center the camera center, in scene coordinates
+ * @param size the camera size
+ */
+void render_bg_layer(state_t *state, size_t layer, vector_t center,
+                     vector_t size) {
+  map_t map = state->map;
+  const char *path = bg_layer_path(map, layer);
+  // layer boxes are in window pixels, whose y points down
+  vector_t window_center = {center.x, MAX.y - center.y};
+  SDL_Rect box = bg_layer_box(map, layer);
+  if (!box_in_view(box, window_center, size)) {
+    return;
+  }
+  size_t index;
+  if (path != NULL && atlas_find(state->atlas, path, &index)) {
+    atlas_add_image_cam(state->atlas, index, box, window_center, size);
+  } else if (state->bg_assets[layer] != NULL) {
+    // keep the layers in order around the fallback asset
+    atlas_flush(state->atlas);
+    asset_render_cam(state->bg_assets[layer], center, size);
+  }
+}
+
 void render_bg_track(state_t *state, vector_t cam_pos, vector_t cam_size) {
   vector_t center = vec_multiply(0.5, MAX);
-  asset_render_cam(list_get(state->game_assets, 0), center, MAX);
+  atlas_begin(state->atlas);
+  render_bg_layer(state, 0, center, MAX);
 
   map_t map = (map_t) state->map;
   double cam_dist = cam_size.x/MAX.x;
   for(size_t i = 0; i < map.num_bg; i++){
     vector_t scaled_diff = vec_multiply(1/map.bg_depth[i], vec_subtract(cam_pos, center));
     double scale = (map.bg_depth[i] + cam_dist)/(1 + map.bg_depth[i]);
-    asset_render_cam(list_get(state->game_assets, i+1), vec_add(center, scaled_diff), vec_multiply(scale, MAX));
+    render_bg_layer(state, i + 1, vec_add(center, scaled_diff), vec_multiply(scale, MAX));
   }
-  
+  atlas_flush(state->atlas);
 }
 
 void render_bg_zoom(state_t *state, vector_t cam_pos, vector_t cam_size) {
   vector_t center = vec_multiply(0.5, MAX);
-  asset_render_cam(list_get(state->game_assets, 0), center, vec_multiply(0.7, cam_size));
+  atlas_begin(state->atlas);
+  render_bg_layer(state, 0, center, vec_multiply(0.7, cam_size));
 
   map_t map = (map_t) state->map;
   for(size_t i = 0; i < map.num_bg; i++){
     vector_t scaled_diff = vec_multiply(1/map.bg_depth[i], vec_subtract(cam_pos, center));
-    asset_render_cam(list_get(state->game_assets, i+1), vec_add(center, scaled_diff), cam_size);
+    render_bg_layer(state, i + 1, vec_add(center, scaled_diff), cam_size);
   }
-  
+  atlas_flush(state->atlas);
+}
+
+/**
+ * Builds the score bar polygon for one player.
+ *
+ * @param player the index of the player
+ * @param score the score of the player
+ * @return a rectangle as wide as the score
+ */
+polygon_t *make_score_bar(size_t player, size_t score) {
+  rgb_color_t color = PLAYER_COLORS[player];
+  size_t width = score * (MAX.x / WIN_SCORE);
+  size_t height = SCORE_HEIGHT / 2;
+  double y = player == 0 ? MAX.y - SCORE_HEIGHT / 4.0
+                         : MAX.y - 0.75 * SCORE_HEIGHT;
+  vector_t centroid = (vector_t){.x = width / 2.0, .y = y};
+  list_t *rectangle_pts = make_rectangle(centroid, width, height);
+  return polygon_init(rectangle_pts, VEC_ZERO, 0.0, color.r, color.g, color.b);
+}
+
+/**
+ * Renders the bodies in view of the camera in a single batch, falling back
+ * to sdl_render_scene_cam() if no renderer is available for batching.
+ * Bodies whose cached bounds are out of view are skipped before their
+ * shapes are transformed.
+ *
+ * @param state the state
+ * @param cam_center the scene position at the center of the window
+ * @param cam_size the width and height of the visible scene area
+ * @param alpha how far rendering is between the last two ticks, from 0 to 1
+ */
+void render_bodies(state_t *state, vector_t cam_center, vector_t cam_size,
+                   double alpha) {
+  render_batch_t *batch = state->render_batch;
+  if (!render_batch_is_available(batch)) {
+    sdl_render_scene_cam(state->scene, NULL, cam_center, cam_size);
+    return;
+  }
+
+  render_batch_begin(batch, cam_center, cam_size);
+  colliders_t *colliders = state->colliders;
+  vector_t view_min, view_max;
+  render_batch_get_view(batch, &view_min, &view_max);
+  size_t *visible = arena_alloc(state->frame_arena,
+                                colliders_size(colliders) * sizeof(size_t));
+  size_t n_visible =
+      colliders_find_visible(colliders, view_min, view_max, visible);
+
+  // black holes go under the bodies
+  double *xs =
+      arena_alloc(state->frame_arena, BLACKHOLE_SIDES * sizeof(double));
+  double *ys =
+      arena_alloc(state->frame_arena, BLACKHOLE_SIDES * sizeof(double));
+  for (size_t i = 0; i < state->map.num_blackholes; i++) {
+    vector_t center = state->map.blackhole_locations[i];
+    for (size_t k = 0; k < BLACKHOLE_SIDES; k++) {
+      double angle = 2 * M_PI * k / BLACKHOLE_SIDES;
+      xs[k] = center.x + BLACKHOLE_RADIUS * cos(angle);
+      ys[k] = center.y + BLACKHOLE_RADIUS * sin(angle);
+    }
+    render_batch_add_polygon(batch, xs, ys, BLACKHOLE_SIDES, BLACKHOLE_COLOR,
+                             255);
+  }
+
+  state->num_bodies_drawn = 0;
+  for (size_t j = 0; j < n_visible; j++) {
+    size_t i = visible[j];
+    body_t *body = colliders_get_body(colliders, i);
+    state->num_bodies_drawn++;
+    sat_polygon_t shape = colliders_get_interpolated_shape(colliders, i, alpha);
+    render_batch_add_polygon(batch, shape.xs, shape.ys, shape.num_vertices,
+                             body_get_color(body), 255);
+  }
+  render_batch_flush(batch);
 }
 
 /** 
  * Renders score as a progress bar at the top of the screen. Game page only.
+ * The bar polygons are only rebuilt when a score changes.
  * 
  * @param state the state
 */
 void game_render_scores(state_t *state) {
-  // player 1
-  size_t p1 = state->P1_score;
-  rgb_color_t p1_color = PLAYER_COLORS[0];
-  size_t width = p1 * (MAX.x / WIN_SCORE);
-  size_t height = SCORE_HEIGHT / 2;
-  vector_t centroid = (vector_t){.x = width / 2.0, .y = MAX.y - SCORE_HEIGHT / 4.0};
-  list_t *rectangle_pts = make_rectangle(centroid, width, height);
-  polygon_t *rectangle = polygon_init(rectangle_pts, VEC_ZERO, 0.0, p1_color.r, 
-                                      p1_color.g, p1_color.b);
-  sdl_draw_polygon(rectangle, p1_color);
-
-  // player 2
-  size_t p2 = state->P2_score;
-  rgb_color_t p2_color = PLAYER_COLORS[1];
-  size_t width_2 = p2 * (MAX.x / WIN_SCORE);
-  size_t height_2 = SCORE_HEIGHT / 2;
-  vector_t centroid_2 = (vector_t){.x = width_2 / 2.0, .y = MAX.y - 0.75 * SCORE_HEIGHT};
-  list_t *rectangle_pts_2 = make_rectangle(centroid_2, width_2, height_2);
-  polygon_t *rectangle_2 = polygon_init(rectangle_pts_2, VEC_ZERO, 0.0, p2_color.r, 
-                                      p2_color.g, p2_color.b);
-  sdl_draw_polygon(rectangle_2, p2_color);
+  size_t scores[] = {state->P1_score, state->P2_score};
+  for (size_t i = 0; i < 2; i++) {
+    if (state->score_bars[i] == NULL ||
+        state->score_bar_values[i] != scores[i]) {
+      if (state->score_bars[i] != NULL) {
+        polygon_free(state->score_bars[i]);
+      }
+      state->score_bars[i] = make_score_bar(i, scores[i]);
+      state->score_bar_values[i] = scores[i];
+    }
+    sdl_draw_polygon(state->score_bars[i], PLAYER_COLORS[i]);
+  }
 }
 
 /**
@@ -769,38 +2286,47 @@ void game_render_scores(state_t *state) {
 */
 void home_render_selected(state_t *state) {
   // Map selection
-  SDL_Rect map_box = MAP_SELECTION_BOX;
-  char *map_selected = " ";
-
-  switch (state->map_selected) {
-    case 0:
-      map_selected = "1";
-      break;
-    case 1:
-      map_selected = "2";
-      break;
-    case 2:
-      map_selected = "3";
-      break;
-    default:
-      map_selected = "4";
-      break;
-  }
-  asset_t *map_text = asset_make_text(FONT_PATH, map_box, map_selected, WHITE);
-  asset_render(map_text);
+  char map_selected[MAP_NUMBER_LENGTH];
+  snprintf(map_selected, sizeof(map_selected), "%zu", state->map_selected + 1);
+  glyph_cache_begin(state->glyph_cache);
+  render_text(state, FONT_PATH, FONT_SIZE, map_selected, MAP_SELECTION_BOX,
+              WHITE);
 
   // Opponent selection
-  SDL_Rect opp_box = OPP_SELECTION_BOX;
-  char *opp_selected = " ";
-  if (state->bot) {
-    opp_selected = strdup(OPP_SELECTION_MSGS[1]);
-    assert(opp_selected);
-  } else {
-    opp_selected = strdup(OPP_SELECTION_MSGS[0]);
-    assert(opp_selected);
+  const char *opp_selected = OPP_SELECTION_MSGS[state->opponent];
+  render_text(state, FONT_PATH, FONT_SIZE, opp_selected, OPP_SELECTION_BOX,
+              WHITE);
+  glyph_cache_flush(state->glyph_cache);
+}
+
+/**
+ * Draws a progress bar and file count while the home page is loading.
+ *
+ * @param state the state
+ * @param decoded the number of files decoded
+ * @param requested the number of files requested
+ */
+void loading_render(state_t *state, size_t decoded, size_t requested) {
+  double progress = requested > 0 ? (double)decoded / requested : 1;
+  render_batch_t *batch = state->render_batch;
+  if (render_batch_is_available(batch)) {
+    vector_t pos = LOADING_BAR_POS;
+    vector_t size = LOADING_BAR_SIZE;
+    double fill = pos.x + progress * size.x;
+    render_batch_begin(batch, vec_multiply(0.5, MAX), MAX);
+    double bg_xs[] = {pos.x, pos.x + size.x, pos.x + size.x, pos.x};
+    double bg_ys[] = {pos.y, pos.y, pos.y + size.y, pos.y + size.y};
+    render_batch_add_polygon(batch, bg_xs, bg_ys, 4, WHITE, 60);
+    double xs[] = {pos.x, fill, fill, pos.x};
+    render_batch_add_polygon(batch, xs, bg_ys, 4, LOADING_BAR_COLOR, 255);
+    render_batch_flush(batch);
   }
-  asset_t *opp_text = asset_make_text(FONT_PATH, opp_box, opp_selected, WHITE);
-  asset_render(opp_text);
+
+  char text[LOADING_TEXT_LENGTH];
+  snprintf(text, sizeof(text), "Loading %zu / %zu", decoded, requested);
+  glyph_cache_begin(state->glyph_cache);
+  render_text(state, FONT_PATH, FONT_SIZE, text, LOADING_TEXT_BOX, WHITE);
+  glyph_cache_flush(state->glyph_cache);
 }
 
 /**
@@ -810,31 +2336,176 @@ void home_render_selected(state_t *state) {
  */
 void post_game_init(state_t *state) {
   size_t size = sizeof(post_game_images) / sizeof(post_game_images[0]);
-  add_image_from_info(state->post_game_assets, post_game_images, size);
-
-  char *msg = strdup(GAME_OVER_MSG);
-  assert(msg);
-  char *color = " ";
-  ssize_t winner = state->P1_score - state->P2_score; 
-  if (winner > 0) {
-    color = strdup(PLAYER_COLOR_NAMES[0]);
-    assert(color);
-    msg = strcat(msg, color);
-  } else {
-    color = strdup(PLAYER_COLOR_NAMES[1]);
-    assert(color);
-    msg = strcat(msg, color);
-  }
+  add_image_from_info(state, state->post_game_assets, post_game_images, size);
+}
+
+/**
+ * Draws the winner over the post game page.
+ *
+ * @param state the state
+ */
+void post_game_render_message(state_t *state) {
+  size_t winner = state->P1_score > state->P2_score ? 0 : 1;
+  char msg[GAME_OVER_MSG_LENGTH];
+  snprintf(msg, sizeof(msg), "%s%s", GAME_OVER_MSG, PLAYER_COLOR_NAMES[winner]);
 
   SDL_Rect box = (SDL_Rect){post_game_images[1].image_box.x + 15, 
                             post_game_images[1].image_box.y + 15, MAX.x / 4, MAX.y / 4};
-  asset_t *msg_asset = asset_make_text(FONT_PATH, box, msg, WHITE);
+  glyph_cache_begin(state->glyph_cache);
+  render_text(state, FONT_PATH, FONT_SIZE, msg, box, WHITE);
+  glyph_cache_flush(state->glyph_cache);
+}
+
+/**
+ * Draws the score, match clock and frame rate in the top right corner,
+ * below the score bars. Game page only.
+ *
+ * @param state the state
+ * @param dt the wall time since the last frame, in seconds
+ */
+void game_render_hud(state_t *state, double dt) {
+  if (dt > 0) {
+    state->fps = state->fps > 0
+                     ? (1 - FPS_SMOOTHING) * state->fps + FPS_SMOOTHING / dt
+                     : 1 / dt;
+  }
+  size_t seconds = (size_t)state->time;
+  char hud[HUD_TEXT_LENGTH];
+  snprintf(hud, sizeof(hud), "%s %zu - %zu %s   %zu:%02zu   %.0f fps",
+           PLAYER_COLOR_NAMES[0], state->P1_score, state->P2_score,
+           PLAYER_COLOR_NAMES[1], seconds / 60, seconds % 60, state->fps);
+
+  size_t font;
+  if (!glyph_cache_load_font(state->glyph_cache, FONT_PATH, HUD_FONT_SIZE,
+                             &font)) {
+    // changes every frame, so a text asset would be rebuilt every frame
+    return;
+  }
+  int width = glyph_cache_text_width(state->glyph_cache, font, hud);
+  glyph_cache_begin(state->glyph_cache);
+  glyph_cache_add_text(state->glyph_cache, font, hud,
+                       MAX.x - HUD_MARGIN - width, SCORE_HEIGHT + HUD_MARGIN,
+                       WHITE);
+  glyph_cache_flush(state->glyph_cache);
+}
+
+#ifdef PROFILE
+/**
+ * Shows or hides the profiler overlay and exports a Chrome trace when their
+ * keys are pressed.
+ *
+ * @param state the state
+ * @param key_state the keys held this frame
+ */
+void handle_profiler_keys(state_t *state, const Uint8 *key_state) {
+  bool toggle = key_state[(Uint8)PROFILER_TOGGLE_KEY];
+  bool trace = key_state[(Uint8)PROFILER_TRACE_KEY];
+  if (toggle && !state->profiler_keys_held[0]) {
+    state->profiler_visible = !state->profiler_visible;
+  }
+  if (trace && !state->profiler_keys_held[1]) {
+    profiler_export_trace(PROFILER_TRACE_PATH);
+  }
+  state->profiler_keys_held[0] = toggle;
+  state->profiler_keys_held[1] = trace;
+}
+
+/**
+ * Rebuilds the overlay's lines from the last frame's phase times. Lines are
+ * only rebuilt a few times a second, so they stay readable.
+ *
+ * @param state the state
+ */
+void update_profiler_text(state_t *state) {
+  double now = timer_now();
+  if (now - state->profiler_text_time < PROFILER_TEXT_REFRESH) {
+    return;
+  }
+  state->profiler_text_time = now;
+  double seconds[NUM_PROFILE_PHASES];
+  if (!profiler_phase_times(seconds)) {
+    state->num_profiler_lines = 0;
+    return;
+  }
 
-  list_add(state->post_game_assets, msg_asset);
+  size_t n = 0;
+  snprintf(state->profiler_lines[n++], PROFILER_LINE_LENGTH,
+           "%zu bodies, %zu drawn, %zu force creators", sim_bodies(state),
+           state->num_bodies_drawn, state->num_force_creators);
+  for (size_t phase = 0; phase < NUM_PROFILE_PHASES; phase++) {
+    if (seconds[phase] > 0) {
+      snprintf(state->profiler_lines[n++], PROFILER_LINE_LENGTH,
+               "%s: %.2f ms", profiler_phase_name(phase),
+               seconds[phase] * 1e3);
+    }
+  }
+  state->num_profiler_lines = n;
+}
+
+/**
+ * Draws the recent frame times as a bar graph, with a line at the target
+ * frame time.
+ *
+ * @param state the state
+ */
+void render_frame_graph(state_t *state) {
+  render_batch_t *batch = state->render_batch;
+  if (!render_batch_is_available(batch)) {
+    return;
+  }
+  double times[PROFILER_GRAPH_FRAMES];
+  size_t n = profiler_frame_times(times, PROFILER_GRAPH_FRAMES);
+  vector_t pos = PROFILER_GRAPH_POS;
+  vector_t size = PROFILER_GRAPH_SIZE;
+  double bar_width = size.x / PROFILER_GRAPH_FRAMES;
+  double scale = size.y / PROFILER_GRAPH_MAX_TIME;
+
+  render_batch_begin(batch, vec_multiply(0.5, MAX), MAX);
+  double bg_xs[] = {pos.x, pos.x + size.x, pos.x + size.x, pos.x};
+  double bg_ys[] = {pos.y, pos.y, pos.y + size.y, pos.y + size.y};
+  render_batch_add_polygon(batch, bg_xs, bg_ys, 4, PROFILER_GRAPH_BG_COLOR,
+                           PROFILER_GRAPH_BG_ALPHA);
+  for (size_t i = 0; i < n; i++) {
+    double x = pos.x + i * bar_width;
+    double top = pos.y + fmin(times[i] * scale, size.y);
+    double xs[] = {x, x + bar_width, x + bar_width, x};
+    double ys[] = {pos.y, pos.y, top, top};
+    rgb_color_t color = times[i] <= PROFILER_TARGET_TIME
+                            ? PROFILER_GOOD_COLOR
+                            : PROFILER_SLOW_COLOR;
+    render_batch_add_polygon(batch, xs, ys, 4, color, 255);
+  }
+  double target = pos.y + PROFILER_TARGET_TIME * scale;
+  double line_xs[] = {pos.x, pos.x + size.x, pos.x + size.x, pos.x};
+  double line_ys[] = {target, target, target + 1, target + 1};
+  render_batch_add_polygon(batch, line_xs, line_ys, 4, WHITE, 200);
+  render_batch_flush(batch);
+}
+
+/**
+ * Draws the profiler overlay: the time spent in each phase of the last
+ * frame, body and force creator counts, and a graph of recent frame times.
+ *
+ * @param state the state
+ */
+void render_profiler_overlay(state_t *state) {
+  PROFILE_BEGIN(overlay_start);
+  update_profiler_text(state);
+  glyph_cache_begin(state->glyph_cache);
+  for (size_t i = 0; i < state->num_profiler_lines; i++) {
+    SDL_Rect box = PROFILER_TEXT_BOX;
+    box.y += i * box.h;
+    render_text(state, FONT_PATH, PROFILER_FONT_SIZE, state->profiler_lines[i],
+                box, WHITE);
+  }
+  glyph_cache_flush(state->glyph_cache);
+  render_frame_graph(state);
+  PROFILE_END(PROFILE_OVERLAY, overlay_start);
 }
+#endif
 
-vector_t calc_cam_size(state_t *state){
-  vector_t diff = vec_subtract(body_get_centroid(state->player1), body_get_centroid(state->player2));
+vector_t calc_cam_size(vector_t p1_pos, vector_t p2_pos){
+  vector_t diff = vec_subtract(p1_pos, p2_pos);
   diff.x = fmax(fabs(diff.x) * 1.3, 300);
   diff.y = fabs(diff.y) * 1.3;
   if(diff.x > 2*diff.y){
@@ -849,27 +2520,38 @@ state_t *emscripten_init() {
   asset_cache_init();
   sdl_init(MIN, MAX);
   
-  srand(time(NULL));
-  state_t *state = malloc(sizeof(state_t));
-  state->mode = HOME;
-  state->P1_score = 0;
-  state->P2_score = 0;
-  state->time_of_last_shot[0] = 0;
-  state->time_of_last_shot[1] = 0;
-  state->bot = false;
-  state->map_selected = 0;
+  state_t *state = state_init();
+  state->seed = time(NULL);
+#ifdef __EMSCRIPTEN_PTHREADS__
+  sim_set_threads(state, 0);
+#endif
   state->home_assets = list_init(INITIAL_GAME_CAPACITY, (free_func_t) asset_destroy);
   state->game_assets = list_init(INITIAL_GAME_CAPACITY, (free_func_t) asset_destroy);
   state->post_game_assets = list_init(INITIAL_GAME_CAPACITY, (free_func_t) asset_destroy);
-  state->dt = 0;
-  state->key_state = NULL;
-  state->scene = scene_init();
-  state->shoot_sound = sdl_load_sound(SHOOT_SOUND_PATH);
-  state->boost_sound = sdl_load_sound(BOOST_SOUND_PATH);
-  state->backing_track = sdl_load_music(BACKGROUND_TRACK);
-  
-  home_init(state);
-  sdl_play_music(state->backing_track);
+  state->score_bars[0] = NULL;
+  state->score_bars[1] = NULL;
+  state->asset_table = asset_table_init(IDLE_ASSET_BUDGET);
+  state->render_batch = render_batch_init();
+  state->atlas = atlas_init();
+  state->bg_assets = NULL;
+  state->glyph_cache = glyph_cache_init();
+  state->fps = 0;
+  // sounds and music arrive from the preloader
+  state->shoot_sound = NULL;
+  state->boost_sound = NULL;
+  state->backing_track = NULL;
+  state->preloader = preloader_init(PRELOAD_THREADS);
+  preload_startup(state);
+  state->mode = LOADING;
+#ifdef PROFILE
+  profiler_init(PROFILER_CAPACITY);
+  state->profiler_visible = false;
+  state->profiler_keys_held[0] = false;
+  state->profiler_keys_held[1] = false;
+  state->profiler_text_time = -INFINITY;
+  state->num_profiler_lines = 0;
+#endif
+
 
   sdl_on_key((key_handler_t)on_key);
   sdl_on_click((click_handler_t)on_click);
@@ -877,54 +2559,118 @@ state_t *emscripten_init() {
   return state;
 }
 
+/**
+ * Runs as many fixed physics ticks as fit in the wall time since the last
+ * frame, carrying the remainder over to the next frame.
+ *
+ * @param state the state
+ * @param frame_time the wall time since the last frame, in seconds
+ * @return how far the frame is between the last two ticks, from 0 to 1
+ */
+double game_advance(state_t *state, double frame_time) {
+  // after a long stall, slow the game down instead of running a burst of
+  // ticks that would stall the next frame too
+  state->accumulator += fmin(frame_time, MAX_FRAME_TIME);
+  while (state->accumulator >= state->physics_dt) {
+    game_tick(state, state->physics_dt);
+    state->accumulator -= state->physics_dt;
+    if (sim_is_over(state)) {
+      break;
+    }
+  }
+  return state->accumulator / state->physics_dt;
+}
+
 bool emscripten_main(state_t *state) {
-  double dt = time_since_last_tick();
+  PROFILE_BEGIN(frame_start);
+  double now = timer_now();
+  double dt = now - state->last_frame_time;
+  state->last_frame_time = now;
+  arena_reset(state->frame_arena);
 
   switch (state->mode) {
+    case LOADING: {
+      preloader_step(state->preloader);
+      // everything counted as decoded here is received below
+      size_t decoded, requested;
+      preloader_progress(state->preloader, &decoded, &requested);
+      receive_preloaded(state);
+      if (decoded == requested) {
+        home_init(state);
+        state->mode = HOME;
+      }
+      sdl_clear();
+      loading_render(state, decoded, requested);
+      sdl_show();
+      break;
+    }
     case HOME: {
+      // decode the selected map while the player picks
+      preload_map(state, state->map_selected);
+      preloader_step(state->preloader);
+      receive_preloaded(state);
       sdl_clear();
+      render_atlas_images(state, home_images,
+                          sizeof(home_images) / sizeof(home_images[0]));
       render_assets(state->home_assets);
+      render_info_text(state, home_images,
+                       sizeof(home_images) / sizeof(home_images[0]));
       home_render_selected(state);
       sdl_show();
       break;
     }
     case GAME: {
-      scene_tick(state->scene, dt);
+      double alpha = game_advance(state, dt);
 
       // game over
-      if (state->P1_score >= WIN_SCORE || state->P2_score >= WIN_SCORE) { 
+      if (sim_is_over(state)) { 
         state->mode = POST_GAME;
         post_game_init(state);
+        // finish the replay so the last inputs reach the file
+        if (state->replay_writer != NULL) {
+          replay_writer_free(state->replay_writer);
+          state->replay_writer = NULL;
+        }
       }
 
       // render scene with camera
       sdl_clear();
-      vector_t cam_center = vec_multiply(0.5, vec_add(body_get_centroid(state->player1), 
-                                        body_get_centroid(state->player2)));
-      render_bg_track(state, cam_center, calc_cam_size(state));
-      sdl_render_scene_cam(state->scene, NULL, cam_center, calc_cam_size(state));
+      colliders_t *colliders = state->colliders;
+      vector_t p1_pos = colliders_get_interpolated_centroid(
+          colliders, state->player_indices[0], alpha);
+      vector_t p2_pos = colliders_get_interpolated_centroid(
+          colliders, state->player_indices[1], alpha);
+      vector_t cam_center = vec_multiply(0.5, vec_add(p1_pos, p2_pos));
+      vector_t cam_size = calc_cam_size(p1_pos, p2_pos);
+      PROFILE_BEGIN(background_start);
+      render_bg_track(state, cam_center, cam_size);
+      PROFILE_END(PROFILE_BACKGROUND, background_start);
+      PROFILE_BEGIN(bodies_start);
+      render_bodies(state, cam_center, cam_size, alpha);
+      PROFILE_END(PROFILE_BODIES, bodies_start);
+      PROFILE_BEGIN(scores_start);
       game_render_scores(state);
+      game_render_hud(state, dt);
+      PROFILE_END(PROFILE_SCORES, scores_start);
+#ifdef PROFILE
+      if (state->profiler_visible) {
+        render_profiler_overlay(state);
+      }
+#endif
+      PROFILE_BEGIN(show_start);
       sdl_show();
+      PROFILE_END(PROFILE_SHOW, show_start);
 
       // bot update
+      free(state->key_state); // left over if on_key was not called
       state->key_state = sdl_get_keystate();
-      if (state->bot) {
-        game_info_t *info = malloc(sizeof(game_info_t));
-        assert(info);
-        *info = (game_info_t) {
-          .p1 = state->player1,
-          .p2 = state->player2,
-          .bullet_speed = BULLET_SPEED,
-          .bullet_radius = BULLET_RADIUS,
-          .ship_base = SHIP_BASE,
-          .ship_height = SHIP_HEIGHT,
-          .ship_rot_speed = PLAYER_ROT_SPEED, 
-          .double_tap_thresh = DOUBLE_TAP_THRESH,
-          .scene = state->scene,
-          .dt = state->dt
-        };
-        bot_move(state->key_state, info, state->player2);
-        free(info);
+#ifdef PROFILE
+      handle_profiler_keys(state, state->key_state);
+#endif
+      if (state->opponent == OPPONENT_BOT) {
+        run_bot(state, state->key_state);
+      } else if (state->opponent == OPPONENT_PLANNER) {
+        run_planner(state, timer_now() + PLANNER_BUDGET, PLANNER_MAX_ROLLOUTS);
       }
       
       state->dt = dt;
@@ -933,23 +2679,40 @@ bool emscripten_main(state_t *state) {
     }
     case POST_GAME: {
       sdl_clear();
+      render_atlas_images(state, post_game_images,
+                          sizeof(post_game_images) / sizeof(post_game_images[0]));
       render_assets(state->post_game_assets);
+      render_info_text(state, post_game_images,
+                       sizeof(post_game_images) / sizeof(post_game_images[0]));
+      post_game_render_message(state);
       sdl_show();
       break;
     }
   }
 
+  PROFILE_END(PROFILE_FRAME, frame_start);
   return false;
 }
 
 void emscripten_free(state_t *state) {
+  preloader_free(state->preloader);
   list_free(state->home_assets);
   list_free(state->game_assets);
   list_free(state->post_game_assets);
   Mix_FreeChunk(state->shoot_sound);
   Mix_FreeChunk(state->boost_sound);
   Mix_FreeMusic(state->backing_track);
-  scene_free(state->scene);
+  for (size_t i = 0; i < 2; i++) {
+    if (state->score_bars[i] != NULL) {
+      polygon_free(state->score_bars[i]);
+    }
+  }
+  asset_table_free(state->asset_table);
+  render_batch_free(state->render_batch);
+  atlas_free(state->atlas);
+  free(state->bg_assets);
+  glyph_cache_free(state->glyph_cache);
+  state_free(state);
   asset_cache_destroy();
-  free(state);
-}
\ No newline at end of file
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,26 @@
+#include <stdio.h>
+
+#include "map_file.h"
+
+/**
+ * Compiles a text map into the binary form the game loads.
+ * Example: 'bin/mapc assets/maps/1.map assets/maps/1.mapb'
+ */
+int main(int argc, char *argv[]) {
+  if (argc != 3) {
+    fprintf(stderr, "usage: %s source.map compiled.mapb\n", argv[0]);
+    return 1;
+  }
+  map_t *map = map_file_parse(argv[1]);
+  if (map == NULL) {
+    fprintf(stderr, "could not read map %s\n", argv[1]);
+    return 1;
+  }
+  bool saved = map_file_save(map, argv[2]);
+  map_file_free(map);
+  if (!saved) {
+    fprintf(stderr, "could not write %s\n", argv[2]);
+    return 1;
+  }
+  return 0;
+}
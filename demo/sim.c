@@ -0,0 +1,195 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "profiler.h"
+#include "replay.h"
+#include "sim.h"
+#include "timer.h"
+
+const size_t DEFAULT_TICKS = 10000;
+const double DEFAULT_DT = 1.0 / 60;
+const unsigned int DEFAULT_SEED = 1;
+const size_t SEEK_SAMPLES = 100;
+const size_t TRACE_CAPACITY = 1 << 18; // profiler events kept
+const char *OPPONENT_NAMES[] = {"scripted opponent", "bot opponent",
+                                "planner opponent"};
+
+/**
+ * A fixed input script, so runs with the same arguments do the same work:
+ * each player turns in bursts and fires as often as the reload allows.
+ */
+uint32_t scripted_input(size_t tick) {
+  uint32_t input = 0;
+  if ((tick / 20) % 3 == 0) {
+    input |= INPUT_P1_TURN;
+  }
+  if (tick % 30 == 0) {
+    input |= INPUT_P1_SHOOT;
+  }
+  if ((tick / 25) % 4 == 1) {
+    input |= INPUT_P2_TURN;
+  }
+  if (tick % 45 == 0) {
+    input |= INPUT_P2_SHOOT;
+  }
+  return input;
+}
+
+void print_usage(const char *program) {
+  fprintf(stderr,
+          "usage: %s [-m map] [-n ticks] [-d dt] [-s seed] [-j threads] [-b | -p]\n"
+          "          [-r replay] [-t trace]\n"
+          "       %s -R replay\n"
+          "  -m  index of the map to load (default 0)\n"
+          "  -n  number of ticks to simulate (default %zu)\n"
+          "  -d  fixed timestep in seconds (default %g)\n"
+          "  -s  random seed (default %u)\n"
+          "  -j  threads for the collision narrow-phase, 0 for one per core "
+          "(default 1)\n"
+          "  -b  let the bot play player 2\n"
+          "  -p  let the lookahead planner play player 2\n"
+          "  -r  record the match to a replay file\n"
+          "  -t  write a Chrome trace of the run (needs PROFILE=true)\n"
+          "  -R  play back a replay file and time seeking through it\n",
+          program, program, DEFAULT_TICKS, DEFAULT_DT, DEFAULT_SEED);
+}
+
+void print_phase(const char *name, double seconds, size_t ticks) {
+  printf("  %-12s %10.3f ms %10.3f us/tick\n", name, seconds * 1e3,
+         seconds * 1e6 / ticks);
+}
+
+/**
+ * Plays a replay to the end, then seeks to evenly spaced ticks in reverse
+ * order, so each seek has to restore a keyframe.
+ */
+int play_replay(const char *path) {
+  double load_start = timer_now();
+  replay_t *replay = replay_load(path);
+  if (replay == NULL) {
+    fprintf(stderr, "could not load replay %s\n", path);
+    return 1;
+  }
+  double load_time = timer_now() - load_start;
+  size_t ticks = replay_num_ticks(replay);
+
+  double start = timer_now();
+  while (replay_step(replay)) {
+  }
+  double elapsed = timer_now() - start;
+  size_t p1_score, p2_score;
+  sim_get_scores(replay_get_state(replay), &p1_score, &p2_score);
+
+  double seek_start = timer_now();
+  for (size_t i = SEEK_SAMPLES; i > 0; i--) {
+    replay_seek(replay, ticks * (i - 1) / SEEK_SAMPLES);
+  }
+  double seek_time = (timer_now() - seek_start) / SEEK_SAMPLES;
+
+  printf("replay %s: %zu ticks\n", path, ticks);
+  printf("load: %.3f ms\n", load_time * 1e3);
+  printf("playback: %.0f ticks per second\n", ticks / elapsed);
+  printf("seek: %.3f ms on average\n", seek_time * 1e3);
+  printf("final score %zu - %zu\n", p1_score, p2_score);
+  replay_free(replay);
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  size_t map = 0;
+  size_t ticks = DEFAULT_TICKS;
+  double dt = DEFAULT_DT;
+  unsigned int seed = DEFAULT_SEED;
+  size_t threads = 1;
+  opponent_t opponent = OPPONENT_PLAYER;
+  const char *record_path = NULL;
+  const char *trace_path = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    bool has_value = i + 1 < argc;
+    if (strcmp(argv[i], "-m") == 0 && has_value) {
+      map = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "-n") == 0 && has_value) {
+      ticks = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "-d") == 0 && has_value) {
+      dt = strtod(argv[++i], NULL);
+    } else if (strcmp(argv[i], "-s") == 0 && has_value) {
+      seed = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "-j") == 0 && has_value) {
+      threads = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "-b") == 0) {
+      opponent = OPPONENT_BOT;
+    } else if (strcmp(argv[i], "-p") == 0) {
+      opponent = OPPONENT_PLANNER;
+    } else if (strcmp(argv[i], "-r") == 0 && has_value) {
+      record_path = argv[++i];
+    } else if (strcmp(argv[i], "-t") == 0 && has_value) {
+      trace_path = argv[++i];
+    } else if (strcmp(argv[i], "-R") == 0 && has_value && argc == 3) {
+      return play_replay(argv[++i]);
+    } else {
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+  if (map >= sim_num_maps() || ticks == 0 || dt <= 0) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+#ifdef PROFILE
+  profiler_init(TRACE_CAPACITY);
+#else
+  if (trace_path != NULL) {
+    fprintf(stderr, "rebuild with 'make PROFILE=true sim' to write traces\n");
+    return 1;
+  }
+#endif
+
+  double load_start = timer_now();
+  state_t *state = sim_init(map, seed, opponent);
+  sim_set_threads(state, threads);
+  if (record_path != NULL && !sim_record(state, record_path)) {
+    fprintf(stderr, "could not open %s for recording\n", record_path);
+    sim_free(state);
+    return 1;
+  }
+  double load_time = timer_now() - load_start;
+
+  double start = timer_now();
+  for (size_t tick = 0; tick < ticks; tick++) {
+    sim_tick(state, dt, scripted_input(tick));
+  }
+  double elapsed = timer_now() - start;
+
+  size_t p1_score, p2_score;
+  sim_get_scores(state, &p1_score, &p2_score);
+  sim_timings_t timings = sim_get_timings(state);
+  printf("map %zu, %zu ticks of %g s, seed %u, %zu threads, %s\n", map,
+         ticks, dt, seed, threads, OPPONENT_NAMES[opponent]);
+  printf("map load: %.3f ms\n", load_time * 1e3);
+  printf("ticks per second: %.0f\n", ticks / elapsed);
+  print_phase("input", timings.input, ticks);
+  print_phase("collisions", timings.collisions, ticks);
+  print_phase("scene_tick", timings.scene, ticks);
+  print_phase("bot", timings.bot, ticks);
+  size_t rollouts = sim_planner_rollouts(state);
+  if (rollouts > 0) {
+    printf("planner: %zu rollouts, %.0f rollouts per second\n", rollouts,
+           rollouts / timings.bot);
+  }
+  printf("final score %zu - %zu, %zu bodies\n", p1_score, p2_score,
+         sim_bodies(state));
+
+#ifdef PROFILE
+  if (trace_path != NULL && !profiler_export_trace(trace_path)) {
+    fprintf(stderr, "could not write trace %s\n", trace_path);
+  }
+  profiler_free();
+#endif
+  sim_free(state);
+  return 0;
+}
@@ -0,0 +1,47 @@
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <stddef.h>
+
+/**
+ * A bump allocator for short-lived allocations, such as everything built
+ * while rendering a single frame. Individual allocations are never freed;
+ * the whole arena is reset at once instead.
+ */
+typedef struct arena arena_t;
+
+/**
+ * Allocates an arena.
+ *
+ * @param capacity the number of bytes to reserve up front
+ * @return a pointer to the newly allocated arena
+ */
+arena_t *arena_init(size_t capacity);
+
+/**
+ * Releases the arena and everything allocated from it.
+ *
+ * @param arena a pointer to an arena returned from arena_init()
+ */
+void arena_free(arena_t *arena);
+
+/**
+ * Allocates memory from the arena, suitably aligned for any type.
+ * If the arena is full, the memory comes from the heap and the arena grows
+ * on the next reset, so a steady workload stops touching the heap.
+ *
+ * @param arena a pointer to an arena returned from arena_init()
+ * @param size the number of bytes to allocate
+ * @return a pointer to the memory, valid until the next arena_reset()
+ */
+void *arena_alloc(arena_t *arena, size_t size);
+
+/**
+ * Invalidates every allocation made from the arena, making its space
+ * available again.
+ *
+ * @param arena a pointer to an arena returned from arena_init()
+ */
+void arena_reset(arena_t *arena);
+
+#endif // #ifndef __ARENA_H__
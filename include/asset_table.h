@@ -0,0 +1,60 @@
+#ifndef __ASSET_TABLE_H__
+#define __ASSET_TABLE_H__
+
+#include <stddef.h>
+#include <SDL2/SDL.h>
+
+#include "asset.h"
+#include "color.h"
+
+/**
+ * A hash-indexed table of shared text assets, keyed on the font, string and
+ * every parameter that affects how the text is drawn. Images are drawn from
+ * the texture atlas instead, so the table only holds text, whose textures
+ * are a single line each.
+ * Entries are reference counted. Entries nobody references are kept for
+ * reuse and evicted least recently used first once there are more of them
+ * than the table's budget.
+ */
+typedef struct asset_table asset_table_t;
+
+/**
+ * Allocates an empty table.
+ *
+ * @param idle_budget the number of unreferenced text assets kept for reuse
+ * @return a pointer to the newly allocated table
+ */
+asset_table_t *asset_table_init(size_t idle_budget);
+
+/**
+ * Destroys every asset in the table and releases the table.
+ *
+ * @param table a pointer to a table returned from asset_table_init()
+ */
+void asset_table_free(asset_table_t *table);
+
+/**
+ * Returns the text asset for a font, string, bounding box and color,
+ * creating it on a miss.
+ * Every acquire must be matched by an asset_table_release().
+ *
+ * @param table a pointer to a table returned from asset_table_init()
+ * @param filepath the path to the font file
+ * @param bounding_box the box the text is drawn in
+ * @param text the string to draw; the table keeps its own copy
+ * @param color the color of the text
+ * @return the shared asset
+ */
+asset_t *asset_table_acquire_text(asset_table_t *table, const char *filepath,
+                                  SDL_Rect bounding_box, const char *text,
+                                  rgb_color_t color);
+
+/**
+ * Drops one reference to an asset returned by the table.
+ *
+ * @param table a pointer to a table returned from asset_table_init()
+ * @param asset an asset acquired from this table
+ */
+void asset_table_release(asset_table_t *table, asset_t *asset);
+
+#endif // #ifndef __ASSET_TABLE_H__
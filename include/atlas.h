@@ -0,0 +1,106 @@
+#ifndef __ATLAS_H__
+#define __ATLAS_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <SDL2/SDL.h>
+
+#include "vector.h"
+
+/**
+ * A set of images packed into a few large textures ("pages"), so a whole
+ * screen of images can be drawn with one SDL_RenderGeometry() call per
+ * page instead of one texture bind and copy per image.
+ *
+ * Draws are batched between atlas_begin() and atlas_flush() and keep their
+ * order: consecutive images on the same page share a draw call.
+ */
+typedef struct atlas atlas_t;
+
+/**
+ * Allocates an empty atlas that draws to the game window's renderer.
+ *
+ * @return a pointer to the newly allocated atlas
+ */
+atlas_t *atlas_init(void);
+
+/**
+ * Packs decoded images into the atlas, uploading them to its pages. Each
+ * call packs its images tallest first onto the newest page and starts new
+ * pages as needed, so images can arrive in batches as they are decoded.
+ * Images that failed to decode or do not fit on a page are left out, and
+ * atlas_find() reports them missing. Images already in the atlas are
+ * skipped.
+ *
+ * @param atlas a pointer to an atlas returned from atlas_init()
+ * @param paths the image files the images came from
+ * @param surfaces the decoded images, or NULL for images that failed to
+ *   decode; the caller keeps ownership
+ * @param num_images the number of images
+ */
+void atlas_add_images(atlas_t *atlas, const char **paths,
+                      SDL_Surface **surfaces, size_t num_images);
+
+/**
+ * Releases the atlas and its textures.
+ *
+ * @param atlas a pointer to an atlas returned from atlas_init()
+ */
+void atlas_free(atlas_t *atlas);
+
+/**
+ * Looks up an image in the atlas.
+ *
+ * @param atlas a pointer to an atlas returned from atlas_init(), or NULL
+ * @param path the image file
+ * @param index set to the image's index if it was found
+ * @return false if the image is not in the atlas
+ */
+bool atlas_find(atlas_t *atlas, const char *path, size_t *index);
+
+/**
+ * Gets the number of textures the images were packed into.
+ *
+ * @param atlas a pointer to an atlas returned from atlas_init()
+ * @return the number of pages
+ */
+size_t atlas_num_pages(atlas_t *atlas);
+
+/**
+ * Starts a new batch of images.
+ *
+ * @param atlas a pointer to an atlas returned from atlas_init()
+ */
+void atlas_begin(atlas_t *atlas);
+
+/**
+ * Adds an image to the batch, drawn in a box in window pixels.
+ *
+ * @param atlas a pointer to an atlas returned from atlas_init()
+ * @param index an index from atlas_find()
+ * @param box where to draw the image
+ */
+void atlas_add_image(atlas_t *atlas, size_t index, SDL_Rect box);
+
+/**
+ * Adds an image to the batch, drawn in a box seen through a camera. The
+ * camera rectangle is scaled to fit the window, the same way
+ * render_batch_begin() does, but with y pointing down like the box.
+ *
+ * @param atlas a pointer to an atlas returned from atlas_init()
+ * @param index an index from atlas_find()
+ * @param box where to draw the image, in the camera's coordinates
+ * @param cam_center the position at the center of the window
+ * @param cam_size the width and height of the area that is visible
+ */
+void atlas_add_image_cam(atlas_t *atlas, size_t index, SDL_Rect box,
+                         vector_t cam_center, vector_t cam_size);
+
+/**
+ * Draws everything added since atlas_begin().
+ *
+ * @param atlas a pointer to an atlas returned from atlas_init()
+ */
+void atlas_flush(atlas_t *atlas);
+
+#endif // #ifndef __ATLAS_H__
@@ -0,0 +1,77 @@
+#ifndef __BROADPHASE_H__
+#define __BROADPHASE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "vector.h"
+
+/**
+ * A uniform-grid broad-phase over axis-aligned bounding boxes.
+ * Boxes are re-inserted every tick; the grid only answers which pairs of
+ * boxes may be touching so that the narrow-phase runs on those alone.
+ */
+typedef struct broadphase broadphase_t;
+
+/**
+ * A candidate pair of overlapping boxes, identified by the ids they were
+ * inserted with. The first id always belongs to the box inserted earlier.
+ */
+typedef struct broadphase_pair {
+  size_t first;
+  size_t second;
+} broadphase_pair_t;
+
+/**
+ * Allocates a broad-phase grid covering the rectangle [min, max].
+ * Boxes outside of that rectangle are clamped into the border cells.
+ *
+ * @param min the bottom left corner of the arena
+ * @param max the top right corner of the arena
+ * @param cell_size the side length of each grid cell
+ * @return a pointer to the newly allocated broad-phase
+ */
+broadphase_t *broadphase_init(vector_t min, vector_t max, double cell_size);
+
+/**
+ * Releases the memory allocated for the broad-phase.
+ *
+ * @param bp a pointer to a broad-phase returned from broadphase_init()
+ */
+void broadphase_free(broadphase_t *bp);
+
+/**
+ * Removes every box from the broad-phase. Buffers are kept for reuse.
+ *
+ * @param bp a pointer to a broad-phase returned from broadphase_init()
+ */
+void broadphase_clear(broadphase_t *bp);
+
+/**
+ * Inserts a bounding box. Pairs of two static boxes are never reported, and
+ * neither are pairs where either box's mask excludes the other's category.
+ *
+ * @param bp a pointer to a broad-phase returned from broadphase_init()
+ * @param id the value reported for this box in candidate pairs
+ * @param min the bottom left corner of the box
+ * @param max the top right corner of the box
+ * @param is_static whether the box belongs to an immovable body
+ * @param category the collision category bits of the box
+ * @param mask the categories the box collides with
+ */
+void broadphase_add(broadphase_t *bp, size_t id, vector_t min, vector_t max,
+                    bool is_static, uint32_t category, uint32_t mask);
+
+/**
+ * Computes every pair of inserted boxes that overlap. Each pair is reported
+ * exactly once, in an order that only depends on the insertion order.
+ *
+ * @param bp a pointer to a broad-phase returned from broadphase_init()
+ * @param pairs set to an array of pairs owned by the broad-phase, valid
+ *   until the next call to broadphase_add() or broadphase_pairs()
+ * @return the number of candidate pairs
+ */
+size_t broadphase_pairs(broadphase_t *bp, broadphase_pair_t **pairs);
+
+#endif // #ifndef __BROADPHASE_H__
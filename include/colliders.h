@@ -0,0 +1,240 @@
+#ifndef __COLLIDERS_H__
+#define __COLLIDERS_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "body.h"
+#include "sat.h"
+#include "vector.h"
+
+/**
+ * The set of bodies taking part in collision detection.
+ * Per-body collision data is kept in parallel arrays (structure of arrays)
+ * so that per-tick passes over all bodies run over contiguous memory.
+ * The vertices of every shape live inline in a single shared pool, so adding
+ * a body costs no allocations beyond occasional amortized growth.
+ * Bodies are never removed; colliders_set_active() takes one out of play
+ * instead, so the index of a body stays the same for the life of the set.
+ */
+typedef struct colliders colliders_t;
+
+/**
+ * Allocates an empty collider set.
+ *
+ * @param initial_capacity the number of bodies to allocate space for
+ * @return a pointer to the newly allocated collider set
+ */
+colliders_t *colliders_init(size_t initial_capacity);
+
+/**
+ * Releases the memory allocated for the collider set.
+ * Does not free the bodies, which are owned by the scene.
+ *
+ * @param colliders a pointer to a collider set returned from colliders_init()
+ */
+void colliders_free(colliders_t *colliders);
+
+/**
+ * Gets the number of bodies in the collider set.
+ *
+ * @param colliders a pointer to a collider set returned from colliders_init()
+ * @return the number of bodies
+ */
+size_t colliders_size(colliders_t *colliders);
+
+/**
+ * Registers a body. Its shape is copied once, relative to its centroid,
+ * along with its edge normals and a bounding radius that stays valid for any
+ * rotation of the body. Static bodies (infinite mass) must never turn: their
+ * bounding box is the exact box of their shape, so long walls only cover
+ * the cells they lie in.
+ *
+ * @param colliders a pointer to a collider set returned from colliders_init()
+ * @param body the body to register
+ * @param category the collision category bits of the body
+ * @param mask the categories the body collides with
+ * @return the index of the body in the collider set
+ */
+size_t colliders_add(colliders_t *colliders, body_t *body, uint32_t category,
+                     uint32_t mask);
+
+/**
+ * Gets the body at a given index.
+ *
+ * @param colliders a pointer to a collider set returned from colliders_init()
+ * @param index an index in the collider set
+ * @return the body at that index
+ */
+body_t *colliders_get_body(colliders_t *colliders, size_t index);
+
+/**
+ * Transforms the shape of a body to its current position and rotation.
+ * Writes into storage owned by the collider set, so no memory is allocated.
+ * The transformed vertices and normals are cached with the transform they
+ * were computed for, so a body that has not moved or turned since its shape
+ * was last placed is not transformed again.
+ *
+ * @param colliders a pointer to a collider set returned from colliders_init()
+ * @param index an index in the collider set
+ * @return a view of the shape, valid until the next call for the same index
+ *   or the next colliders_add()
+ */
+sat_polygon_t colliders_get_shape(colliders_t *colliders, size_t index);
+
+/**
+ * Transforms the shapes of the bodies at indices [start, end) to their
+ * current positions and rotations, as colliders_get_shape() does.
+ * Calls for disjoint ranges may run concurrently.
+ *
+ * @param colliders a pointer to a collider set returned from colliders_init()
+ * @param start the first index to transform
+ * @param end one past the last index to transform
+ */
+void colliders_transform_shapes(colliders_t *colliders, size_t start,
+                                size_t end);
+
+/**
+ * Gets the shape of a body as last transformed, without transforming it
+ * again. The view borrows the collider set's storage and must not be
+ * written through. Safe to call from several threads at once.
+ *
+ * @param colliders a pointer to a collider set returned from colliders_init()
+ * @param index an index in the collider set
+ * @return a view of the shape, with the same lifetime as colliders_get_shape()
+ */
+sat_polygon_t colliders_get_world_shape(colliders_t *colliders, size_t index);
+
+/**
+ * Records the current position and rotation of every body as the start of
+ * the next tick, for colliders_get_interpolated_shape().
+ * Must be called once per tick before the bodies move.
+ *
+ * @param colliders a pointer to a collider set returned from colliders_init()
+ */
+void colliders_save_transforms(colliders_t *colliders);
+
+/**
+ * Gets the centroid of a body part of the way through the last tick.
+ *
+ * @param colliders a pointer to a collider set returned from colliders_init()
+ * @param index an index in the collider set
+ * @param alpha 0 for the position at the start of the tick, 1 for the
+ *   current position
+ * @return the interpolated centroid
+ */
+vector_t colliders_get_interpolated_centroid(colliders_t *colliders,
+                                             size_t index, double alpha);
+
+/**
+ * Places the shape of a body part of the way through the last tick, so that
+ * rendering between ticks moves smoothly. Moving bodies are written to a
+ * scratch buffer rather than their world space block, which keeps the
+ * shapes colliders_get_world_shape() returns at the tick's transform.
+ *
+ * @param colliders a pointer to a collider set returned from colliders_init()
+ * @param index an index in the collider set
+ * @param alpha 0 for the transform at the start of the tick, 1 for the
+ *   current transform
+ * @return a view of the shape, valid until the next call to
+ *   colliders_get_interpolated_shape(), colliders_get_shape() for the same
+ *   index, or colliders_add()
+ */
+sat_polygon_t colliders_get_interpolated_shape(colliders_t *colliders,
+                                               size_t index, double alpha);
+
+/**
+ * Refreshes the cached centroids and bounding boxes of every body.
+ * Must be called once per tick before bounds are read.
+ *
+ * @param colliders a pointer to a collider set returned from colliders_init()
+ */
+void colliders_update(colliders_t *colliders);
+
+/**
+ * Gets the bounding box of a body as of the last colliders_update().
+ *
+ * @param colliders a pointer to a collider set returned from colliders_init()
+ * @param index an index in the collider set
+ * @param min set to the bottom left corner of the box
+ * @param max set to the top right corner of the box
+ */
+void colliders_get_bounds(colliders_t *colliders, size_t index, vector_t *min,
+                          vector_t *max);
+
+/**
+ * Finds the active bodies that may be visible in a rectangle at any point
+ * of the last tick, for culling before rendering. Each body is tested with
+ * its bounding box as of the last colliders_update() grown to also cover
+ * where it was at the last colliders_save_transforms(), so every
+ * interpolated position is covered.
+ *
+ * @param colliders a pointer to a collider set returned from colliders_init()
+ * @param min the bottom left corner of the rectangle
+ * @param max the top right corner of the rectangle
+ * @param indices filled with the indices of the bodies found; must have room
+ *   for colliders_size() indices
+ * @return the number of bodies found
+ */
+size_t colliders_find_visible(colliders_t *colliders, vector_t min,
+                              vector_t max, size_t *indices);
+
+/**
+ * Gets the distance from the centroid of a body to its farthest vertex.
+ *
+ * @param colliders a pointer to a collider set returned from colliders_init()
+ * @param index an index in the collider set
+ * @return the radius of a circle around the body at any rotation
+ */
+double colliders_get_radius(colliders_t *colliders, size_t index);
+
+/**
+ * Returns whether the body at a given index has infinite mass.
+ *
+ * @param colliders a pointer to a collider set returned from colliders_init()
+ * @param index an index in the collider set
+ * @return true if the body never moves in a collision
+ */
+bool colliders_is_static(colliders_t *colliders, size_t index);
+
+/**
+ * Gets the collision category bits of the body at a given index.
+ *
+ * @param colliders a pointer to a collider set returned from colliders_init()
+ * @param index an index in the collider set
+ * @return the category bits passed to colliders_add()
+ */
+uint32_t colliders_get_category(colliders_t *colliders, size_t index);
+
+/**
+ * Gets the categories the body at a given index collides with.
+ *
+ * @param colliders a pointer to a collider set returned from colliders_init()
+ * @param index an index in the collider set
+ * @return the mask passed to colliders_add()
+ */
+uint32_t colliders_get_mask(colliders_t *colliders, size_t index);
+
+/**
+ * Returns whether the body at a given index takes part in collisions and
+ * rendering. Bodies are active when added.
+ *
+ * @param colliders a pointer to a collider set returned from colliders_init()
+ * @param index an index in the collider set
+ * @return true if the body is active
+ */
+bool colliders_is_active(colliders_t *colliders, size_t index);
+
+/**
+ * Activates or parks a body without removing it, so that pooled bodies can be
+ * reused. Activating a body also restarts its interpolation from its current
+ * transform.
+ *
+ * @param colliders a pointer to a collider set returned from colliders_init()
+ * @param index an index in the collider set
+ * @param active whether the body should take part in collisions and rendering
+ */
+void colliders_set_active(colliders_t *colliders, size_t index, bool active);
+
+#endif // #ifndef __COLLIDERS_H__
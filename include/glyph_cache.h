@@ -0,0 +1,103 @@
+#ifndef __GLYPH_CACHE_H__
+#define __GLYPH_CACHE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <SDL2/SDL.h>
+
+#include "color.h"
+
+/**
+ * Draws text from glyphs cached in a few textures. Each glyph of each font
+ * and size is rasterized once, in white, the first time it is drawn; after
+ * that a string costs one textured quad per glyph, tinted to its color, and
+ * every string between glyph_cache_begin() and glyph_cache_flush() is drawn
+ * with one SDL_RenderGeometry() call per glyph page.
+ */
+typedef struct glyph_cache glyph_cache_t;
+
+/**
+ * Allocates an empty cache that draws to the game window's renderer.
+ *
+ * @return a pointer to the newly allocated cache
+ */
+glyph_cache_t *glyph_cache_init(void);
+
+/**
+ * Closes the cache's fonts and releases its textures.
+ *
+ * @param cache a pointer to a cache returned from glyph_cache_init()
+ */
+void glyph_cache_free(glyph_cache_t *cache);
+
+/**
+ * Opens a font at a size, or finds it if it is already open. A font that
+ * failed to open is not retried.
+ *
+ * @param cache a pointer to a cache returned from glyph_cache_init()
+ * @param filepath the path to the font file
+ * @param point_size the size of the font
+ * @param font set to an id for the font and size if it opened
+ * @return false if there is no renderer or the font could not be opened;
+ *   callers should fall back to text assets
+ */
+bool glyph_cache_load_font(glyph_cache_t *cache, const char *filepath,
+                           int point_size, size_t *font);
+
+/**
+ * Gets the width of a string, rasterizing any glyphs it has not seen.
+ *
+ * @param cache a pointer to a cache returned from glyph_cache_init()
+ * @param font an id from glyph_cache_load_font()
+ * @param text a UTF-8 string
+ * @return the width in pixels
+ */
+int glyph_cache_text_width(glyph_cache_t *cache, size_t font,
+                           const char *text);
+
+/**
+ * Gets the distance between the tops of two lines of text.
+ *
+ * @param cache a pointer to a cache returned from glyph_cache_init()
+ * @param font an id from glyph_cache_load_font()
+ * @return the line height in pixels
+ */
+int glyph_cache_line_height(glyph_cache_t *cache, size_t font);
+
+/**
+ * Starts a new batch of text.
+ *
+ * @param cache a pointer to a cache returned from glyph_cache_init()
+ */
+void glyph_cache_begin(glyph_cache_t *cache);
+
+/**
+ * Adds a single line of text to the batch.
+ *
+ * @param cache a pointer to a cache returned from glyph_cache_init()
+ * @param font an id from glyph_cache_load_font()
+ * @param text a UTF-8 string
+ * @param x the left edge of the text, in window pixels
+ * @param y the top edge of the text, in window pixels
+ * @param color the color of the text
+ */
+void glyph_cache_add_text(glyph_cache_t *cache, size_t font, const char *text,
+                          int x, int y, rgb_color_t color);
+
+/**
+ * Draws everything added since glyph_cache_begin().
+ *
+ * @param cache a pointer to a cache returned from glyph_cache_init()
+ */
+void glyph_cache_flush(glyph_cache_t *cache);
+
+/**
+ * Gets the number of glyphs rasterized so far. It stays put while the same
+ * text is drawn again.
+ *
+ * @param cache a pointer to a cache returned from glyph_cache_init()
+ * @return the number of glyphs in the cache
+ */
+size_t glyph_cache_num_glyphs(glyph_cache_t *cache);
+
+#endif // #ifndef __GLYPH_CACHE_H__
@@ -0,0 +1,104 @@
+#ifndef __GRAVITY_H__
+#define __GRAVITY_H__
+
+#include <stddef.h>
+
+#include "vector.h"
+
+/**
+ * The pull of a fixed set of attractors, such as black holes, precomputed
+ * on a grid. Sampling interpolates between the four nearest grid points, so
+ * it costs the same however many attractors there are.
+ */
+typedef struct gravity_field gravity_field_t;
+
+/**
+ * A Barnes-Hut quadtree over bodies that attract each other. Groups of
+ * bodies far enough away are treated as one body at their center of mass,
+ * so finding the pull on every body takes O(n log n) time instead of
+ * O(n^2).
+ */
+typedef struct gravity_tree gravity_tree_t;
+
+/**
+ * Precomputes the acceleration towards a set of attractors at the corners of
+ * a grid covering a rectangle. The pull is softened, falling off as
+ * r / (r^2 + softening^2)^(3/2), so it stays finite at the attractors.
+ *
+ * @param min the bottom left corner of the rectangle
+ * @param max the top right corner of the rectangle
+ * @param cell_size the spacing of the grid
+ * @param G the gravitational constant
+ * @param softening the distance below which the pull stops growing
+ * @param locations the positions of the attractors
+ * @param masses the masses of the attractors
+ * @param num_attractors the number of attractors
+ * @return a pointer to the newly allocated field
+ */
+gravity_field_t *gravity_field_init(vector_t min, vector_t max,
+                                    double cell_size, double G,
+                                    double softening,
+                                    const vector_t *locations,
+                                    const double *masses,
+                                    size_t num_attractors);
+
+/**
+ * Releases the memory allocated for the field.
+ *
+ * @param field a pointer to a field returned from gravity_field_init()
+ */
+void gravity_field_free(gravity_field_t *field);
+
+/**
+ * Gets the acceleration at a point by bilinear interpolation. Points outside
+ * the grid get the acceleration at the nearest point on its edge.
+ *
+ * @param field a pointer to a field returned from gravity_field_init()
+ * @param pos the point
+ * @return the acceleration of a body at that point
+ */
+vector_t gravity_field_sample(gravity_field_t *field, vector_t pos);
+
+/**
+ * Allocates an empty tree.
+ *
+ * @param G the gravitational constant
+ * @param softening the distance below which the pull stops growing, as for
+ *   gravity_field_init()
+ * @param theta how far away a group must be to be treated as one body: its
+ *   width divided by its distance must be below theta. 0 is exact; 0.5 is
+ *   the usual trade-off.
+ * @return a pointer to the newly allocated tree
+ */
+gravity_tree_t *gravity_tree_init(double G, double softening, double theta);
+
+/**
+ * Releases the memory allocated for the tree.
+ *
+ * @param tree a pointer to a tree returned from gravity_tree_init()
+ */
+void gravity_tree_free(gravity_tree_t *tree);
+
+/**
+ * Rebuilds the tree over a set of bodies, replacing the previous ones.
+ * Reuses the tree's memory, so a steady number of bodies stops allocating.
+ *
+ * @param tree a pointer to a tree returned from gravity_tree_init()
+ * @param positions the positions of the bodies
+ * @param masses the masses of the bodies
+ * @param num_bodies the number of bodies
+ */
+void gravity_tree_build(gravity_tree_t *tree, const vector_t *positions,
+                        const double *masses, size_t num_bodies);
+
+/**
+ * Gets the acceleration at a point from every body in the tree. A body at
+ * exactly that point adds nothing, so a body can sample its own position.
+ *
+ * @param tree a pointer to a tree returned from gravity_tree_init()
+ * @param pos the point
+ * @return the acceleration of a body at that point
+ */
+vector_t gravity_tree_sample(gravity_tree_t *tree, vector_t pos);
+
+#endif // #ifndef __GRAVITY_H__
@@ -0,0 +1,67 @@
+#ifndef __JOB_POOL_H__
+#define __JOB_POOL_H__
+
+#include <stddef.h>
+
+/**
+ * A fixed set of worker threads that run data-parallel loops.
+ * Each loop is cut into chunks that are dealt out evenly to the threads;
+ * a thread that runs out of chunks steals from the back of another
+ * thread's share, so uneven chunks still keep every thread busy.
+ *
+ * Builds without thread support (emscripten without -pthread) run every
+ * loop on the calling thread.
+ */
+typedef struct job_pool job_pool_t;
+
+/**
+ * A loop body, run for the indices [start, end).
+ * Chunks of the same loop may run concurrently on different threads, so a
+ * job must only write to memory owned by its own indices.
+ *
+ * @param aux the value passed to job_pool_run()
+ * @param start the first index of the chunk
+ * @param end one past the last index of the chunk
+ */
+typedef void (*job_func_t)(void *aux, size_t start, size_t end);
+
+/**
+ * Starts a job pool.
+ *
+ * @param num_threads the number of threads that run jobs, including the
+ *   calling thread. 0 picks one per available core; 1 runs everything on
+ *   the calling thread.
+ * @return a pointer to the newly allocated job pool
+ */
+job_pool_t *job_pool_init(size_t num_threads);
+
+/**
+ * Stops the worker threads and releases the job pool.
+ *
+ * @param pool a pointer to a job pool returned from job_pool_init()
+ */
+void job_pool_free(job_pool_t *pool);
+
+/**
+ * Gets the number of threads that run jobs, including the calling thread.
+ *
+ * @param pool a pointer to a job pool returned from job_pool_init()
+ * @return the number of threads
+ */
+size_t job_pool_num_threads(job_pool_t *pool);
+
+/**
+ * Runs `func` over the indices [0, count) in chunks of at most `grain`
+ * indices, and returns once every chunk has finished. The calling thread
+ * runs chunks too.
+ *
+ * @param pool a pointer to a job pool returned from job_pool_init()
+ * @param count the number of indices
+ * @param grain the largest number of indices handed to one call of `func`
+ * @param func the loop body
+ * @param aux passed to every call of `func`
+ */
+void job_pool_run(job_pool_t *pool, size_t count, size_t grain,
+                  job_func_t func, void *aux);
+
+#endif // #ifndef __JOB_POOL_H__
@@ -0,0 +1,84 @@
+#ifndef __MAP_FILE_H__
+#define __MAP_FILE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "vector.h"
+
+/**
+ * A map: its obstacles, asteroids, black holes, start positions and
+ * background layers. Every array points into the map's own storage and is
+ * read-only.
+ *
+ * Maps are written as text, one item per line, where `#` starts a comment:
+ *
+ *   backdrop assets/space1.png
+ *   layer assets/neptune.png 400 150 300 300 6  # path x y w h depth
+ *   block 100 100 100 100                       # center x y, w h
+ *   blackhole 500 250 1e6                       # x y mass
+ *   mutual_gravity 100                          # G between bodies
+ *   asteroids 10                                # at most 4096
+ *   start 100 300                               # player 1, then player 2
+ *   start 700 200
+ *
+ * map_file_save() compiles a map into a binary file that map_file_load()
+ * reads in a single read, with no parsing and no per-item allocations.
+ */
+typedef struct map {
+  size_t num_blocks;
+  size_t num_asteroids;
+  size_t num_blackholes;
+  size_t num_bg;
+  const char *backdrop_path; // NULL if the map has no backdrop
+  const char **bg_paths;
+  const vector_t *bg_pos;
+  const vector_t *bg_sizes;
+  const double *bg_depth;
+  const vector_t *block_locations;
+  const vector_t *block_sizes;
+  const vector_t *blackhole_locations;
+  const double *blackhole_masses;
+  const vector_t *start_pos; // one per player
+  double mutual_gravity; // how strongly bodies attract each other; 0 if not
+
+  // the map in its binary form, which everything above points into
+  uint8_t *data;
+  size_t size;
+} map_t;
+
+/**
+ * Reads a map written as text. Errors are reported on stderr with the line
+ * they were found on.
+ *
+ * @param path the text file to read
+ * @return the map, or NULL if the file is missing or malformed
+ */
+map_t *map_file_parse(const char *path);
+
+/**
+ * Reads a map compiled by map_file_save().
+ *
+ * @param path the binary file to read
+ * @return the map, or NULL if the file is missing or is not a compiled map
+ */
+map_t *map_file_load(const char *path);
+
+/**
+ * Writes a map in its binary form.
+ *
+ * @param map a map returned from map_file_parse() or map_file_load()
+ * @param path the file to create, overwriting any existing file
+ * @return false if the file could not be written
+ */
+bool map_file_save(map_t *map, const char *path);
+
+/**
+ * Releases the memory allocated for a map.
+ *
+ * @param map a map returned from map_file_parse() or map_file_load()
+ */
+void map_file_free(map_t *map);
+
+#endif // #ifndef __MAP_FILE_H__
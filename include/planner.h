@@ -0,0 +1,131 @@
+#ifndef __PLANNER_H__
+#define __PLANNER_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "job_pool.h"
+#include "vector.h"
+
+/**
+ * A lookahead opponent. Each call to planner_plan() simulates candidate key
+ * sequences forward on a simplified copy of the arena, scores where they
+ * lead and keeps the best one. The best plan carries over between calls,
+ * so planning resumes where it left off rather than starting from scratch.
+ */
+typedef struct planner planner_t;
+
+/**
+ * Bits of the planner's per-tick output.
+ */
+typedef enum planner_input {
+  PLANNER_TURN = 1 << 0,
+  PLANNER_SHOOT = 1 << 1
+} planner_input_t;
+
+/**
+ * The game rules the rollouts follow. Units match the game's.
+ */
+typedef struct planner_params {
+  double dt; // the length of a tick
+  size_t horizon; // the number of ticks each candidate looks ahead
+  double thrust;
+  double drag;
+  double rot_drag; // fraction of spin lost per second
+  double rot_speed;
+  double rot_accel;
+  double boost_velocity;
+  double boost_angle;
+  double boost_rot_speed;
+  double double_tap_time;
+  double reload_time;
+  double bullet_speed;
+  double bullet_radius;
+  double ship_height; // distance from a ship's centroid to where bullets spawn
+} planner_params_t;
+
+typedef struct planner_body {
+  vector_t position;
+  vector_t velocity;
+  double angle;
+  double radius;
+  double mass;
+} planner_body_t;
+
+typedef struct planner_box {
+  vector_t min;
+  vector_t max;
+} planner_box_t;
+
+/**
+ * A snapshot of everything the rollouts simulate. Arrays are only read
+ * during planner_plan() and may be freed afterwards.
+ */
+typedef struct planner_world {
+  vector_t min;
+  vector_t max;
+  planner_body_t self;
+  planner_body_t target;
+  bool turn_held;
+  double time_since_turn_press;
+  double time_since_turn_release;
+  double time_since_shot;
+
+  planner_body_t *asteroids;
+  size_t num_asteroids;
+  planner_body_t *bullets;
+  size_t num_bullets;
+  planner_box_t *obstacles;
+  size_t num_obstacles;
+} planner_world_t;
+
+/**
+ * Allocates a planner.
+ *
+ * @param params the rules of the game
+ * @param pool the job pool that runs rollouts, owned by the caller
+ * @param seed the seed for generating candidates
+ * @return a pointer to the newly allocated planner
+ */
+planner_t *planner_init(planner_params_t params, job_pool_t *pool,
+                        unsigned int seed);
+
+/**
+ * Releases the memory allocated for the planner.
+ *
+ * @param planner a pointer to a planner returned from planner_init()
+ */
+void planner_free(planner_t *planner);
+
+/**
+ * Improves the current plan against a snapshot of the arena, running
+ * batches of rollouts until either the deadline passes or `max_rollouts`
+ * have run. With an infinite deadline, the result only depends on the
+ * seed and the snapshots, not on timing or the number of threads.
+ *
+ * @param planner a pointer to a planner returned from planner_init()
+ * @param world the current state of the arena
+ * @param deadline the timer_now() time by which to stop
+ * @param max_rollouts the largest number of rollouts to run
+ */
+void planner_plan(planner_t *planner, const planner_world_t *world,
+                  double deadline, size_t max_rollouts);
+
+/**
+ * Takes the first tick of the current plan.
+ *
+ * @param planner a pointer to a planner returned from planner_init()
+ * @return the keys to hold this tick, as planner_input_t bits
+ */
+uint32_t planner_next_input(planner_t *planner);
+
+/**
+ * Gets the number of rollouts run since the planner was created.
+ *
+ * @param planner a pointer to a planner returned from planner_init()
+ * @return the number of rollouts
+ */
+size_t planner_rollouts(planner_t *planner);
+
+#endif // #ifndef __PLANNER_H__
@@ -0,0 +1,100 @@
+#ifndef __PRELOADER_H__
+#define __PRELOADER_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_mixer.h>
+
+/**
+ * Decodes image and sound files on worker threads, so the main thread only
+ * has to upload the results. Files are decoded in the order they were
+ * requested and handed back through preloader_poll().
+ *
+ * Builds without threads (the web game without THREADS=true) decode one
+ * file per preloader_step() on the calling thread instead, so the game
+ * still gets to draw between files.
+ */
+typedef struct preloader preloader_t;
+
+typedef enum preload_type {
+  PRELOAD_IMAGE, // PNG or JPG, decoded to 32-bit RGBA
+  PRELOAD_SOUND, // WAV, decoded to the mixer's format
+  PRELOAD_MUSIC // OGG, opened for streaming
+} preload_type_t;
+
+/**
+ * A decoded file. The caller owns whichever of `image`, `sound` and
+ * `music` matches the type; it is NULL if the file could not be decoded.
+ */
+typedef struct preload_result {
+  const char *path; // valid until preloader_free()
+  preload_type_t type;
+  SDL_Surface *image;
+  Mix_Chunk *sound;
+  Mix_Music *music;
+} preload_result_t;
+
+/**
+ * Starts the worker threads. Sounds can only be decoded once the mixer has
+ * been opened, so call this after sdl_init().
+ *
+ * @param num_threads the number of workers; 0 decodes on the calling thread
+ * @return a pointer to the newly allocated preloader
+ */
+preloader_t *preloader_init(size_t num_threads);
+
+/**
+ * Stops the workers and releases everything not yet handed back.
+ *
+ * @param preloader a pointer to a preloader returned from preloader_init()
+ */
+void preloader_free(preloader_t *preloader);
+
+/**
+ * Queues a file to be decoded. Files that were already requested are not
+ * decoded again.
+ *
+ * @param preloader a pointer to a preloader returned from preloader_init()
+ * @param path the file to decode
+ * @param type what kind of file it is
+ */
+void preloader_request(preloader_t *preloader, const char *path,
+                       preload_type_t type);
+
+/**
+ * Without worker threads, decodes the next queued file. Does nothing when
+ * workers are running. Call once a frame.
+ *
+ * @param preloader a pointer to a preloader returned from preloader_init()
+ */
+void preloader_step(preloader_t *preloader);
+
+/**
+ * Blocks until every requested file has been decoded, decoding on the
+ * calling thread if there are no workers.
+ *
+ * @param preloader a pointer to a preloader returned from preloader_init()
+ */
+void preloader_finish(preloader_t *preloader);
+
+/**
+ * Takes a decoded file, without waiting.
+ *
+ * @param preloader a pointer to a preloader returned from preloader_init()
+ * @param result filled in with the file, which the caller now owns
+ * @return false if no decoded file is waiting
+ */
+bool preloader_poll(preloader_t *preloader, preload_result_t *result);
+
+/**
+ * Gets how many of the requested files have been decoded.
+ *
+ * @param preloader a pointer to a preloader returned from preloader_init()
+ * @param decoded set to the number of files decoded so far
+ * @param requested set to the number of files requested so far
+ */
+void preloader_progress(preloader_t *preloader, size_t *decoded,
+                        size_t *requested);
+
+#endif // #ifndef __PRELOADER_H__
@@ -0,0 +1,129 @@
+#ifndef __PROFILER_H__
+#define __PROFILER_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "timer.h"
+
+/**
+ * A frame profiler. Timed phases are recorded into a global ring buffer
+ * that any thread can append to without locking; the oldest events are
+ * overwritten once it is full.
+ *
+ * Instrumentation uses PROFILE_BEGIN()/PROFILE_END(), or PROFILE_RECORD()
+ * where the times are already measured. They compile to nothing unless
+ * PROFILE is defined ('make PROFILE=true ...'), so a normal build pays
+ * nothing for them.
+ */
+typedef enum profile_phase {
+  PROFILE_FRAME, // all of emscripten_main()
+  PROFILE_TICK, // one fixed physics tick
+  PROFILE_INPUT,
+  PROFILE_BROADPHASE,
+  PROFILE_NARROWPHASE,
+  PROFILE_HANDLERS, // collision handlers
+  PROFILE_SCENE_TICK, // forces and integration
+  PROFILE_BOT,
+  PROFILE_PLANNER,
+  PROFILE_BACKGROUND,
+  PROFILE_BODIES,
+  PROFILE_SCORES,
+  PROFILE_OVERLAY,
+  PROFILE_SHOW,
+  PROFILE_JOB // one chunk of a job pool loop
+} profile_phase_t;
+
+// profile_phase_t runs from PROFILE_FRAME to PROFILE_JOB
+#define NUM_PROFILE_PHASES (PROFILE_JOB + 1)
+
+typedef struct profile_event {
+  profile_phase_t phase;
+  uint32_t thread;
+  double start; // timer_now() times
+  double end;
+} profile_event_t;
+
+#ifdef PROFILE
+#define PROFILE_BEGIN(start) double start = timer_now()
+#define PROFILE_END(phase, start) profiler_record(phase, start, timer_now())
+#define PROFILE_RECORD(phase, start, end) profiler_record(phase, start, end)
+#define PROFILE_THREAD(thread) profiler_set_thread(thread)
+#else
+#define PROFILE_BEGIN(start)
+#define PROFILE_END(phase, start)
+#define PROFILE_RECORD(phase, start, end)
+#define PROFILE_THREAD(thread)
+#endif
+
+/**
+ * Allocates the ring buffer. Events recorded before this are dropped.
+ *
+ * @param capacity the number of events kept
+ */
+void profiler_init(size_t capacity);
+
+/**
+ * Releases the ring buffer.
+ */
+void profiler_free(void);
+
+/**
+ * Sets the thread id that the calling thread's events are tagged with.
+ * Threads default to 0.
+ *
+ * @param thread the id, e.g. a job pool worker's index
+ */
+void profiler_set_thread(uint32_t thread);
+
+/**
+ * Appends an event to the ring buffer. Safe to call from any thread.
+ *
+ * @param phase the phase that ran
+ * @param start when it started, from timer_now()
+ * @param end when it ended, from timer_now()
+ */
+void profiler_record(profile_phase_t phase, double start, double end);
+
+/**
+ * Gets the name of a phase, as shown in the overlay and in traces.
+ *
+ * @param phase the phase
+ * @return a static string
+ */
+const char *profiler_phase_name(profile_phase_t phase);
+
+/**
+ * The functions below read the ring buffer. Call them only while no other
+ * thread is recording, e.g. on the main thread between job pool loops.
+ */
+
+/**
+ * Gets the lengths of the most recent frames.
+ *
+ * @param times filled with frame lengths in seconds, oldest first
+ * @param max the length of `times`
+ * @return the number of frames written
+ */
+size_t profiler_frame_times(double *times, size_t max);
+
+/**
+ * Gets the time spent in each phase during the most recent frame. Nested
+ * phases are also counted in the phases around them.
+ *
+ * @param seconds filled with NUM_PROFILE_PHASES totals, in seconds
+ * @return false if no frame has been recorded yet
+ */
+bool profiler_phase_times(double *seconds);
+
+/**
+ * Writes every event in the ring buffer as a Chrome trace, which can be
+ * opened in chrome://tracing or Perfetto.
+ *
+ * @param path the file to write
+ * @return false if the file could not be written
+ */
+bool profiler_export_trace(const char *path);
+
+#endif // #ifndef __PROFILER_H__
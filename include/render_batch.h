@@ -0,0 +1,85 @@
+#ifndef __RENDER_BATCH_H__
+#define __RENDER_BATCH_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <SDL2/SDL.h>
+
+#include "color.h"
+#include "vector.h"
+
+/**
+ * Collects convex polygons into reusable vertex and index buffers and draws
+ * them with as few SDL_RenderGeometry() calls as possible: one for every
+ * opaque polygon and one for every translucent polygon.
+ */
+typedef struct render_batch render_batch_t;
+
+/**
+ * Allocates an empty batch that draws to the game window's renderer.
+ *
+ * @return a pointer to the newly allocated batch
+ */
+render_batch_t *render_batch_init(void);
+
+/**
+ * Releases the memory allocated for the batch.
+ *
+ * @param batch a pointer to a batch returned from render_batch_init()
+ */
+void render_batch_free(render_batch_t *batch);
+
+/**
+ * Returns whether the batch found a renderer to draw with.
+ * If it did not, callers should fall back to sdl_wrapper's drawing functions.
+ *
+ * @param batch a pointer to a batch returned from render_batch_init()
+ * @return true if render_batch_flush() can draw
+ */
+bool render_batch_is_available(render_batch_t *batch);
+
+/**
+ * Starts a new batch viewed through a camera. The camera rectangle is
+ * scaled to fit the window, the same way sdl_render_scene_cam() does.
+ *
+ * @param batch a pointer to a batch returned from render_batch_init()
+ * @param cam_center the scene position at the center of the window
+ * @param cam_size the width and height of the scene area that is visible
+ */
+void render_batch_begin(render_batch_t *batch, vector_t cam_center,
+                        vector_t cam_size);
+
+/**
+ * Gets the scene rectangle that is visible in the window with the camera
+ * set by render_batch_begin(). It contains the camera rectangle and is
+ * wider or taller when the window's shape differs from the camera's.
+ *
+ * @param batch a pointer to a batch returned from render_batch_init()
+ * @param min set to the bottom left corner of the visible rectangle
+ * @param max set to the top right corner of the visible rectangle
+ */
+void render_batch_get_view(render_batch_t *batch, vector_t *min,
+                           vector_t *max);
+
+/**
+ * Adds a convex polygon, given in scene coordinates, to the batch.
+ *
+ * @param batch a pointer to a batch returned from render_batch_init()
+ * @param xs the x coordinates of the vertices, in order around the polygon
+ * @param ys the y coordinates of the vertices
+ * @param num_vertices the number of vertices
+ * @param color the fill color
+ * @param alpha the opacity, 255 for opaque
+ */
+void render_batch_add_polygon(render_batch_t *batch, const double *xs,
+                              const double *ys, size_t num_vertices,
+                              rgb_color_t color, Uint8 alpha);
+
+/**
+ * Draws everything added since render_batch_begin().
+ *
+ * @param batch a pointer to a batch returned from render_batch_init()
+ */
+void render_batch_flush(render_batch_t *batch);
+
+#endif // #ifndef __RENDER_BATCH_H__
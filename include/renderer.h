@@ -0,0 +1,13 @@
+#ifndef __RENDERER_H__
+#define __RENDERER_H__
+
+#include <SDL2/SDL.h>
+
+/**
+ * Gets the renderer of the game window opened by sdl_init().
+ *
+ * @return the window's renderer, or NULL if no window is open
+ */
+SDL_Renderer *renderer_get(void);
+
+#endif // #ifndef __RENDERER_H__
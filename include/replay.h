@@ -0,0 +1,119 @@
+#ifndef __REPLAY_H__
+#define __REPLAY_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "state.h"
+
+/**
+ * Records a match to an append-only file: the map, the seed and the input
+ * mask of every tick, plus a keyframe of the full match state every
+ * REPLAY_KEYFRAME_INTERVAL ticks. Repeated inputs are run-length encoded,
+ * so a match costs a few bytes per tick.
+ *
+ * The file is flushed at every keyframe, so a crashed match can still be
+ * replayed up to its last keyframe's worth of inputs.
+ */
+typedef struct replay_writer replay_writer_t;
+
+/**
+ * A recorded match loaded for playback. It owns a headless copy of the
+ * match which can be stepped forward or sought to any tick.
+ */
+typedef struct replay replay_t;
+
+/**
+ * Opens a replay file for recording.
+ *
+ * @param path the file to create, overwriting any existing file
+ * @param map the index of the map being played
+ * @param seed the seed the match was started with
+ * @return the new writer, or NULL if the file could not be opened
+ */
+replay_writer_t *replay_writer_init(const char *path, size_t map,
+                                    unsigned int seed);
+
+/**
+ * Finishes the file and releases the writer.
+ *
+ * @param writer a pointer to a writer returned from replay_writer_init()
+ */
+void replay_writer_free(replay_writer_t *writer);
+
+/**
+ * Records one tick. Call it at the start of every tick, before `input` is
+ * applied, so keyframes hold the state the tick starts from.
+ *
+ * @param writer a pointer to a writer returned from replay_writer_init()
+ * @param state the match being recorded
+ * @param input the input_t bits applied this tick, for both players
+ * @param dt the length of the tick, which must be the same for every tick
+ */
+void replay_writer_record(replay_writer_t *writer, state_t *state,
+                          uint32_t input, double dt);
+
+/**
+ * Loads a replay file and starts its match at tick 0. A file that ends
+ * partway through a record, e.g. after a crash, loads up to that record.
+ *
+ * @param path the file to read
+ * @return the loaded replay, or NULL if the file is missing or is not a
+ *   replay
+ */
+replay_t *replay_load(const char *path);
+
+/**
+ * Releases the replay and its match.
+ *
+ * @param replay a pointer to a replay returned from replay_load()
+ */
+void replay_free(replay_t *replay);
+
+/**
+ * Gets the number of ticks recorded.
+ *
+ * @param replay a pointer to a replay returned from replay_load()
+ * @return the number of ticks in the replay
+ */
+size_t replay_num_ticks(replay_t *replay);
+
+/**
+ * Gets the tick the replay's match is at, i.e. the number of recorded
+ * ticks it has simulated.
+ *
+ * @param replay a pointer to a replay returned from replay_load()
+ * @return the current tick
+ */
+size_t replay_get_tick(replay_t *replay);
+
+/**
+ * Gets the replay's match, e.g. to read its scores. It must not be ticked
+ * other than through the replay.
+ *
+ * @param replay a pointer to a replay returned from replay_load()
+ * @return the state of the match at replay_get_tick()
+ */
+state_t *replay_get_state(replay_t *replay);
+
+/**
+ * Simulates the next recorded tick.
+ *
+ * @param replay a pointer to a replay returned from replay_load()
+ * @return false if the replay has already reached its last tick
+ */
+bool replay_step(replay_t *replay);
+
+/**
+ * Moves the replay's match to a tick by restoring the nearest earlier
+ * keyframe and simulating forward from it.
+ *
+ * @param replay a pointer to a replay returned from replay_load()
+ * @param tick the tick to move to, at most replay_num_ticks()
+ * @return false, leaving the match where it was, if the tick is out of
+ *   range
+ */
+bool replay_seek(replay_t *replay, size_t tick);
+
+#endif // #ifndef __REPLAY_H__
@@ -0,0 +1,34 @@
+#ifndef __SAT_H__
+#define __SAT_H__
+
+#include <stddef.h>
+
+#include "collision.h"
+
+/**
+ * A read-only view of a convex polygon laid out for the separating axis test.
+ * Vertex coordinates and unit edge normals are stored in separate contiguous
+ * arrays so that projections onto an axis can run several vertices at a time.
+ * normal i is perpendicular to the edge from vertex i to vertex i + 1.
+ */
+typedef struct sat_polygon {
+  size_t num_vertices;
+  const double *xs;
+  const double *ys;
+  const double *normal_xs;
+  const double *normal_ys;
+} sat_polygon_t;
+
+/**
+ * Determines whether two convex polygons intersect, using the edge normals
+ * of both polygons as candidate separating axes. Allocates no memory.
+ *
+ * @param shape1 the first polygon
+ * @param shape2 the second polygon
+ * @return whether the polygons are colliding, and if so, the unit axis along
+ *   which they overlap the least
+ */
+collision_info_t sat_find_collision(const sat_polygon_t *shape1,
+                                    const sat_polygon_t *shape2);
+
+#endif // #ifndef __SAT_H__
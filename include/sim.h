@@ -0,0 +1,159 @@
+#ifndef __SIM_H__
+#define __SIM_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "snapshot.h"
+#include "state.h"
+
+/**
+ * Bits of the per-tick input mask, one for each game key.
+ */
+typedef enum input {
+  INPUT_P1_TURN = 1 << 0,
+  INPUT_P1_SHOOT = 1 << 1,
+  INPUT_P2_TURN = 1 << 2,
+  INPUT_P2_SHOOT = 1 << 3
+} input_t;
+
+/**
+ * Who controls player 2.
+ */
+typedef enum opponent {
+  OPPONENT_PLAYER, // a second person at the keyboard
+  OPPONENT_BOT, // the reactive bot in bot.c
+  OPPONENT_PLANNER // the lookahead planner in planner.c
+} opponent_t;
+
+/**
+ * Seconds spent in each phase of the simulation since it started.
+ */
+typedef struct sim_timings {
+  double input;
+  double collisions;
+  double scene;
+  double bot;
+} sim_timings_t;
+
+/**
+ * Gets the number of maps in assets/maps.
+ *
+ * @return the number of maps that can be passed to sim_init()
+ */
+size_t sim_num_maps(void);
+
+/**
+ * Starts a match without any rendering, audio or window.
+ *
+ * @param map the index of the map to play
+ * @param seed the seed for the random number generator
+ * @param opponent who controls player 2
+ * @return the state of the match
+ */
+state_t *sim_init(size_t map, unsigned int seed, opponent_t opponent);
+
+/**
+ * Advances the match by one tick.
+ *
+ * @param state the state returned from sim_init()
+ * @param dt the length of the tick in seconds
+ * @param input the keys held this tick, as a mask of input_t bits.
+ *   Player 2's bits are ignored unless player 2 is OPPONENT_PLAYER.
+ */
+void sim_tick(state_t *state, double dt, uint32_t input);
+
+/**
+ * Returns whether a player has reached the winning score.
+ *
+ * @param state the state returned from sim_init()
+ * @return true if the match is over
+ */
+bool sim_is_over(state_t *state);
+
+/**
+ * Gets the score of each player.
+ *
+ * @param state the state returned from sim_init()
+ * @param p1_score set to player 1's score
+ * @param p2_score set to player 2's score
+ */
+void sim_get_scores(state_t *state, size_t *p1_score, size_t *p2_score);
+
+/**
+ * Sets how many threads run the collision narrow-phase. The simulation
+ * gives the same results for any number of threads.
+ *
+ * @param state the state returned from sim_init()
+ * @param num_threads the number of threads, including the calling thread;
+ *   0 uses every available core. sim_init() starts with 1.
+ */
+void sim_set_threads(state_t *state, size_t num_threads);
+
+/**
+ * Gets the number of rollouts the planner has run. The planner runs a fixed
+ * number of rollouts per tick in the simulation, so matches are repeatable.
+ *
+ * @param state the state returned from sim_init()
+ * @return the number of rollouts, or 0 if the planner is not playing
+ */
+size_t sim_planner_rollouts(state_t *state);
+
+/**
+ * Gets the number of bodies in the scene.
+ *
+ * @param state the state returned from sim_init()
+ * @return the number of bodies
+ */
+size_t sim_bodies(state_t *state);
+
+/**
+ * Gets the time spent in each phase of the simulation so far.
+ *
+ * @param state the state returned from sim_init()
+ * @return the accumulated timings, which are all 0 unless game.c was
+ *   compiled with HEADLESS or PROFILE
+ */
+sim_timings_t sim_get_timings(state_t *state);
+
+/**
+ * Starts recording the match to a replay file (see replay.h), replacing any
+ * recording already in progress. Call it before the first tick.
+ *
+ * @param state the state returned from sim_init()
+ * @param path the file to write
+ * @return false if the file could not be opened
+ */
+bool sim_record(state_t *state, const char *path);
+
+/**
+ * Saves everything that changes during the match into a snapshot: bodies,
+ * scores, timers, held keys and the bullet pool. Takes microseconds, and
+ * snapshot_delta() between two snapshots of the same match is small.
+ * The planner's current plan is not included.
+ *
+ * @param state the state returned from sim_init()
+ * @param snapshot overwritten with the snapshot
+ */
+void sim_snapshot(state_t *state, snapshot_t *snapshot);
+
+/**
+ * Puts the match back into the state saved by sim_snapshot(). The snapshot
+ * must come from a match started with the same map and seed.
+ *
+ * @param state the state returned from sim_init()
+ * @param snapshot a snapshot from sim_snapshot()
+ * @return false, leaving the match unchanged, if the snapshot does not
+ *   belong to this match
+ */
+bool sim_restore(state_t *state, snapshot_t *snapshot);
+
+/**
+ * Releases the match.
+ *
+ * @param state the state returned from sim_init()
+ */
+void sim_free(state_t *state);
+
+#endif // #ifndef __SIM_H__
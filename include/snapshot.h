@@ -0,0 +1,114 @@
+#ifndef __SNAPSHOT_H__
+#define __SNAPSHOT_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * A growable, contiguous byte buffer holding serialized state. Every write
+ * is padded to a multiple of 8 bytes, so fields that did not change line up
+ * between two snapshots of the same layout and cancel out in a delta.
+ */
+typedef struct snapshot snapshot_t;
+
+/**
+ * Allocates an empty snapshot.
+ *
+ * @param initial_capacity the number of bytes to reserve up front
+ * @return a pointer to the newly allocated snapshot
+ */
+snapshot_t *snapshot_init(size_t initial_capacity);
+
+/**
+ * Releases the memory allocated for the snapshot.
+ *
+ * @param snapshot a pointer to a snapshot returned from snapshot_init()
+ */
+void snapshot_free(snapshot_t *snapshot);
+
+/**
+ * Empties the snapshot, keeping its memory for the next writes.
+ *
+ * @param snapshot a pointer to a snapshot returned from snapshot_init()
+ */
+void snapshot_clear(snapshot_t *snapshot);
+
+/**
+ * Gets the number of bytes in the snapshot.
+ *
+ * @param snapshot a pointer to a snapshot returned from snapshot_init()
+ * @return the size of the snapshot's data
+ */
+size_t snapshot_size(snapshot_t *snapshot);
+
+/**
+ * Gets the snapshot's data, e.g. for writing it to a file.
+ *
+ * @param snapshot a pointer to a snapshot returned from snapshot_init()
+ * @return the first snapshot_size() bytes of the snapshot, valid until the
+ *   next write
+ */
+const void *snapshot_data(snapshot_t *snapshot);
+
+/**
+ * Replaces the snapshot's contents with data from snapshot_data().
+ *
+ * @param snapshot a pointer to a snapshot returned from snapshot_init()
+ * @param data the data to copy
+ * @param size the number of bytes to copy, a multiple of 8
+ */
+void snapshot_load(snapshot_t *snapshot, const void *data, size_t size);
+
+/**
+ * Copies one snapshot into another.
+ *
+ * @param dest the snapshot to overwrite
+ * @param src the snapshot to copy
+ */
+void snapshot_copy(snapshot_t *dest, snapshot_t *src);
+
+/**
+ * Appends a field to the end of the snapshot.
+ *
+ * @param snapshot a pointer to a snapshot returned from snapshot_init()
+ * @param data the field to copy
+ * @param size the size of the field in bytes
+ */
+void snapshot_write(snapshot_t *snapshot, const void *data, size_t size);
+
+/**
+ * Reads a field written by snapshot_write(), in the order it was written.
+ *
+ * @param snapshot a pointer to a snapshot returned from snapshot_init()
+ * @param offset the offset of the field, advanced past it on success
+ * @param data where to copy the field
+ * @param size the size of the field in bytes
+ * @return false if the snapshot ends before the field does
+ */
+bool snapshot_read(snapshot_t *snapshot, size_t *offset, void *data,
+                   size_t size);
+
+/**
+ * Encodes the difference between two snapshots. Runs of unchanged 8-byte
+ * words are stored as a count, so a delta between two nearby ticks is
+ * mostly the handful of bodies that moved.
+ *
+ * @param base the older snapshot
+ * @param target the newer snapshot
+ * @param delta overwritten with the encoded difference
+ */
+void snapshot_delta(snapshot_t *base, snapshot_t *target, snapshot_t *delta);
+
+/**
+ * Rebuilds the target of a delta from its base.
+ *
+ * @param base the snapshot the delta was taken against
+ * @param delta a delta from snapshot_delta()
+ * @param target overwritten with the rebuilt snapshot; must not be `base`
+ * @return false if the delta is malformed or would rebuild a snapshot of
+ *   more than 128 MiB
+ */
+bool snapshot_apply_delta(snapshot_t *base, snapshot_t *delta,
+                          snapshot_t *target);
+
+#endif // #ifndef __SNAPSHOT_H__
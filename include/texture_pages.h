@@ -0,0 +1,95 @@
+#ifndef __TEXTURE_PAGES_H__
+#define __TEXTURE_PAGES_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <SDL2/SDL.h>
+
+/**
+ * Square textures ("pages") that small images are packed into, and a batch
+ * of textured quads drawn from them. Images go left to right in shelves as
+ * tall as the tallest image on the shelf, and a new page starts when a
+ * shelf would run off the bottom, so callers that add images tallest first
+ * waste the least space.
+ *
+ * Quads are drawn in the order they are added, with one
+ * SDL_RenderGeometry() call for each run of quads from the same page.
+ */
+typedef struct texture_pages texture_pages_t;
+
+/**
+ * Allocates a set of pages with no images that draws to a renderer.
+ *
+ * @param renderer the renderer to make textures for and draw to, or NULL
+ *   to keep no images and draw nothing
+ * @param page_size the width and height of each page in pixels, lowered to
+ *   the largest texture the renderer supports
+ * @param padding the number of transparent pixels kept between images, so
+ *   filtering never bleeds from one into the next
+ * @param initial_quads the number of quads the batch has room for before it
+ *   first grows
+ * @return a pointer to the newly allocated pages
+ */
+texture_pages_t *texture_pages_init(SDL_Renderer *renderer, int page_size,
+                                    int padding, size_t initial_quads);
+
+/**
+ * Releases the pages and their textures.
+ *
+ * @param pages a pointer to pages returned from texture_pages_init()
+ */
+void texture_pages_free(texture_pages_t *pages);
+
+/**
+ * Packs an image onto the newest page, or a new one, and uploads it.
+ *
+ * @param pages a pointer to pages returned from texture_pages_init()
+ * @param surface the image, in any pixel format; the caller keeps ownership
+ * @param page set to the page the image was packed onto
+ * @param rect set to where the image is on its page, in page pixels
+ * @return false if the image is empty, does not fit on a page, or could not
+ *   be uploaded
+ */
+bool texture_pages_add(texture_pages_t *pages, SDL_Surface *surface,
+                       size_t *page, SDL_Rect *rect);
+
+/**
+ * Gets the number of textures the images were packed into.
+ *
+ * @param pages a pointer to pages returned from texture_pages_init()
+ * @return the number of pages
+ */
+size_t texture_pages_count(texture_pages_t *pages);
+
+/**
+ * Starts a new batch of quads, dropping any that were not flushed.
+ *
+ * @param pages a pointer to pages returned from texture_pages_init()
+ */
+void texture_pages_begin(texture_pages_t *pages);
+
+/**
+ * Adds a quad showing part of a page to the batch. A quad from a different
+ * page than the one before it flushes the batch first.
+ *
+ * @param pages a pointer to pages returned from texture_pages_init()
+ * @param page the page to draw from
+ * @param rect the part of the page to draw, in page pixels
+ * @param x0 the left of the quad in window pixels
+ * @param y0 the top of the quad in window pixels
+ * @param x1 the right of the quad in window pixels
+ * @param y1 the bottom of the quad in window pixels
+ * @param color the color to multiply the image by
+ */
+void texture_pages_add_quad(texture_pages_t *pages, size_t page,
+                            SDL_Rect rect, float x0, float y0, float x1,
+                            float y1, SDL_Color color);
+
+/**
+ * Draws every quad added since texture_pages_begin() or the last flush.
+ *
+ * @param pages a pointer to pages returned from texture_pages_init()
+ */
+void texture_pages_flush(texture_pages_t *pages);
+
+#endif // #ifndef __TEXTURE_PAGES_H__
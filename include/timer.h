@@ -0,0 +1,12 @@
+#ifndef __TIMER_H__
+#define __TIMER_H__
+
+/**
+ * Reads a monotonic, high-resolution clock. Unlike clock(), which measures
+ * the CPU time of the process, this measures wall time and never goes back.
+ *
+ * @return the current time in seconds, from an arbitrary starting point
+ */
+double timer_now(void);
+
+#endif // #ifndef __TIMER_H__
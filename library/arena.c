@@ -0,0 +1,87 @@
+#include <assert.h>
+#include <stdalign.h>
+#include <stdlib.h>
+
+#include "arena.h"
+
+const size_t ARENA_ALIGNMENT = alignof(max_align_t);
+const size_t INITIAL_OVERFLOW_CAPACITY = 4;
+
+struct arena {
+  char *base;
+  size_t capacity;
+  size_t used;
+
+  // allocations that did not fit, released on the next reset
+  void **overflow;
+  size_t num_overflow;
+  size_t overflow_capacity;
+  size_t overflow_bytes;
+};
+
+arena_t *arena_init(size_t capacity) {
+  arena_t *arena = malloc(sizeof(arena_t));
+  assert(arena);
+  arena->capacity = capacity > 0 ? capacity : ARENA_ALIGNMENT;
+  arena->base = malloc(arena->capacity);
+  assert(arena->base);
+  arena->used = 0;
+  arena->overflow_capacity = INITIAL_OVERFLOW_CAPACITY;
+  arena->overflow = malloc(arena->overflow_capacity * sizeof(void *));
+  assert(arena->overflow);
+  arena->num_overflow = 0;
+  arena->overflow_bytes = 0;
+  return arena;
+}
+
+static void free_overflow(arena_t *arena) {
+  for (size_t i = 0; i < arena->num_overflow; i++) {
+    free(arena->overflow[i]);
+  }
+  arena->num_overflow = 0;
+}
+
+void arena_free(arena_t *arena) {
+  free_overflow(arena);
+  free(arena->overflow);
+  free(arena->base);
+  free(arena);
+}
+
+void *arena_alloc(arena_t *arena, size_t size) {
+  size = (size + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT * ARENA_ALIGNMENT;
+  if (arena->used + size <= arena->capacity) {
+    void *ptr = arena->base + arena->used;
+    arena->used += size;
+    return ptr;
+  }
+
+  if (arena->num_overflow == arena->overflow_capacity) {
+    arena->overflow_capacity *= 2;
+    arena->overflow =
+        realloc(arena->overflow, arena->overflow_capacity * sizeof(void *));
+    assert(arena->overflow);
+  }
+  void *ptr = malloc(size);
+  assert(ptr);
+  arena->overflow[arena->num_overflow++] = ptr;
+  arena->overflow_bytes += size;
+  return ptr;
+}
+
+void arena_reset(arena_t *arena) {
+  if (arena->num_overflow > 0) {
+    // grow to fit the whole high-water mark in a single block
+    free_overflow(arena);
+    size_t capacity = arena->capacity;
+    while (capacity < arena->used + arena->overflow_bytes) {
+      capacity *= 2;
+    }
+    free(arena->base);
+    arena->base = malloc(capacity);
+    assert(arena->base);
+    arena->capacity = capacity;
+    arena->overflow_bytes = 0;
+  }
+  arena->used = 0;
+}
@@ -0,0 +1,242 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "asset_table.h"
+
+const size_t INITIAL_TABLE_BUCKETS = 64;
+const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+const uint64_t FNV_PRIME = 1099511628211ULL;
+
+typedef struct entry {
+  char *path;
+  char *text;
+  SDL_Rect box;
+  rgb_color_t color;
+  uint64_t hash;
+
+  asset_t *asset;
+  size_t refs;
+
+  struct entry *key_next;   // chain in the key index
+  struct entry *asset_next; // chain in the asset pointer index
+  struct entry *lru_prev;   // idle list, least recently used first
+  struct entry *lru_next;
+} entry_t;
+
+struct asset_table {
+  entry_t **key_buckets;
+  entry_t **asset_buckets;
+  size_t num_buckets;
+
+  entry_t *lru_head;
+  entry_t *lru_tail;
+  size_t idle_budget;
+
+  size_t num_entries;
+  size_t num_idle;
+};
+
+static uint64_t hash_bytes(uint64_t hash, const void *data, size_t size) {
+  const unsigned char *bytes = data;
+  for (size_t i = 0; i < size; i++) {
+    hash = (hash ^ bytes[i]) * FNV_PRIME;
+  }
+  return hash;
+}
+
+static uint64_t hash_key(const char *path, const char *text, SDL_Rect box,
+                         rgb_color_t color) {
+  uint64_t hash = hash_bytes(FNV_OFFSET, path, strlen(path) + 1);
+  hash = hash_bytes(hash, text, strlen(text));
+  int box_fields[] = {box.x, box.y, box.w, box.h};
+  hash = hash_bytes(hash, box_fields, sizeof(box_fields));
+  float color_fields[] = {color.r, color.g, color.b};
+  return hash_bytes(hash, color_fields, sizeof(color_fields));
+}
+
+static size_t hash_pointer(const void *ptr, size_t num_buckets) {
+  uintptr_t bits = (uintptr_t)ptr;
+  return (size_t)((bits >> 4) * FNV_PRIME) & (num_buckets - 1);
+}
+
+static bool entry_matches(entry_t *entry, uint64_t hash, const char *path,
+                          const char *text, SDL_Rect box, rgb_color_t color) {
+  return entry->hash == hash && strcmp(entry->path, path) == 0 &&
+         strcmp(entry->text, text) == 0 &&
+         entry->box.x == box.x && entry->box.y == box.y &&
+         entry->box.w == box.w && entry->box.h == box.h &&
+         entry->color.r == color.r && entry->color.g == color.g &&
+         entry->color.b == color.b;
+}
+
+asset_table_t *asset_table_init(size_t idle_budget) {
+  asset_table_t *table = malloc(sizeof(asset_table_t));
+  assert(table);
+  table->num_buckets = INITIAL_TABLE_BUCKETS;
+  table->key_buckets = calloc(table->num_buckets, sizeof(entry_t *));
+  table->asset_buckets = calloc(table->num_buckets, sizeof(entry_t *));
+  assert(table->key_buckets && table->asset_buckets);
+  table->lru_head = NULL;
+  table->lru_tail = NULL;
+  table->idle_budget = idle_budget;
+  table->num_entries = 0;
+  table->num_idle = 0;
+  return table;
+}
+
+static void entry_free(entry_t *entry) {
+  asset_destroy(entry->asset);
+  free(entry->path);
+  free(entry->text);
+  free(entry);
+}
+
+void asset_table_free(asset_table_t *table) {
+  for (size_t i = 0; i < table->num_buckets; i++) {
+    entry_t *entry = table->key_buckets[i];
+    while (entry != NULL) {
+      entry_t *next = entry->key_next;
+      entry_free(entry);
+      entry = next;
+    }
+  }
+  free(table->key_buckets);
+  free(table->asset_buckets);
+  free(table);
+}
+
+static void lru_unlink(asset_table_t *table, entry_t *entry) {
+  if (entry->lru_prev != NULL) {
+    entry->lru_prev->lru_next = entry->lru_next;
+  } else {
+    table->lru_head = entry->lru_next;
+  }
+  if (entry->lru_next != NULL) {
+    entry->lru_next->lru_prev = entry->lru_prev;
+  } else {
+    table->lru_tail = entry->lru_prev;
+  }
+  entry->lru_prev = NULL;
+  entry->lru_next = NULL;
+  table->num_idle--;
+}
+
+static void lru_push(asset_table_t *table, entry_t *entry) {
+  entry->lru_prev = table->lru_tail;
+  entry->lru_next = NULL;
+  if (table->lru_tail != NULL) {
+    table->lru_tail->lru_next = entry;
+  } else {
+    table->lru_head = entry;
+  }
+  table->lru_tail = entry;
+  table->num_idle++;
+}
+
+static void index_remove(asset_table_t *table, entry_t *entry) {
+  entry_t **link = &table->key_buckets[entry->hash & (table->num_buckets - 1)];
+  while (*link != entry) {
+    link = &(*link)->key_next;
+  }
+  *link = entry->key_next;
+
+  link = &table->asset_buckets[hash_pointer(entry->asset, table->num_buckets)];
+  while (*link != entry) {
+    link = &(*link)->asset_next;
+  }
+  *link = entry->asset_next;
+}
+
+static void index_insert(asset_table_t *table, entry_t *entry) {
+  size_t key_bucket = entry->hash & (table->num_buckets - 1);
+  entry->key_next = table->key_buckets[key_bucket];
+  table->key_buckets[key_bucket] = entry;
+
+  size_t asset_bucket = hash_pointer(entry->asset, table->num_buckets);
+  entry->asset_next = table->asset_buckets[asset_bucket];
+  table->asset_buckets[asset_bucket] = entry;
+}
+
+static void grow(asset_table_t *table) {
+  entry_t **old_buckets = table->key_buckets;
+  size_t old_num_buckets = table->num_buckets;
+  table->num_buckets *= 2;
+  free(table->asset_buckets);
+  table->key_buckets = calloc(table->num_buckets, sizeof(entry_t *));
+  table->asset_buckets = calloc(table->num_buckets, sizeof(entry_t *));
+  assert(table->key_buckets && table->asset_buckets);
+  for (size_t i = 0; i < old_num_buckets; i++) {
+    entry_t *entry = old_buckets[i];
+    while (entry != NULL) {
+      entry_t *next = entry->key_next;
+      index_insert(table, entry);
+      entry = next;
+    }
+  }
+  free(old_buckets);
+}
+
+static void evict_idle(asset_table_t *table) {
+  while (table->num_idle > table->idle_budget) {
+    entry_t *victim = table->lru_head;
+    lru_unlink(table, victim);
+    index_remove(table, victim);
+    entry_free(victim);
+    table->num_entries--;
+  }
+}
+
+asset_t *asset_table_acquire_text(asset_table_t *table, const char *filepath,
+                                  SDL_Rect bounding_box, const char *text,
+                                  rgb_color_t color) {
+  uint64_t hash = hash_key(filepath, text, bounding_box, color);
+  entry_t *entry = table->key_buckets[hash & (table->num_buckets - 1)];
+  while (entry != NULL &&
+         !entry_matches(entry, hash, filepath, text, bounding_box, color)) {
+    entry = entry->key_next;
+  }
+
+  if (entry != NULL) {
+    if (entry->refs++ == 0) {
+      lru_unlink(table, entry);
+    }
+    return entry->asset;
+  }
+
+  entry = malloc(sizeof(entry_t));
+  assert(entry);
+  entry->path = strdup(filepath);
+  entry->text = strdup(text);
+  assert(entry->path && entry->text);
+  entry->box = bounding_box;
+  entry->color = color;
+  entry->hash = hash;
+  entry->asset =
+      asset_make_text(entry->path, bounding_box, entry->text, color);
+  entry->refs = 1;
+  entry->lru_prev = NULL;
+  entry->lru_next = NULL;
+
+  if (table->num_entries + 1 > table->num_buckets * 3 / 4) {
+    grow(table);
+  }
+  index_insert(table, entry);
+  table->num_entries++;
+  return entry->asset;
+}
+
+void asset_table_release(asset_table_t *table, asset_t *asset) {
+  entry_t *entry =
+      table->asset_buckets[hash_pointer(asset, table->num_buckets)];
+  while (entry != NULL && entry->asset != asset) {
+    entry = entry->asset_next;
+  }
+  assert(entry != NULL && entry->refs > 0);
+  if (--entry->refs == 0) {
+    lru_push(table, entry);
+    evict_idle(table);
+  }
+}
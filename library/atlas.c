@@ -0,0 +1,157 @@
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "atlas.h"
+#include "renderer.h"
+#include "texture_pages.h"
+
+// 4096 is supported by WebGL everywhere; smaller renderers lower it
+const int MAX_PAGE_SIZE = 4096;
+const int IMAGE_PADDING = 1;
+const size_t INITIAL_BATCH_QUADS = 64;
+
+typedef struct atlas_image {
+  char *path;
+  bool packed;
+  size_t page;
+  SDL_Rect rect; // in page pixels
+} atlas_image_t;
+
+struct atlas {
+  SDL_Renderer *renderer;
+  texture_pages_t *pages;
+  atlas_image_t *images;
+  size_t num_images;
+  vector_t window_center;
+};
+
+typedef struct new_image {
+  const char *path;
+  SDL_Surface *surface;
+} new_image_t;
+
+/**
+ * Orders images tallest first, so each shelf is as tall as its first image.
+ */
+static int compare_heights(const void *a, const void *b) {
+  const new_image_t *first = a;
+  const new_image_t *second = b;
+  return second->surface->h - first->surface->h;
+}
+
+atlas_t *atlas_init(void) {
+  atlas_t *atlas = malloc(sizeof(atlas_t));
+  assert(atlas);
+  atlas->renderer = renderer_get();
+  atlas->pages = texture_pages_init(atlas->renderer, MAX_PAGE_SIZE,
+                                    IMAGE_PADDING, INITIAL_BATCH_QUADS);
+  atlas->images = NULL;
+  atlas->num_images = 0;
+  atlas->window_center = VEC_ZERO;
+  return atlas;
+}
+
+/**
+ * Finds an image by path, whether or not it was packed.
+ */
+static atlas_image_t *find_image(atlas_t *atlas, const char *path) {
+  for (size_t i = 0; i < atlas->num_images; i++) {
+    if (strcmp(atlas->images[i].path, path) == 0) {
+      return &atlas->images[i];
+    }
+  }
+  return NULL;
+}
+
+void atlas_add_images(atlas_t *atlas, const char **paths,
+                      SDL_Surface **surfaces, size_t num_images) {
+  new_image_t *order = malloc(num_images * sizeof(new_image_t));
+  assert(num_images == 0 || order);
+  atlas->images = realloc(atlas->images, (atlas->num_images + num_images) *
+                                             sizeof(atlas_image_t));
+  assert(atlas->num_images + num_images == 0 || atlas->images);
+
+  size_t num_new = 0;
+  for (size_t i = 0; i < num_images; i++) {
+    if (find_image(atlas, paths[i]) != NULL) {
+      continue;
+    }
+    atlas_image_t *image = &atlas->images[atlas->num_images++];
+    image->path = strdup(paths[i]);
+    assert(image->path);
+    image->packed = false;
+    if (atlas->renderer != NULL && surfaces[i] != NULL) {
+      order[num_new++] = (new_image_t){image->path, surfaces[i]};
+    }
+  }
+  qsort(order, num_new, sizeof(new_image_t), compare_heights);
+
+  for (size_t i = 0; i < num_new; i++) {
+    atlas_image_t *image = find_image(atlas, order[i].path);
+    image->packed = texture_pages_add(atlas->pages, order[i].surface,
+                                      &image->page, &image->rect);
+  }
+  free(order);
+}
+
+void atlas_free(atlas_t *atlas) {
+  for (size_t i = 0; i < atlas->num_images; i++) {
+    free(atlas->images[i].path);
+  }
+  texture_pages_free(atlas->pages);
+  free(atlas->images);
+  free(atlas);
+}
+
+bool atlas_find(atlas_t *atlas, const char *path, size_t *index) {
+  atlas_image_t *image = atlas != NULL ? find_image(atlas, path) : NULL;
+  if (image == NULL || !image->packed) {
+    return false;
+  }
+  *index = image - atlas->images;
+  return true;
+}
+
+size_t atlas_num_pages(atlas_t *atlas) {
+  return texture_pages_count(atlas->pages);
+}
+
+void atlas_begin(atlas_t *atlas) {
+  int width = 0;
+  int height = 0;
+  if (atlas->renderer != NULL) {
+    SDL_GetRendererOutputSize(atlas->renderer, &width, &height);
+  }
+  atlas->window_center = (vector_t){width / 2.0, height / 2.0};
+  texture_pages_begin(atlas->pages);
+}
+
+/**
+ * Adds a quad covering [x0, x1] x [y0, y1] in window pixels.
+ */
+static void add_quad(atlas_t *atlas, size_t index, double x0, double y0,
+                     double x1, double y1) {
+  assert(index < atlas->num_images && atlas->images[index].packed);
+  atlas_image_t *image = &atlas->images[index];
+  SDL_Color white = {255, 255, 255, 255};
+  texture_pages_add_quad(atlas->pages, image->page, image->rect, x0, y0, x1,
+                         y1, white);
+}
+
+void atlas_add_image(atlas_t *atlas, size_t index, SDL_Rect box) {
+  add_quad(atlas, index, box.x, box.y, box.x + box.w, box.y + box.h);
+}
+
+void atlas_add_image_cam(atlas_t *atlas, size_t index, SDL_Rect box,
+                         vector_t cam_center, vector_t cam_size) {
+  double x_scale = atlas->window_center.x / (cam_size.x / 2);
+  double y_scale = atlas->window_center.y / (cam_size.y / 2);
+  double scale = fmin(x_scale, y_scale);
+  double x0 = atlas->window_center.x + scale * (box.x - cam_center.x);
+  double y0 = atlas->window_center.y + scale * (box.y - cam_center.y);
+  add_quad(atlas, index, x0, y0, x0 + scale * box.w, y0 + scale * box.h);
+}
+
+void atlas_flush(atlas_t *atlas) { texture_pages_flush(atlas->pages); }
@@ -0,0 +1,206 @@
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include "broadphase.h"
+
+const size_t INITIAL_BOX_CAPACITY = 64;
+
+typedef struct box {
+  vector_t min;
+  vector_t max;
+  size_t id;
+  bool is_static;
+  uint32_t category;
+  uint32_t mask;
+} box_t;
+
+struct broadphase {
+  vector_t min;
+  double cell_size;
+  size_t cols;
+  size_t rows;
+
+  box_t *boxes;
+  size_t num_boxes;
+  size_t box_capacity;
+
+  // boxes in cell c are cell_entries[cell_starts[c] .. cell_starts[c + 1])
+  size_t *cell_starts;
+  size_t *cell_cursors;
+  size_t *cell_entries;
+  size_t entry_capacity;
+
+  broadphase_pair_t *pairs;
+  size_t pair_capacity;
+};
+
+/**
+ * Grows `buf` so it holds at least `needed` elements of size `elem_size`.
+ */
+static void *ensure_capacity(void *buf, size_t *capacity, size_t needed,
+                             size_t elem_size) {
+  if (needed <= *capacity) {
+    return buf;
+  }
+  size_t new_capacity = *capacity > 0 ? *capacity : INITIAL_BOX_CAPACITY;
+  while (new_capacity < needed) {
+    new_capacity *= 2;
+  }
+  buf = realloc(buf, new_capacity * elem_size);
+  assert(buf);
+  *capacity = new_capacity;
+  return buf;
+}
+
+static size_t cell_coord(double v, double origin, double cell_size,
+                         size_t n) {
+  double c = floor((v - origin) / cell_size);
+  if (c < 0) {
+    return 0;
+  }
+  if (c >= n) {
+    return n - 1;
+  }
+  return (size_t)c;
+}
+
+broadphase_t *broadphase_init(vector_t min, vector_t max, double cell_size) {
+  assert(cell_size > 0);
+  broadphase_t *bp = malloc(sizeof(broadphase_t));
+  assert(bp);
+  bp->min = min;
+  bp->cell_size = cell_size;
+  bp->cols = (size_t)fmax(1, ceil((max.x - min.x) / cell_size));
+  bp->rows = (size_t)fmax(1, ceil((max.y - min.y) / cell_size));
+
+  size_t n_cells = bp->cols * bp->rows;
+  bp->cell_starts = malloc((n_cells + 1) * sizeof(size_t));
+  bp->cell_cursors = malloc(n_cells * sizeof(size_t));
+  assert(bp->cell_starts && bp->cell_cursors);
+
+  bp->boxes = NULL;
+  bp->num_boxes = 0;
+  bp->box_capacity = 0;
+  bp->cell_entries = NULL;
+  bp->entry_capacity = 0;
+  bp->pairs = NULL;
+  bp->pair_capacity = 0;
+  return bp;
+}
+
+void broadphase_free(broadphase_t *bp) {
+  free(bp->boxes);
+  free(bp->cell_starts);
+  free(bp->cell_cursors);
+  free(bp->cell_entries);
+  free(bp->pairs);
+  free(bp);
+}
+
+void broadphase_clear(broadphase_t *bp) { bp->num_boxes = 0; }
+
+void broadphase_add(broadphase_t *bp, size_t id, vector_t min, vector_t max,
+                    bool is_static, uint32_t category, uint32_t mask) {
+  bp->boxes = ensure_capacity(bp->boxes, &bp->box_capacity, bp->num_boxes + 1,
+                              sizeof(box_t));
+  bp->boxes[bp->num_boxes++] = (box_t){.min = min,
+                                       .max = max,
+                                       .id = id,
+                                       .is_static = is_static,
+                                       .category = category,
+                                       .mask = mask};
+}
+
+static void box_cells(broadphase_t *bp, box_t *box, size_t *x0, size_t *y0,
+                      size_t *x1, size_t *y1) {
+  *x0 = cell_coord(box->min.x, bp->min.x, bp->cell_size, bp->cols);
+  *y0 = cell_coord(box->min.y, bp->min.y, bp->cell_size, bp->rows);
+  *x1 = cell_coord(box->max.x, bp->min.x, bp->cell_size, bp->cols);
+  *y1 = cell_coord(box->max.y, bp->min.y, bp->cell_size, bp->rows);
+}
+
+/**
+ * Buckets every box into each cell its bounds touch with a counting sort,
+ * so the grid needs no per-cell allocations.
+ */
+static void fill_cells(broadphase_t *bp) {
+  size_t n_cells = bp->cols * bp->rows;
+  for (size_t c = 0; c <= n_cells; c++) {
+    bp->cell_starts[c] = 0;
+  }
+
+  size_t n_entries = 0;
+  for (size_t i = 0; i < bp->num_boxes; i++) {
+    size_t x0, y0, x1, y1;
+    box_cells(bp, &bp->boxes[i], &x0, &y0, &x1, &y1);
+    for (size_t y = y0; y <= y1; y++) {
+      for (size_t x = x0; x <= x1; x++) {
+        bp->cell_starts[y * bp->cols + x + 1]++;
+        n_entries++;
+      }
+    }
+  }
+  for (size_t c = 0; c < n_cells; c++) {
+    bp->cell_starts[c + 1] += bp->cell_starts[c];
+    bp->cell_cursors[c] = bp->cell_starts[c];
+  }
+
+  bp->cell_entries = ensure_capacity(bp->cell_entries, &bp->entry_capacity,
+                                     n_entries, sizeof(size_t));
+  for (size_t i = 0; i < bp->num_boxes; i++) {
+    size_t x0, y0, x1, y1;
+    box_cells(bp, &bp->boxes[i], &x0, &y0, &x1, &y1);
+    for (size_t y = y0; y <= y1; y++) {
+      for (size_t x = x0; x <= x1; x++) {
+        bp->cell_entries[bp->cell_cursors[y * bp->cols + x]++] = i;
+      }
+    }
+  }
+}
+
+static bool boxes_interact(box_t *a, box_t *b) {
+  return !(a->is_static && b->is_static) && (a->category & b->mask) != 0 &&
+         (b->category & a->mask) != 0;
+}
+
+static bool boxes_overlap(box_t *a, box_t *b) {
+  return a->min.x <= b->max.x && b->min.x <= a->max.x &&
+         a->min.y <= b->max.y && b->min.y <= a->max.y;
+}
+
+size_t broadphase_pairs(broadphase_t *bp, broadphase_pair_t **pairs) {
+  fill_cells(bp);
+
+  size_t n_pairs = 0;
+  size_t n_cells = bp->cols * bp->rows;
+  for (size_t c = 0; c < n_cells; c++) {
+    size_t start = bp->cell_starts[c];
+    size_t end = bp->cell_starts[c + 1];
+    for (size_t i = start; i < end; i++) {
+      box_t *a = &bp->boxes[bp->cell_entries[i]];
+      for (size_t j = i + 1; j < end; j++) {
+        box_t *b = &bp->boxes[bp->cell_entries[j]];
+        if (!boxes_interact(a, b) || !boxes_overlap(a, b)) {
+          continue;
+        }
+        // A pair sharing several cells is only reported from the cell that
+        // holds the corner of their intersection.
+        size_t x = cell_coord(fmax(a->min.x, b->min.x), bp->min.x,
+                              bp->cell_size, bp->cols);
+        size_t y = cell_coord(fmax(a->min.y, b->min.y), bp->min.y,
+                              bp->cell_size, bp->rows);
+        if (y * bp->cols + x != c) {
+          continue;
+        }
+        bp->pairs = ensure_capacity(bp->pairs, &bp->pair_capacity,
+                                    n_pairs + 1, sizeof(broadphase_pair_t));
+        bp->pairs[n_pairs++] =
+            (broadphase_pair_t){.first = a->id, .second = b->id};
+      }
+    }
+  }
+
+  *pairs = bp->pairs;
+  return n_pairs;
+}
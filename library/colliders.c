@@ -0,0 +1,499 @@
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include "colliders.h"
+
+// doubles stored per vertex: local x, y, normal x, normal y, and the same
+// four in world space
+const size_t DOUBLES_PER_VERTEX = 8;
+const size_t INITIAL_POOL_VERTICES = 256;
+
+struct colliders {
+  size_t size;
+  size_t capacity;
+
+  body_t **bodies;
+  bool *is_static;
+  bool *is_active;
+  uint32_t *categories;
+  uint32_t *masks;
+  double *radius;
+  // the bounding box relative to the centroid: the exact box of the shape
+  // for static bodies, which never turn, and the box around the bounding
+  // circle for the rest, so it holds at any rotation
+  double *extent_min_x;
+  double *extent_min_y;
+  double *extent_max_x;
+  double *extent_max_y;
+
+  // shapes relative to the centroid at the rotation each body was added
+  // with. All shapes share one pool; body i owns the block starting at
+  // shape_offsets[i], laid out as eight arrays of num_vertices[i] doubles.
+  size_t *num_vertices;
+  size_t *shape_offsets;
+  double *rotation0;
+  double *shape_pool;
+  size_t pool_size;
+  size_t pool_capacity;
+
+  // centroids and bounds cached by colliders_update()
+  double *x;
+  double *y;
+  double *min_x;
+  double *min_y;
+  double *max_x;
+  double *max_y;
+
+  // transforms as of the last colliders_save_transforms(), used to
+  // interpolate between ticks when rendering
+  double *prev_x;
+  double *prev_y;
+  double *prev_rotation;
+
+  // the transform the world space block was last written for. The block is
+  // only rewritten when asked for a different one, so bodies at rest cost
+  // no transforms.
+  bool *is_placed; // false until the block is first written
+  double *placed_x;
+  double *placed_y;
+  double *placed_rotation;
+
+  // where colliders_get_interpolated_shape() writes shapes between ticks,
+  // so rendering never overwrites the tick's world space blocks
+  double *render_shape;
+  size_t render_capacity; // in vertices
+};
+
+static void *resize(void *buf, size_t count, size_t elem_size) {
+  buf = realloc(buf, count * elem_size);
+  assert(buf);
+  return buf;
+}
+
+static void colliders_reserve(colliders_t *colliders, size_t capacity) {
+  colliders->bodies = resize(colliders->bodies, capacity, sizeof(body_t *));
+  colliders->is_static = resize(colliders->is_static, capacity, sizeof(bool));
+  colliders->is_active = resize(colliders->is_active, capacity, sizeof(bool));
+  colliders->categories =
+      resize(colliders->categories, capacity, sizeof(uint32_t));
+  colliders->masks = resize(colliders->masks, capacity, sizeof(uint32_t));
+  colliders->radius = resize(colliders->radius, capacity, sizeof(double));
+  colliders->extent_min_x =
+      resize(colliders->extent_min_x, capacity, sizeof(double));
+  colliders->extent_min_y =
+      resize(colliders->extent_min_y, capacity, sizeof(double));
+  colliders->extent_max_x =
+      resize(colliders->extent_max_x, capacity, sizeof(double));
+  colliders->extent_max_y =
+      resize(colliders->extent_max_y, capacity, sizeof(double));
+  colliders->num_vertices =
+      resize(colliders->num_vertices, capacity, sizeof(size_t));
+  colliders->shape_offsets =
+      resize(colliders->shape_offsets, capacity, sizeof(size_t));
+  colliders->rotation0 = resize(colliders->rotation0, capacity, sizeof(double));
+  colliders->x = resize(colliders->x, capacity, sizeof(double));
+  colliders->y = resize(colliders->y, capacity, sizeof(double));
+  colliders->min_x = resize(colliders->min_x, capacity, sizeof(double));
+  colliders->min_y = resize(colliders->min_y, capacity, sizeof(double));
+  colliders->max_x = resize(colliders->max_x, capacity, sizeof(double));
+  colliders->max_y = resize(colliders->max_y, capacity, sizeof(double));
+  colliders->prev_x = resize(colliders->prev_x, capacity, sizeof(double));
+  colliders->prev_y = resize(colliders->prev_y, capacity, sizeof(double));
+  colliders->prev_rotation =
+      resize(colliders->prev_rotation, capacity, sizeof(double));
+  colliders->is_placed = resize(colliders->is_placed, capacity, sizeof(bool));
+  colliders->placed_x = resize(colliders->placed_x, capacity, sizeof(double));
+  colliders->placed_y = resize(colliders->placed_y, capacity, sizeof(double));
+  colliders->placed_rotation =
+      resize(colliders->placed_rotation, capacity, sizeof(double));
+  colliders->capacity = capacity;
+}
+
+colliders_t *colliders_init(size_t initial_capacity) {
+  colliders_t *colliders = calloc(1, sizeof(colliders_t));
+  assert(colliders);
+  colliders_reserve(colliders, initial_capacity > 0 ? initial_capacity : 1);
+  colliders->pool_capacity = INITIAL_POOL_VERTICES * DOUBLES_PER_VERTEX;
+  colliders->shape_pool =
+      resize(NULL, colliders->pool_capacity, sizeof(double));
+  return colliders;
+}
+
+void colliders_free(colliders_t *colliders) {
+  free(colliders->shape_pool);
+  free(colliders->render_shape);
+  free(colliders->num_vertices);
+  free(colliders->shape_offsets);
+  free(colliders->rotation0);
+  free(colliders->bodies);
+  free(colliders->is_static);
+  free(colliders->is_active);
+  free(colliders->categories);
+  free(colliders->masks);
+  free(colliders->radius);
+  free(colliders->extent_min_x);
+  free(colliders->extent_min_y);
+  free(colliders->extent_max_x);
+  free(colliders->extent_max_y);
+  free(colliders->x);
+  free(colliders->y);
+  free(colliders->min_x);
+  free(colliders->min_y);
+  free(colliders->max_x);
+  free(colliders->max_y);
+  free(colliders->prev_x);
+  free(colliders->prev_y);
+  free(colliders->prev_rotation);
+  free(colliders->is_placed);
+  free(colliders->placed_x);
+  free(colliders->placed_y);
+  free(colliders->placed_rotation);
+  free(colliders);
+}
+
+size_t colliders_size(colliders_t *colliders) { return colliders->size; }
+
+/**
+ * Copies the vertices of `shape`, relative to `centroid`, into xs and ys,
+ * dropping each vertex equal to the one kept before it: the edge between
+ * them has no length and so no normal. Only counts if xs is NULL.
+ *
+ * @return the number of vertices kept
+ */
+static size_t copy_vertices(list_t *shape, vector_t centroid, double *xs,
+                            double *ys) {
+  size_t num_points = list_size(shape);
+  size_t n = 0;
+  vector_t first = VEC_ZERO;
+  vector_t last = VEC_ZERO;
+  for (size_t i = 0; i < num_points; i++) {
+    vector_t point = *(vector_t *)list_get(shape, i);
+    if (n > 0 && point.x == last.x && point.y == last.y) {
+      continue;
+    }
+    if (n == 0) {
+      first = point;
+    }
+    if (xs != NULL) {
+      xs[n] = point.x - centroid.x;
+      ys[n] = point.y - centroid.y;
+    }
+    last = point;
+    n++;
+  }
+  // the closing edge runs from the last vertex back to the first
+  if (n > 1 && last.x == first.x && last.y == first.y) {
+    n--;
+  }
+  return n;
+}
+
+size_t colliders_add(colliders_t *colliders, body_t *body, uint32_t category,
+                     uint32_t mask) {
+  if (colliders->size == colliders->capacity) {
+    colliders_reserve(colliders, colliders->capacity * 2);
+  }
+
+  vector_t centroid = body_get_centroid(body);
+  list_t *shape = body_get_shape(body);
+  size_t n = copy_vertices(shape, centroid, NULL, NULL);
+  size_t block_size = n * DOUBLES_PER_VERTEX;
+  size_t offset = colliders->pool_size;
+  if (offset + block_size > colliders->pool_capacity) {
+    while (offset + block_size > colliders->pool_capacity) {
+      colliders->pool_capacity *= 2;
+    }
+    colliders->shape_pool = resize(colliders->shape_pool,
+                                   colliders->pool_capacity, sizeof(double));
+  }
+  colliders->pool_size += block_size;
+  double *block = colliders->shape_pool + offset;
+  double *xs = block;
+  double *ys = block + n;
+  double *normal_xs = block + 2 * n;
+  double *normal_ys = block + 3 * n;
+  copy_vertices(shape, centroid, xs, ys);
+  list_free(shape);
+
+  double radius = 0;
+  vector_t min = VEC_ZERO;
+  vector_t max = VEC_ZERO;
+  for (size_t i = 0; i < n; i++) {
+    vector_t vertex = {xs[i], ys[i]};
+    radius = fmax(radius, vec_get_length(vertex));
+    min = (vector_t){fmin(min.x, vertex.x), fmin(min.y, vertex.y)};
+    max = (vector_t){fmax(max.x, vertex.x), fmax(max.y, vertex.y)};
+  }
+  for (size_t i = 0; i < n; i++) {
+    size_t next = (i + 1) % n;
+    vector_t normal = {-(ys[next] - ys[i]), xs[next] - xs[i]};
+    double length = vec_get_length(normal);
+    normal = length > 0 ? vec_multiply(1 / length, normal) : VEC_ZERO;
+    normal_xs[i] = normal.x;
+    normal_ys[i] = normal.y;
+  }
+
+  size_t index = colliders->size++;
+  colliders->num_vertices[index] = n;
+  colliders->shape_offsets[index] = offset;
+  colliders->rotation0[index] = body_get_rotation(body);
+  colliders->bodies[index] = body;
+  bool is_static = body_get_mass(body) == INFINITY;
+  colliders->is_static[index] = is_static;
+  colliders->is_active[index] = true;
+  colliders->categories[index] = category;
+  colliders->masks[index] = mask;
+  colliders->radius[index] = radius;
+  if (!is_static) {
+    min = (vector_t){-radius, -radius};
+    max = (vector_t){radius, radius};
+  }
+  colliders->extent_min_x[index] = min.x;
+  colliders->extent_min_y[index] = min.y;
+  colliders->extent_max_x[index] = max.x;
+  colliders->extent_max_y[index] = max.y;
+  colliders->x[index] = centroid.x;
+  colliders->y[index] = centroid.y;
+  colliders->min_x[index] = centroid.x + min.x;
+  colliders->min_y[index] = centroid.y + min.y;
+  colliders->max_x[index] = centroid.x + max.x;
+  colliders->max_y[index] = centroid.y + max.y;
+  colliders->prev_x[index] = centroid.x;
+  colliders->prev_y[index] = centroid.y;
+  colliders->prev_rotation[index] = colliders->rotation0[index];
+  colliders->is_placed[index] = false;
+  return index;
+}
+
+body_t *colliders_get_body(colliders_t *colliders, size_t index) {
+  assert(index < colliders->size);
+  return colliders->bodies[index];
+}
+
+/**
+ * Writes the shape of body `index` placed at `centroid` and `rotation` into
+ * `out`, as four arrays of xs, ys, normal xs and normal ys.
+ */
+static sat_polygon_t transform_shape(colliders_t *colliders, size_t index,
+                                     vector_t centroid, double rotation,
+                                     double *out) {
+  double angle = rotation - colliders->rotation0[index];
+  double c = cos(angle);
+  double s = sin(angle);
+
+  size_t n = colliders->num_vertices[index];
+  const double *block = colliders->shape_pool + colliders->shape_offsets[index];
+  const double *restrict xs = block;
+  const double *restrict ys = block + n;
+  const double *restrict normal_xs = block + 2 * n;
+  const double *restrict normal_ys = block + 3 * n;
+  double *restrict world_xs = out;
+  double *restrict world_ys = out + n;
+  double *restrict world_normal_xs = out + 2 * n;
+  double *restrict world_normal_ys = out + 3 * n;
+  for (size_t i = 0; i < n; i++) {
+    world_xs[i] = centroid.x + c * xs[i] - s * ys[i];
+    world_ys[i] = centroid.y + s * xs[i] + c * ys[i];
+    world_normal_xs[i] = c * normal_xs[i] - s * normal_ys[i];
+    world_normal_ys[i] = s * normal_xs[i] + c * normal_ys[i];
+  }
+
+  return (sat_polygon_t){.num_vertices = n,
+                         .xs = world_xs,
+                         .ys = world_ys,
+                         .normal_xs = world_normal_xs,
+                         .normal_ys = world_normal_ys};
+}
+
+/**
+ * Writes the shape of body `index` placed at `centroid` and `rotation` into
+ * its world space block of the shape pool, unless the block already holds
+ * that placement.
+ */
+static sat_polygon_t place_shape(colliders_t *colliders, size_t index,
+                                 vector_t centroid, double rotation) {
+  if (colliders->is_placed[index] && colliders->placed_x[index] == centroid.x &&
+      colliders->placed_y[index] == centroid.y &&
+      colliders->placed_rotation[index] == rotation) {
+    return colliders_get_world_shape(colliders, index);
+  }
+  colliders->is_placed[index] = true;
+  colliders->placed_x[index] = centroid.x;
+  colliders->placed_y[index] = centroid.y;
+  colliders->placed_rotation[index] = rotation;
+
+  size_t n = colliders->num_vertices[index];
+  double *block = colliders->shape_pool + colliders->shape_offsets[index];
+  return transform_shape(colliders, index, centroid, rotation, block + 4 * n);
+}
+
+sat_polygon_t colliders_get_shape(colliders_t *colliders, size_t index) {
+  assert(index < colliders->size);
+  body_t *body = colliders->bodies[index];
+  return place_shape(colliders, index, body_get_centroid(body),
+                     body_get_rotation(body));
+}
+
+void colliders_transform_shapes(colliders_t *colliders, size_t start,
+                                size_t end) {
+  assert(start <= end && end <= colliders->size);
+  for (size_t i = start; i < end; i++) {
+    colliders_get_shape(colliders, i);
+  }
+}
+
+sat_polygon_t colliders_get_world_shape(colliders_t *colliders,
+                                        size_t index) {
+  assert(index < colliders->size);
+  size_t n = colliders->num_vertices[index];
+  double *block = colliders->shape_pool + colliders->shape_offsets[index];
+  return (sat_polygon_t){.num_vertices = n,
+                         .xs = block + 4 * n,
+                         .ys = block + 5 * n,
+                         .normal_xs = block + 6 * n,
+                         .normal_ys = block + 7 * n};
+}
+
+void colliders_save_transforms(colliders_t *colliders) {
+  for (size_t i = 0; i < colliders->size; i++) {
+    body_t *body = colliders->bodies[i];
+    vector_t centroid = body_get_centroid(body);
+    colliders->prev_x[i] = centroid.x;
+    colliders->prev_y[i] = centroid.y;
+    colliders->prev_rotation[i] = body_get_rotation(body);
+  }
+}
+
+vector_t colliders_get_interpolated_centroid(colliders_t *colliders,
+                                             size_t index, double alpha) {
+  assert(index < colliders->size);
+  vector_t prev = {colliders->prev_x[index], colliders->prev_y[index]};
+  vector_t current = body_get_centroid(colliders->bodies[index]);
+  return vec_add(prev, vec_multiply(alpha, vec_subtract(current, prev)));
+}
+
+sat_polygon_t colliders_get_interpolated_shape(colliders_t *colliders,
+                                               size_t index, double alpha) {
+  assert(index < colliders->size);
+  body_t *body = colliders->bodies[index];
+  vector_t centroid =
+      colliders_get_interpolated_centroid(colliders, index, alpha);
+  double prev_rotation = colliders->prev_rotation[index];
+  double current_rotation = body_get_rotation(body);
+  double rotation =
+      prev_rotation + alpha * (current_rotation - prev_rotation);
+  // bodies that did not move last tick are where the tick left them
+  vector_t current = body_get_centroid(body);
+  if (centroid.x == current.x && centroid.y == current.y &&
+      rotation == current_rotation) {
+    return place_shape(colliders, index, centroid, rotation);
+  }
+
+  size_t n = colliders->num_vertices[index];
+  if (n > colliders->render_capacity) {
+    colliders->render_shape =
+        resize(colliders->render_shape, 4 * n, sizeof(double));
+    colliders->render_capacity = n;
+  }
+  return transform_shape(colliders, index, centroid, rotation,
+                         colliders->render_shape);
+}
+
+void colliders_update(colliders_t *colliders) {
+  size_t n = colliders->size;
+  for (size_t i = 0; i < n; i++) {
+    vector_t centroid = body_get_centroid(colliders->bodies[i]);
+    colliders->x[i] = centroid.x;
+    colliders->y[i] = centroid.y;
+  }
+
+  // no body access here, so this loop vectorizes
+  const double *restrict x = colliders->x;
+  const double *restrict y = colliders->y;
+  const double *restrict extent_min_x = colliders->extent_min_x;
+  const double *restrict extent_min_y = colliders->extent_min_y;
+  const double *restrict extent_max_x = colliders->extent_max_x;
+  const double *restrict extent_max_y = colliders->extent_max_y;
+  double *restrict min_x = colliders->min_x;
+  double *restrict min_y = colliders->min_y;
+  double *restrict max_x = colliders->max_x;
+  double *restrict max_y = colliders->max_y;
+  for (size_t i = 0; i < n; i++) {
+    min_x[i] = x[i] + extent_min_x[i];
+    min_y[i] = y[i] + extent_min_y[i];
+    max_x[i] = x[i] + extent_max_x[i];
+    max_y[i] = y[i] + extent_max_y[i];
+  }
+}
+
+void colliders_get_bounds(colliders_t *colliders, size_t index, vector_t *min,
+                          vector_t *max) {
+  assert(index < colliders->size);
+  *min = (vector_t){colliders->min_x[index], colliders->min_y[index]};
+  *max = (vector_t){colliders->max_x[index], colliders->max_y[index]};
+}
+
+size_t colliders_find_visible(colliders_t *colliders, vector_t min,
+                              vector_t max, size_t *indices) {
+  const bool *restrict is_active = colliders->is_active;
+  const double *restrict min_x = colliders->min_x;
+  const double *restrict min_y = colliders->min_y;
+  const double *restrict max_x = colliders->max_x;
+  const double *restrict max_y = colliders->max_y;
+  const double *restrict prev_x = colliders->prev_x;
+  const double *restrict prev_y = colliders->prev_y;
+  const double *restrict extent_min_x = colliders->extent_min_x;
+  const double *restrict extent_min_y = colliders->extent_min_y;
+  const double *restrict extent_max_x = colliders->extent_max_x;
+  const double *restrict extent_max_y = colliders->extent_max_y;
+  size_t count = 0;
+  for (size_t i = 0; i < colliders->size; i++) {
+    bool visible = fmin(min_x[i], prev_x[i] + extent_min_x[i]) <= max.x &&
+                   fmax(max_x[i], prev_x[i] + extent_max_x[i]) >= min.x &&
+                   fmin(min_y[i], prev_y[i] + extent_min_y[i]) <= max.y &&
+                   fmax(max_y[i], prev_y[i] + extent_max_y[i]) >= min.y;
+    if (is_active[i] && visible) {
+      indices[count++] = i;
+    }
+  }
+  return count;
+}
+
+double colliders_get_radius(colliders_t *colliders, size_t index) {
+  assert(index < colliders->size);
+  return colliders->radius[index];
+}
+
+bool colliders_is_static(colliders_t *colliders, size_t index) {
+  assert(index < colliders->size);
+  return colliders->is_static[index];
+}
+
+uint32_t colliders_get_category(colliders_t *colliders, size_t index) {
+  assert(index < colliders->size);
+  return colliders->categories[index];
+}
+
+uint32_t colliders_get_mask(colliders_t *colliders, size_t index) {
+  assert(index < colliders->size);
+  return colliders->masks[index];
+}
+
+bool colliders_is_active(colliders_t *colliders, size_t index) {
+  assert(index < colliders->size);
+  return colliders->is_active[index];
+}
+
+void colliders_set_active(colliders_t *colliders, size_t index, bool active) {
+  assert(index < colliders->size);
+  if (active && !colliders->is_active[index]) {
+    // the body was moved into place, so don't interpolate from where it was
+    body_t *body = colliders->bodies[index];
+    vector_t centroid = body_get_centroid(body);
+    colliders->prev_x[index] = centroid.x;
+    colliders->prev_y[index] = centroid.y;
+    colliders->prev_rotation[index] = body_get_rotation(body);
+  }
+  colliders->is_active[index] = active;
+}
@@ -0,0 +1,249 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL_ttf.h>
+
+#include "glyph_cache.h"
+#include "renderer.h"
+#include "texture_pages.h"
+
+const int GLYPH_PAGE_SIZE = 512;
+const int GLYPH_PADDING = 1;
+const size_t INITIAL_GLYPH_SLOTS = 256; // a power of 2
+const size_t INITIAL_TEXT_QUADS = 256;
+const Uint16 REPLACEMENT_GLYPH = '?';
+
+typedef struct font {
+  char *path;
+  int point_size;
+  TTF_Font *ttf; // NULL if the font failed to open
+} font_t;
+
+typedef struct glyph {
+  uint64_t key; // 0 for an empty slot
+  size_t page;
+  SDL_Rect rect; // in page pixels, empty for glyphs with no pixels
+  int advance;
+} glyph_t;
+
+struct glyph_cache {
+  SDL_Renderer *renderer;
+  font_t *fonts;
+  size_t num_fonts;
+
+  // open addressing table keyed on font and code point
+  glyph_t *glyphs;
+  size_t num_glyphs;
+  size_t num_slots;
+
+  texture_pages_t *pages;
+};
+
+glyph_cache_t *glyph_cache_init(void) {
+  glyph_cache_t *cache = malloc(sizeof(glyph_cache_t));
+  assert(cache);
+  cache->renderer = renderer_get();
+  if (cache->renderer != NULL && !TTF_WasInit()) {
+    TTF_Init();
+  }
+  cache->fonts = NULL;
+  cache->num_fonts = 0;
+  cache->num_slots = INITIAL_GLYPH_SLOTS;
+  cache->glyphs = calloc(cache->num_slots, sizeof(glyph_t));
+  assert(cache->glyphs);
+  cache->num_glyphs = 0;
+  cache->pages = texture_pages_init(cache->renderer, GLYPH_PAGE_SIZE,
+                                    GLYPH_PADDING, INITIAL_TEXT_QUADS);
+  return cache;
+}
+
+void glyph_cache_free(glyph_cache_t *cache) {
+  for (size_t i = 0; i < cache->num_fonts; i++) {
+    if (cache->fonts[i].ttf != NULL) {
+      TTF_CloseFont(cache->fonts[i].ttf);
+    }
+    free(cache->fonts[i].path);
+  }
+  texture_pages_free(cache->pages);
+  free(cache->fonts);
+  free(cache->glyphs);
+  free(cache);
+}
+
+bool glyph_cache_load_font(glyph_cache_t *cache, const char *filepath,
+                           int point_size, size_t *font) {
+  if (cache->renderer == NULL) {
+    return false;
+  }
+  for (size_t i = 0; i < cache->num_fonts; i++) {
+    if (cache->fonts[i].point_size == point_size &&
+        strcmp(cache->fonts[i].path, filepath) == 0) {
+      *font = i;
+      return cache->fonts[i].ttf != NULL;
+    }
+  }
+
+  cache->fonts =
+      realloc(cache->fonts, (cache->num_fonts + 1) * sizeof(font_t));
+  assert(cache->fonts);
+  font_t *new_font = &cache->fonts[cache->num_fonts];
+  new_font->path = strdup(filepath);
+  assert(new_font->path);
+  new_font->point_size = point_size;
+  new_font->ttf = TTF_OpenFont(filepath, point_size);
+  *font = cache->num_fonts++;
+  return new_font->ttf != NULL;
+}
+
+int glyph_cache_line_height(glyph_cache_t *cache, size_t font) {
+  assert(font < cache->num_fonts && cache->fonts[font].ttf != NULL);
+  return TTF_FontHeight(cache->fonts[font].ttf);
+}
+
+/**
+ * Decodes the next code point of a UTF-8 string and advances past it.
+ * Code points outside the basic multilingual plane, which SDL_ttf's glyph
+ * functions cannot take, and malformed bytes decode to REPLACEMENT_GLYPH.
+ */
+static Uint16 next_code_point(const char **text) {
+  const unsigned char *bytes = (const unsigned char *)*text;
+  size_t length;
+  uint32_t code;
+  if (bytes[0] < 0x80) {
+    length = 1;
+    code = bytes[0];
+  } else if ((bytes[0] & 0xe0) == 0xc0) {
+    length = 2;
+    code = bytes[0] & 0x1f;
+  } else if ((bytes[0] & 0xf0) == 0xe0) {
+    length = 3;
+    code = bytes[0] & 0x0f;
+  } else {
+    *text += 1;
+    return REPLACEMENT_GLYPH;
+  }
+  for (size_t i = 1; i < length; i++) {
+    if ((bytes[i] & 0xc0) != 0x80) {
+      *text += i;
+      return REPLACEMENT_GLYPH;
+    }
+    code = (code << 6) | (bytes[i] & 0x3f);
+  }
+  *text += length;
+  return (Uint16)code;
+}
+
+static uint64_t glyph_key(size_t font, Uint16 code) {
+  // + 1 keeps keys away from the empty slot marker
+  return ((uint64_t)font << 16 | code) + 1;
+}
+
+static glyph_t *find_slot(glyph_t *glyphs, size_t num_slots, uint64_t key) {
+  size_t i = (size_t)(key * 11400714819323198485ULL >> 32) & (num_slots - 1);
+  while (glyphs[i].key != 0 && glyphs[i].key != key) {
+    i = (i + 1) & (num_slots - 1);
+  }
+  return &glyphs[i];
+}
+
+static void grow_table(glyph_cache_t *cache) {
+  size_t num_slots = 2 * cache->num_slots;
+  glyph_t *glyphs = calloc(num_slots, sizeof(glyph_t));
+  assert(glyphs);
+  for (size_t i = 0; i < cache->num_slots; i++) {
+    if (cache->glyphs[i].key != 0) {
+      *find_slot(glyphs, num_slots, cache->glyphs[i].key) = cache->glyphs[i];
+    }
+  }
+  free(cache->glyphs);
+  cache->glyphs = glyphs;
+  cache->num_slots = num_slots;
+}
+
+/**
+ * Rasterizes a glyph in white and uploads it to a page. Glyphs with no
+ * pixels, such as spaces, only keep their advance.
+ */
+static void rasterize(glyph_cache_t *cache, TTF_Font *ttf, Uint16 code,
+                      glyph_t *glyph) {
+  int min_x, max_x, min_y, max_y;
+  if (TTF_GlyphMetrics(ttf, code, &min_x, &max_x, &min_y, &max_y,
+                       &glyph->advance) != 0) {
+    glyph->advance = 0;
+  }
+  glyph->page = 0;
+  glyph->rect = (SDL_Rect){0, 0, 0, 0};
+
+  SDL_Color white = {255, 255, 255, 255};
+  SDL_Surface *surface = TTF_RenderGlyph_Blended(ttf, code, white);
+  if (surface == NULL) {
+    return;
+  }
+  // glyphs of one font are about the same height, so shelves waste little
+  // space; glyphs that do not fit keep an empty rect
+  texture_pages_add(cache->pages, surface, &glyph->page, &glyph->rect);
+  SDL_FreeSurface(surface);
+}
+
+/**
+ * Finds a glyph, rasterizing it on a miss.
+ */
+static glyph_t *get_glyph(glyph_cache_t *cache, size_t font, Uint16 code) {
+  uint64_t key = glyph_key(font, code);
+  glyph_t *glyph = find_slot(cache->glyphs, cache->num_slots, key);
+  if (glyph->key == key) {
+    return glyph;
+  }
+  // keep the table at most 3/4 full
+  if (4 * (cache->num_glyphs + 1) > 3 * cache->num_slots) {
+    grow_table(cache);
+    glyph = find_slot(cache->glyphs, cache->num_slots, key);
+  }
+  glyph->key = key;
+  rasterize(cache, cache->fonts[font].ttf, code, glyph);
+  cache->num_glyphs++;
+  return glyph;
+}
+
+int glyph_cache_text_width(glyph_cache_t *cache, size_t font,
+                           const char *text) {
+  assert(font < cache->num_fonts && cache->fonts[font].ttf != NULL);
+  int width = 0;
+  while (*text != '\0') {
+    width += get_glyph(cache, font, next_code_point(&text))->advance;
+  }
+  return width;
+}
+
+void glyph_cache_begin(glyph_cache_t *cache) {
+  texture_pages_begin(cache->pages);
+}
+
+void glyph_cache_add_text(glyph_cache_t *cache, size_t font, const char *text,
+                          int x, int y, rgb_color_t color) {
+  assert(font < cache->num_fonts && cache->fonts[font].ttf != NULL);
+  SDL_Color sdl_color = {.r = (Uint8)(color.r * 255),
+                         .g = (Uint8)(color.g * 255),
+                         .b = (Uint8)(color.b * 255),
+                         .a = 255};
+  // rendered glyphs span the font's full height, so every glyph's top
+  // lines up with the top of the line
+  while (*text != '\0') {
+    glyph_t *glyph = get_glyph(cache, font, next_code_point(&text));
+    if (glyph->rect.w > 0) {
+      SDL_Rect rect = glyph->rect;
+      texture_pages_add_quad(cache->pages, glyph->page, rect, x, y,
+                             x + rect.w, y + rect.h, sdl_color);
+    }
+    x += glyph->advance;
+  }
+}
+
+void glyph_cache_flush(glyph_cache_t *cache) {
+  texture_pages_flush(cache->pages);
+}
+
+size_t glyph_cache_num_glyphs(glyph_cache_t *cache) {
+  return cache->num_glyphs;
+}
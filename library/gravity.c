@@ -0,0 +1,303 @@
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gravity.h"
+
+const size_t NO_CHILDREN = 0; // the root is never a child
+const size_t INITIAL_TREE_CAPACITY = 64; // nodes
+#define MAX_TREE_DEPTH 32
+// a walk holds at most three siblings per level, plus four children
+#define TREE_STACK_SIZE (3 * MAX_TREE_DEPTH + 4)
+
+struct gravity_field {
+  vector_t min;
+  double cell_size;
+  size_t cols; // cells across; each row has cols + 1 grid points
+  size_t rows;
+  // the acceleration at each grid point, row by row from `min`
+  double *ax;
+  double *ay;
+};
+
+typedef struct tree_node {
+  double mass;
+  double x; // center of mass
+  double y;
+  // the node's square
+  double center_x;
+  double center_y;
+  double half_size;
+  size_t first_child; // of four consecutive children, or NO_CHILDREN
+} tree_node_t;
+
+struct gravity_tree {
+  double G;
+  double softening;
+  double theta;
+  tree_node_t *nodes; // the root first
+  size_t num_nodes;
+  size_t node_capacity;
+  // body indices, partitioned into quadrants while building
+  size_t *order;
+  size_t *scratch;
+  size_t order_capacity;
+};
+
+/**
+ * Gets the softened pull of mass `gm` / G at offset `dx`, `dy` from the
+ * point being pulled, adding it to `ax`, `ay`.
+ */
+static void add_pull(double dx, double dy, double gm, double softening,
+                     double *ax, double *ay) {
+  double d2 = dx * dx + dy * dy + softening * softening;
+  if (d2 == 0) {
+    return;
+  }
+  double scale = gm / (d2 * sqrt(d2));
+  *ax += scale * dx;
+  *ay += scale * dy;
+}
+
+gravity_field_t *gravity_field_init(vector_t min, vector_t max,
+                                    double cell_size, double G,
+                                    double softening,
+                                    const vector_t *locations,
+                                    const double *masses,
+                                    size_t num_attractors) {
+  assert(cell_size > 0 && max.x >= min.x && max.y >= min.y);
+  gravity_field_t *field = malloc(sizeof(gravity_field_t));
+  assert(field);
+  field->min = min;
+  field->cell_size = cell_size;
+  field->cols = fmax(1, ceil((max.x - min.x) / cell_size));
+  field->rows = fmax(1, ceil((max.y - min.y) / cell_size));
+  size_t num_points = (field->cols + 1) * (field->rows + 1);
+  field->ax = malloc(num_points * sizeof(double));
+  field->ay = malloc(num_points * sizeof(double));
+  assert(field->ax && field->ay);
+
+  for (size_t row = 0; row <= field->rows; row++) {
+    double y = min.y + row * cell_size;
+    for (size_t col = 0; col <= field->cols; col++) {
+      double x = min.x + col * cell_size;
+      double ax = 0;
+      double ay = 0;
+      for (size_t i = 0; i < num_attractors; i++) {
+        add_pull(locations[i].x - x, locations[i].y - y, G * masses[i],
+                 softening, &ax, &ay);
+      }
+      size_t point = row * (field->cols + 1) + col;
+      field->ax[point] = ax;
+      field->ay[point] = ay;
+    }
+  }
+  return field;
+}
+
+void gravity_field_free(gravity_field_t *field) {
+  free(field->ax);
+  free(field->ay);
+  free(field);
+}
+
+vector_t gravity_field_sample(gravity_field_t *field, vector_t pos) {
+  // position in cells, clamped to the grid
+  double u = fmin(fmax((pos.x - field->min.x) / field->cell_size, 0),
+                  field->cols);
+  double v = fmin(fmax((pos.y - field->min.y) / field->cell_size, 0),
+                  field->rows);
+  size_t col = fmin(floor(u), field->cols - 1);
+  size_t row = fmin(floor(v), field->rows - 1);
+  double fx = u - col;
+  double fy = v - row;
+
+  size_t stride = field->cols + 1;
+  size_t p00 = row * stride + col;
+  size_t p10 = p00 + 1;
+  size_t p01 = p00 + stride;
+  size_t p11 = p01 + 1;
+  const double *ax = field->ax;
+  const double *ay = field->ay;
+  return (vector_t){
+      (ax[p00] * (1 - fx) + ax[p10] * fx) * (1 - fy) +
+          (ax[p01] * (1 - fx) + ax[p11] * fx) * fy,
+      (ay[p00] * (1 - fx) + ay[p10] * fx) * (1 - fy) +
+          (ay[p01] * (1 - fx) + ay[p11] * fx) * fy};
+}
+
+gravity_tree_t *gravity_tree_init(double G, double softening, double theta) {
+  gravity_tree_t *tree = malloc(sizeof(gravity_tree_t));
+  assert(tree);
+  tree->G = G;
+  tree->softening = softening;
+  tree->theta = theta;
+  tree->node_capacity = INITIAL_TREE_CAPACITY;
+  tree->nodes = malloc(tree->node_capacity * sizeof(tree_node_t));
+  assert(tree->nodes);
+  tree->num_nodes = 0;
+  tree->order = NULL;
+  tree->scratch = NULL;
+  tree->order_capacity = 0;
+  return tree;
+}
+
+void gravity_tree_free(gravity_tree_t *tree) {
+  free(tree->nodes);
+  free(tree->order);
+  free(tree->scratch);
+  free(tree);
+}
+
+/**
+ * Appends `count` empty nodes and returns the index of the first.
+ */
+static size_t add_nodes(gravity_tree_t *tree, size_t count) {
+  if (tree->num_nodes + count > tree->node_capacity) {
+    while (tree->num_nodes + count > tree->node_capacity) {
+      tree->node_capacity *= 2;
+    }
+    tree->nodes =
+        realloc(tree->nodes, tree->node_capacity * sizeof(tree_node_t));
+    assert(tree->nodes);
+  }
+  size_t first = tree->num_nodes;
+  tree->num_nodes += count;
+  return first;
+}
+
+/**
+ * Finds the mass and center of mass of node `index`, which holds the bodies
+ * order[start, end), splitting it into quadrants while it holds more than
+ * one body. Nodes are only referred to by index, since adding nodes can
+ * move them.
+ */
+static void build_node(gravity_tree_t *tree, size_t index,
+                       const vector_t *positions, const double *masses,
+                       size_t start, size_t end, size_t depth) {
+  tree_node_t *node = &tree->nodes[index];
+  node->first_child = NO_CHILDREN;
+  if (end - start <= 1 || depth == MAX_TREE_DEPTH) {
+    // a leaf; bodies that never separate are lumped together
+    double mass = 0;
+    double x = 0;
+    double y = 0;
+    for (size_t i = start; i < end; i++) {
+      size_t body = tree->order[i];
+      mass += masses[body];
+      x += masses[body] * positions[body].x;
+      y += masses[body] * positions[body].y;
+    }
+    node->mass = mass;
+    node->x = mass > 0 ? x / mass : node->center_x;
+    node->y = mass > 0 ? y / mass : node->center_y;
+    return;
+  }
+
+  // partition the bodies by quadrant: bit 0 is the right half, bit 1 the top
+  double center_x = node->center_x;
+  double center_y = node->center_y;
+  double quarter = node->half_size / 2;
+  size_t counts[4] = {0};
+  for (size_t i = start; i < end; i++) {
+    vector_t pos = positions[tree->order[i]];
+    counts[(pos.x >= center_x) + 2 * (pos.y >= center_y)]++;
+  }
+  size_t offsets[4] = {start};
+  for (size_t q = 1; q < 4; q++) {
+    offsets[q] = offsets[q - 1] + counts[q - 1];
+  }
+  size_t bounds[5] = {offsets[0], offsets[1], offsets[2], offsets[3], end};
+  for (size_t i = start; i < end; i++) {
+    vector_t pos = positions[tree->order[i]];
+    size_t q = (pos.x >= center_x) + 2 * (pos.y >= center_y);
+    tree->scratch[offsets[q]++] = tree->order[i];
+  }
+  memcpy(tree->order + start, tree->scratch + start,
+         (end - start) * sizeof(size_t));
+
+  size_t first_child = add_nodes(tree, 4);
+  double mass = 0;
+  double x = 0;
+  double y = 0;
+  for (size_t q = 0; q < 4; q++) {
+    tree_node_t *child = &tree->nodes[first_child + q];
+    child->center_x = center_x + (q & 1 ? quarter : -quarter);
+    child->center_y = center_y + (q & 2 ? quarter : -quarter);
+    child->half_size = quarter;
+    build_node(tree, first_child + q, positions, masses, bounds[q],
+               bounds[q + 1], depth + 1);
+    child = &tree->nodes[first_child + q];
+    mass += child->mass;
+    x += child->mass * child->x;
+    y += child->mass * child->y;
+  }
+  node = &tree->nodes[index];
+  node->first_child = first_child;
+  node->mass = mass;
+  node->x = mass > 0 ? x / mass : center_x;
+  node->y = mass > 0 ? y / mass : center_y;
+}
+
+void gravity_tree_build(gravity_tree_t *tree, const vector_t *positions,
+                        const double *masses, size_t num_bodies) {
+  tree->num_nodes = 0;
+  if (num_bodies == 0) {
+    return;
+  }
+  if (num_bodies > tree->order_capacity) {
+    tree->order_capacity = num_bodies;
+    tree->order = realloc(tree->order, num_bodies * sizeof(size_t));
+    tree->scratch = realloc(tree->scratch, num_bodies * sizeof(size_t));
+    assert(tree->order && tree->scratch);
+  }
+
+  vector_t min = positions[0];
+  vector_t max = positions[0];
+  for (size_t i = 0; i < num_bodies; i++) {
+    tree->order[i] = i;
+    min = (vector_t){fmin(min.x, positions[i].x), fmin(min.y, positions[i].y)};
+    max = (vector_t){fmax(max.x, positions[i].x), fmax(max.y, positions[i].y)};
+  }
+  size_t root = add_nodes(tree, 1);
+  tree_node_t *node = &tree->nodes[root];
+  node->center_x = (min.x + max.x) / 2;
+  node->center_y = (min.y + max.y) / 2;
+  node->half_size = fmax(max.x - min.x, max.y - min.y) / 2;
+  build_node(tree, root, positions, masses, 0, num_bodies, 0);
+}
+
+vector_t gravity_tree_sample(gravity_tree_t *tree, vector_t pos) {
+  double ax = 0;
+  double ay = 0;
+  if (tree->num_nodes == 0) {
+    return (vector_t){0, 0};
+  }
+  double theta2 = tree->theta * tree->theta;
+  size_t stack[TREE_STACK_SIZE];
+  size_t size = 0;
+  stack[size++] = 0;
+  while (size > 0) {
+    const tree_node_t *node = &tree->nodes[stack[--size]];
+    if (node->mass == 0) {
+      continue;
+    }
+    double dx = node->x - pos.x;
+    double dy = node->y - pos.y;
+    double width = 2 * node->half_size;
+    // a group is never lumped together when the point is inside it
+    bool inside = fabs(pos.x - node->center_x) <= node->half_size &&
+                  fabs(pos.y - node->center_y) <= node->half_size;
+    if (node->first_child == NO_CHILDREN ||
+        (!inside && width * width < theta2 * (dx * dx + dy * dy))) {
+      add_pull(dx, dy, tree->G * node->mass, tree->softening, &ax, &ay);
+    } else {
+      for (size_t q = 0; q < 4; q++) {
+        stack[size++] = node->first_child + q;
+      }
+    }
+  }
+  return (vector_t){ax, ay};
+}
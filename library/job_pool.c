@@ -0,0 +1,230 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "job_pool.h"
+#include "profiler.h"
+
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+// no threads in this build: every loop runs on the calling thread
+
+struct job_pool {
+  size_t num_threads;
+};
+
+job_pool_t *job_pool_init(size_t num_threads) {
+  job_pool_t *pool = malloc(sizeof(job_pool_t));
+  assert(pool);
+  pool->num_threads = 1;
+  return pool;
+}
+
+void job_pool_free(job_pool_t *pool) { free(pool); }
+
+size_t job_pool_num_threads(job_pool_t *pool) { return pool->num_threads; }
+
+void job_pool_run(job_pool_t *pool, size_t count, size_t grain,
+                  job_func_t func, void *aux) {
+  if (count > 0) {
+    func(aux, 0, count);
+  }
+}
+
+#else
+#include <pthread.h>
+#include <unistd.h>
+
+/**
+ * The chunks [head, tail) still waiting in one thread's share of a loop.
+ * The owner takes chunks from the front and thieves from the back, so they
+ * only contend over the last chunk.
+ */
+typedef struct deque {
+  pthread_mutex_t lock;
+  size_t head;
+  size_t tail;
+} deque_t;
+
+typedef struct worker {
+  job_pool_t *pool;
+  size_t id;
+} worker_t;
+
+struct job_pool {
+  size_t num_threads;
+  pthread_t *threads; // num_threads - 1 workers; the caller is thread 0
+  worker_t *workers;
+  deque_t *deques;
+
+  pthread_mutex_t lock;
+  pthread_cond_t start;
+  pthread_cond_t done;
+  size_t generation; // bumped for every loop so workers see new work
+  size_t num_running;
+  bool stopping;
+
+  // the current loop
+  job_func_t func;
+  void *aux;
+  size_t count;
+  size_t grain;
+};
+
+static bool take_chunk(deque_t *deque, bool from_back, size_t *chunk) {
+  pthread_mutex_lock(&deque->lock);
+  bool found = deque->head < deque->tail;
+  if (found) {
+    *chunk = from_back ? --deque->tail : deque->head++;
+  }
+  pthread_mutex_unlock(&deque->lock);
+  return found;
+}
+
+/**
+ * Runs chunks of the current loop until no thread has any left.
+ */
+static void run_chunks(job_pool_t *pool, size_t id) {
+  size_t chunk;
+  while (true) {
+    bool found = take_chunk(&pool->deques[id], false, &chunk);
+    for (size_t i = 1; !found && i < pool->num_threads; i++) {
+      found = take_chunk(&pool->deques[(id + i) % pool->num_threads], true,
+                         &chunk);
+    }
+    if (!found) {
+      return;
+    }
+    size_t start = chunk * pool->grain;
+    size_t end = start + pool->grain < pool->count ? start + pool->grain
+                                                   : pool->count;
+    PROFILE_BEGIN(job_start);
+    pool->func(pool->aux, start, end);
+    PROFILE_END(PROFILE_JOB, job_start);
+  }
+}
+
+static void *worker_main(void *arg) {
+  worker_t *worker = arg;
+  job_pool_t *pool = worker->pool;
+  size_t seen_generation = 0;
+  PROFILE_THREAD(worker->id);
+  while (true) {
+    pthread_mutex_lock(&pool->lock);
+    while (!pool->stopping && pool->generation == seen_generation) {
+      pthread_cond_wait(&pool->start, &pool->lock);
+    }
+    if (pool->stopping) {
+      pthread_mutex_unlock(&pool->lock);
+      return NULL;
+    }
+    seen_generation = pool->generation;
+    pthread_mutex_unlock(&pool->lock);
+
+    run_chunks(pool, worker->id);
+
+    pthread_mutex_lock(&pool->lock);
+    if (--pool->num_running == 0) {
+      pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+  }
+}
+
+job_pool_t *job_pool_init(size_t num_threads) {
+  if (num_threads == 0) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    num_threads = cores > 0 ? (size_t)cores : 1;
+  }
+
+  job_pool_t *pool = malloc(sizeof(job_pool_t));
+  assert(pool);
+  pool->num_threads = num_threads;
+  pool->threads = malloc(num_threads * sizeof(pthread_t));
+  pool->workers = malloc(num_threads * sizeof(worker_t));
+  pool->deques = malloc(num_threads * sizeof(deque_t));
+  assert(pool->threads && pool->workers && pool->deques);
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->start, NULL);
+  pthread_cond_init(&pool->done, NULL);
+  pool->generation = 0;
+  pool->num_running = 0;
+  pool->stopping = false;
+
+  for (size_t i = 0; i < num_threads; i++) {
+    pthread_mutex_init(&pool->deques[i].lock, NULL);
+    pool->deques[i].head = 0;
+    pool->deques[i].tail = 0;
+    pool->workers[i] = (worker_t){.pool = pool, .id = i};
+  }
+  for (size_t i = 1; i < num_threads; i++) {
+    int err = pthread_create(&pool->threads[i], NULL, worker_main,
+                             &pool->workers[i]);
+    assert(err == 0);
+  }
+  return pool;
+}
+
+void job_pool_free(job_pool_t *pool) {
+  pthread_mutex_lock(&pool->lock);
+  pool->stopping = true;
+  pthread_cond_broadcast(&pool->start);
+  pthread_mutex_unlock(&pool->lock);
+  for (size_t i = 1; i < pool->num_threads; i++) {
+    pthread_join(pool->threads[i], NULL);
+  }
+
+  for (size_t i = 0; i < pool->num_threads; i++) {
+    pthread_mutex_destroy(&pool->deques[i].lock);
+  }
+  pthread_mutex_destroy(&pool->lock);
+  pthread_cond_destroy(&pool->start);
+  pthread_cond_destroy(&pool->done);
+  free(pool->threads);
+  free(pool->workers);
+  free(pool->deques);
+  free(pool);
+}
+
+size_t job_pool_num_threads(job_pool_t *pool) { return pool->num_threads; }
+
+void job_pool_run(job_pool_t *pool, size_t count, size_t grain,
+                  job_func_t func, void *aux) {
+  assert(grain > 0);
+  if (count == 0) {
+    return;
+  }
+  size_t num_chunks = (count + grain - 1) / grain;
+  if (pool->num_threads == 1 || num_chunks == 1) {
+    func(aux, 0, count);
+    return;
+  }
+
+  pool->func = func;
+  pool->aux = aux;
+  pool->count = count;
+  pool->grain = grain;
+  // deal out contiguous runs of chunks so each thread starts on its own
+  // region of memory
+  for (size_t i = 0; i < pool->num_threads; i++) {
+    deque_t *deque = &pool->deques[i];
+    pthread_mutex_lock(&deque->lock);
+    deque->head = num_chunks * i / pool->num_threads;
+    deque->tail = num_chunks * (i + 1) / pool->num_threads;
+    pthread_mutex_unlock(&deque->lock);
+  }
+
+  pthread_mutex_lock(&pool->lock);
+  pool->num_running = pool->num_threads - 1;
+  pool->generation++;
+  pthread_cond_broadcast(&pool->start);
+  pthread_mutex_unlock(&pool->lock);
+
+  run_chunks(pool, 0);
+
+  pthread_mutex_lock(&pool->lock);
+  while (pool->num_running > 0) {
+    pthread_cond_wait(&pool->done, &pool->lock);
+  }
+  pthread_mutex_unlock(&pool->lock);
+}
+#endif
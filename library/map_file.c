@@ -0,0 +1,391 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "map_file.h"
+
+const char MAP_MAGIC[4] = {'M', 'A', 'P', 'B'};
+const uint32_t MAP_VERSION = 2;
+const uint32_t NO_STRING = UINT32_MAX; // the offset of a missing backdrop
+const size_t NUM_PLAYERS = 2;
+// destroyed asteroids are parked rather than freed, so this also bounds the
+// bodies a match keeps out of play
+const size_t MAX_MAP_ASTEROIDS = 4096;
+const size_t INITIAL_MAP_BUFFER_CAPACITY = 64;
+#define MAX_LINE_LENGTH 1024
+#define NUM_MAP_SECTIONS 11
+
+/**
+ * A compiled map is this header followed by its doubles, then the offsets
+ * of its strings and then the strings themselves, each NUL-terminated:
+ *
+ *   start_pos (x, y pairs)
+ *   mutual_gravity
+ *   block_locations, block_sizes, blackhole_locations (x, y pairs)
+ *   blackhole_masses
+ *   bg_pos, bg_sizes (x, y pairs)
+ *   bg_depth
+ *   uint32 offsets of the backdrop path and each layer path
+ *   strings
+ *
+ * Values are stored in the byte order of the machine that compiled the map,
+ * so they can be used in place. Every target the game builds for is
+ * little-endian; a map compiled elsewhere fails the version check.
+ */
+typedef struct map_header {
+  char magic[4];
+  uint32_t version;
+  uint32_t num_blocks;
+  uint32_t num_asteroids;
+  uint32_t num_blackholes;
+  uint32_t num_bg;
+  uint32_t strings_size;
+  uint32_t reserved; // keeps the doubles that follow 8-byte aligned
+} map_header_t;
+
+/**
+ * Finds the map's arrays in its binary form and checks that they fit.
+ * Takes ownership of `data`, which is freed if it is not a valid map.
+ */
+static map_t *map_from_data(uint8_t *data, size_t size) {
+  map_header_t header;
+  if (size < sizeof(header)) {
+    free(data);
+    return NULL;
+  }
+  memcpy(&header, data, sizeof(header));
+  // 64-bit arithmetic, so that no counts can overflow on 32-bit targets
+  uint64_t num_doubles = 2 * NUM_PLAYERS + 1 +
+                         4 * (uint64_t)header.num_blocks +
+                         3 * (uint64_t)header.num_blackholes +
+                         5 * (uint64_t)header.num_bg;
+  uint64_t num_strings = 1 + (uint64_t)header.num_bg;
+  uint64_t expected_size = sizeof(header) + num_doubles * sizeof(double) +
+                           num_strings * sizeof(uint32_t) +
+                           header.strings_size;
+  if (memcmp(header.magic, MAP_MAGIC, sizeof(MAP_MAGIC)) != 0 ||
+      header.version != MAP_VERSION || expected_size != size ||
+      header.num_asteroids > MAX_MAP_ASTEROIDS ||
+      header.strings_size == 0 || data[size - 1] != '\0') {
+    free(data);
+    return NULL;
+  }
+
+  map_t *map = malloc(sizeof(map_t) + header.num_bg * sizeof(char *));
+  assert(map);
+  map->num_blocks = header.num_blocks;
+  map->num_asteroids = header.num_asteroids;
+  map->num_blackholes = header.num_blackholes;
+  map->num_bg = header.num_bg;
+  map->data = data;
+  map->size = size;
+
+  uint8_t *cursor = data + sizeof(header);
+  map->start_pos = (vector_t *)cursor;
+  cursor += NUM_PLAYERS * sizeof(vector_t);
+  memcpy(&map->mutual_gravity, cursor, sizeof(double));
+  cursor += sizeof(double);
+  map->block_locations = (vector_t *)cursor;
+  cursor += map->num_blocks * sizeof(vector_t);
+  map->block_sizes = (vector_t *)cursor;
+  cursor += map->num_blocks * sizeof(vector_t);
+  map->blackhole_locations = (vector_t *)cursor;
+  cursor += map->num_blackholes * sizeof(vector_t);
+  map->blackhole_masses = (double *)cursor;
+  cursor += map->num_blackholes * sizeof(double);
+  map->bg_pos = (vector_t *)cursor;
+  cursor += map->num_bg * sizeof(vector_t);
+  map->bg_sizes = (vector_t *)cursor;
+  cursor += map->num_bg * sizeof(vector_t);
+  map->bg_depth = (double *)cursor;
+  cursor += map->num_bg * sizeof(double);
+
+  const char *strings = (char *)cursor + num_strings * sizeof(uint32_t);
+  uint32_t offset;
+  memcpy(&offset, cursor, sizeof(offset));
+  bool valid = offset == NO_STRING || offset < header.strings_size;
+  map->backdrop_path = offset == NO_STRING ? NULL : strings + offset;
+  map->bg_paths = (const char **)(map + 1);
+  for (size_t i = 0; i < map->num_bg; i++) {
+    memcpy(&offset, cursor + (i + 1) * sizeof(offset), sizeof(offset));
+    valid = valid && offset < header.strings_size;
+    map->bg_paths[i] = strings + offset;
+  }
+  if (!valid) {
+    map_file_free(map);
+    return NULL;
+  }
+  return map;
+}
+
+/**
+ * A growable array of bytes.
+ */
+typedef struct buffer {
+  uint8_t *data;
+  size_t size;
+  size_t capacity;
+} buffer_t;
+
+static void buffer_push(buffer_t *buffer, const void *bytes, size_t size) {
+  if (buffer->size + size > buffer->capacity) {
+    if (buffer->capacity == 0) {
+      buffer->capacity = INITIAL_MAP_BUFFER_CAPACITY;
+    }
+    while (buffer->size + size > buffer->capacity) {
+      buffer->capacity *= 2;
+    }
+    buffer->data = realloc(buffer->data, buffer->capacity);
+    assert(buffer->data);
+  }
+  memcpy(buffer->data + buffer->size, bytes, size);
+  buffer->size += size;
+}
+
+/**
+ * The sections of a map being parsed, in their binary form.
+ */
+typedef struct map_builder {
+  buffer_t start_pos;
+  buffer_t mutual_gravity; // always one double
+  buffer_t block_locations;
+  buffer_t block_sizes;
+  buffer_t blackhole_locations;
+  buffer_t blackhole_masses;
+  buffer_t bg_pos;
+  buffer_t bg_sizes;
+  buffer_t bg_depth;
+  buffer_t string_offsets; // the backdrop's first
+  buffer_t strings;
+  size_t num_asteroids;
+  bool has_backdrop;
+  bool has_mutual_gravity;
+} map_builder_t;
+
+/**
+ * Lists the builder's sections in the order they are laid out.
+ */
+static void get_sections(map_builder_t *builder,
+                         buffer_t *sections[NUM_MAP_SECTIONS]) {
+  buffer_t *ordered[NUM_MAP_SECTIONS] = {
+      &builder->start_pos,           &builder->mutual_gravity,
+      &builder->block_locations,     &builder->block_sizes,
+      &builder->blackhole_locations, &builder->blackhole_masses,
+      &builder->bg_pos,              &builder->bg_sizes,
+      &builder->bg_depth,            &builder->string_offsets,
+      &builder->strings};
+  memcpy(sections, ordered, sizeof(ordered));
+}
+
+static uint32_t add_string(map_builder_t *builder, const char *string) {
+  uint32_t offset = builder->strings.size;
+  buffer_push(&builder->strings, string, strlen(string) + 1);
+  return offset;
+}
+
+static void push_vector(buffer_t *buffer, double x, double y) {
+  vector_t vector = {x, y};
+  buffer_push(buffer, &vector, sizeof(vector));
+}
+
+/**
+ * Adds the item on one line of a text map.
+ *
+ * @return NULL, or what is wrong with the line
+ */
+static const char *parse_line(map_builder_t *builder, char *line) {
+  char *comment = strchr(line, '#');
+  if (comment != NULL) {
+    *comment = '\0';
+  }
+  char keyword[MAX_LINE_LENGTH];
+  if (sscanf(line, "%s", keyword) != 1) {
+    return NULL;
+  }
+
+  // %n records where parsing stopped, to reject anything left over
+  char path[MAX_LINE_LENGTH];
+  double x, y, w, h, value;
+  size_t count;
+  int end = -1;
+  if (strcmp(keyword, "backdrop") == 0) {
+    if (sscanf(line, "%*s %s %n", path, &end) != 1 || line[end] != '\0') {
+      return "expected: backdrop <path>";
+    }
+    if (builder->has_backdrop) {
+      return "the map already has a backdrop";
+    }
+    uint32_t offset = add_string(builder, path);
+    memcpy(builder->string_offsets.data, &offset, sizeof(offset));
+    builder->has_backdrop = true;
+  } else if (strcmp(keyword, "layer") == 0) {
+    if (sscanf(line, "%*s %s %lf %lf %lf %lf %lf %n", path, &x, &y, &w, &h,
+               &value, &end) != 6 ||
+        line[end] != '\0') {
+      return "expected: layer <path> <x> <y> <w> <h> <depth>";
+    }
+    uint32_t offset = add_string(builder, path);
+    buffer_push(&builder->string_offsets, &offset, sizeof(offset));
+    push_vector(&builder->bg_pos, x, y);
+    push_vector(&builder->bg_sizes, w, h);
+    buffer_push(&builder->bg_depth, &value, sizeof(value));
+  } else if (strcmp(keyword, "block") == 0) {
+    if (sscanf(line, "%*s %lf %lf %lf %lf %n", &x, &y, &w, &h, &end) != 4 ||
+        line[end] != '\0') {
+      return "expected: block <x> <y> <w> <h>";
+    }
+    push_vector(&builder->block_locations, x, y);
+    push_vector(&builder->block_sizes, w, h);
+  } else if (strcmp(keyword, "blackhole") == 0) {
+    if (sscanf(line, "%*s %lf %lf %lf %n", &x, &y, &value, &end) != 3 ||
+        line[end] != '\0') {
+      return "expected: blackhole <x> <y> <mass>";
+    }
+    push_vector(&builder->blackhole_locations, x, y);
+    buffer_push(&builder->blackhole_masses, &value, sizeof(value));
+  } else if (strcmp(keyword, "mutual_gravity") == 0) {
+    if (sscanf(line, "%*s %lf %n", &value, &end) != 1 || line[end] != '\0') {
+      return "expected: mutual_gravity <G>";
+    }
+    if (builder->has_mutual_gravity) {
+      return "the map already has mutual gravity";
+    }
+    memcpy(builder->mutual_gravity.data, &value, sizeof(value));
+    builder->has_mutual_gravity = true;
+  } else if (strcmp(keyword, "asteroids") == 0) {
+    if (sscanf(line, "%*s %zu %n", &count, &end) != 1 || line[end] != '\0' ||
+        strchr(line, '-') != NULL || count > UINT32_MAX) {
+      return "expected: asteroids <count>";
+    }
+    if (count > MAX_MAP_ASTEROIDS) {
+      return "a map can have at most 4096 asteroids";
+    }
+    builder->num_asteroids = count;
+  } else if (strcmp(keyword, "start") == 0) {
+    if (sscanf(line, "%*s %lf %lf %n", &x, &y, &end) != 2 ||
+        line[end] != '\0') {
+      return "expected: start <x> <y>";
+    }
+    if (builder->start_pos.size == NUM_PLAYERS * sizeof(vector_t)) {
+      return "the map already has a start for each player";
+    }
+    push_vector(&builder->start_pos, x, y);
+  } else {
+    return "unknown item";
+  }
+  return NULL;
+}
+
+/**
+ * Lays a parsed map out in its binary form.
+ */
+static map_t *build_map(map_builder_t *builder) {
+  map_header_t header = {
+      .version = MAP_VERSION,
+      .num_blocks = builder->block_locations.size / sizeof(vector_t),
+      .num_asteroids = builder->num_asteroids,
+      .num_blackholes = builder->blackhole_locations.size / sizeof(vector_t),
+      .num_bg = builder->bg_pos.size / sizeof(vector_t),
+      .strings_size = builder->strings.size,
+      .reserved = 0};
+  memcpy(header.magic, MAP_MAGIC, sizeof(MAP_MAGIC));
+
+  buffer_t *sections[NUM_MAP_SECTIONS];
+  get_sections(builder, sections);
+  size_t size = sizeof(header);
+  for (size_t i = 0; i < NUM_MAP_SECTIONS; i++) {
+    size += sections[i]->size;
+  }
+  uint8_t *data = malloc(size);
+  assert(data);
+  memcpy(data, &header, sizeof(header));
+  size_t offset = sizeof(header);
+  for (size_t i = 0; i < NUM_MAP_SECTIONS; i++) {
+    if (sections[i]->size > 0) {
+      memcpy(data + offset, sections[i]->data, sections[i]->size);
+    }
+    offset += sections[i]->size;
+  }
+  return map_from_data(data, size);
+}
+
+static void builder_free(map_builder_t *builder) {
+  buffer_t *sections[NUM_MAP_SECTIONS];
+  get_sections(builder, sections);
+  for (size_t i = 0; i < NUM_MAP_SECTIONS; i++) {
+    free(sections[i]->data);
+  }
+}
+
+map_t *map_file_parse(const char *path) {
+  FILE *file = fopen(path, "r");
+  if (file == NULL) {
+    return NULL;
+  }
+  map_builder_t builder = {0};
+  buffer_push(&builder.string_offsets, &NO_STRING, sizeof(NO_STRING));
+  double no_gravity = 0;
+  buffer_push(&builder.mutual_gravity, &no_gravity, sizeof(no_gravity));
+  // the strings are never empty, which the loader relies on
+  add_string(&builder, "");
+
+  char line[MAX_LINE_LENGTH];
+  size_t line_number = 0;
+  const char *error = NULL;
+  while (error == NULL && fgets(line, sizeof(line), file) != NULL) {
+    line_number++;
+    if (strchr(line, '\n') == NULL && !feof(file)) {
+      error = "line too long";
+    } else {
+      error = parse_line(&builder, line);
+    }
+  }
+  fclose(file);
+  if (error == NULL &&
+      builder.start_pos.size != NUM_PLAYERS * sizeof(vector_t)) {
+    error = "the map needs a start for each player";
+  }
+
+  map_t *map = NULL;
+  if (error != NULL) {
+    fprintf(stderr, "%s:%zu: %s\n", path, line_number, error);
+  } else {
+    map = build_map(&builder);
+  }
+  builder_free(&builder);
+  return map;
+}
+
+map_t *map_file_load(const char *path) {
+  FILE *file = fopen(path, "rb");
+  if (file == NULL) {
+    return NULL;
+  }
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  uint8_t *data = malloc(size > 0 ? size : 1);
+  assert(data);
+  size_t read = size > 0 ? fread(data, 1, size, file) : 0;
+  fclose(file);
+  if (size <= 0 || read != (size_t)size) {
+    free(data);
+    return NULL;
+  }
+  return map_from_data(data, size);
+}
+
+bool map_file_save(map_t *map, const char *path) {
+  FILE *file = fopen(path, "wb");
+  if (file == NULL) {
+    return false;
+  }
+  bool written = fwrite(map->data, 1, map->size, file) == map->size;
+  return fclose(file) == 0 && written;
+}
+
+void map_file_free(map_t *map) {
+  free(map->data);
+  free(map);
+}
@@ -0,0 +1,380 @@
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "planner.h"
+#include "timer.h"
+
+const size_t PLANNER_BATCH_SIZE = 32; // rollouts between deadline checks
+const size_t ROLLOUT_GRAIN = 4; // rollouts per job chunk
+const size_t MAX_SEGMENT_TICKS = 20;
+const size_t TAP_TICKS = 3; // press and release length of a double tap
+
+// rollout scores
+const double HIT_REWARD = 1000;
+const double HIT_PENALTY = 1500;
+const double CRASH_PENALTY = 50;
+const double AIM_WEIGHT = 20;
+const double LATE_DISCOUNT = 0.5; // events at the horizon count this much less
+
+struct planner {
+  planner_params_t params;
+  job_pool_t *pool;
+  uint64_t rng;
+  size_t rollouts;
+
+  uint8_t *plan; // the best plan so far, one input per tick
+  uint8_t *candidates; // PLANNER_BATCH_SIZE plans
+  double *scores;
+
+  // working copies of the moving bodies, scratch_stride per candidate
+  planner_body_t *scratch;
+  size_t scratch_stride;
+
+  const planner_world_t *world; // only set during planner_plan()
+};
+
+/**
+ * xorshift64*, so candidates do not depend on, or disturb, rand().
+ */
+static uint64_t next_random(planner_t *planner) {
+  planner->rng ^= planner->rng >> 12;
+  planner->rng ^= planner->rng << 25;
+  planner->rng ^= planner->rng >> 27;
+  return planner->rng * 2685821657736338717ULL;
+}
+
+static size_t random_below(planner_t *planner, size_t n) {
+  return (size_t)(next_random(planner) % n);
+}
+
+planner_t *planner_init(planner_params_t params, job_pool_t *pool,
+                        unsigned int seed) {
+  assert(params.horizon > 0 && params.dt > 0);
+  planner_t *planner = malloc(sizeof(planner_t));
+  assert(planner);
+  planner->params = params;
+  planner->pool = pool;
+  planner->rng = ((uint64_t)seed << 1) | 1;
+  planner->rollouts = 0;
+  planner->plan = calloc(params.horizon, sizeof(uint8_t));
+  planner->candidates =
+      malloc(PLANNER_BATCH_SIZE * params.horizon * sizeof(uint8_t));
+  planner->scores = malloc(PLANNER_BATCH_SIZE * sizeof(double));
+  assert(planner->plan && planner->candidates && planner->scores);
+  planner->scratch = NULL;
+  planner->scratch_stride = 0;
+  planner->world = NULL;
+  return planner;
+}
+
+void planner_free(planner_t *planner) {
+  free(planner->plan);
+  free(planner->candidates);
+  free(planner->scores);
+  free(planner->scratch);
+  free(planner);
+}
+
+size_t planner_rollouts(planner_t *planner) { return planner->rollouts; }
+
+uint32_t planner_next_input(planner_t *planner) {
+  size_t horizon = planner->params.horizon;
+  uint32_t input = planner->plan[0];
+  memmove(planner->plan, planner->plan + 1, horizon - 1);
+  planner->plan[horizon - 1] = 0;
+  return input;
+}
+
+/**
+ * Fills plan[from, horizon) with random segments: idling, holding turn or
+ * double tapping to boost, each with or without holding shoot.
+ */
+static void random_segments(planner_t *planner, uint8_t *plan, size_t from) {
+  size_t horizon = planner->params.horizon;
+  size_t t = from;
+  while (t < horizon) {
+    uint8_t shoot = random_below(planner, 2) ? PLANNER_SHOOT : 0;
+    switch (random_below(planner, 3)) {
+    case 0:
+    case 1: {
+      uint8_t turn = random_below(planner, 2) ? PLANNER_TURN : 0;
+      size_t length = 1 + random_below(planner, MAX_SEGMENT_TICKS);
+      for (size_t i = 0; i < length && t < horizon; i++) {
+        plan[t++] = turn | shoot;
+      }
+      break;
+    }
+    default:
+      for (size_t i = 0; i < 4 * TAP_TICKS && t < horizon; i++) {
+        bool pressed = (i / TAP_TICKS) % 2 == 0;
+        plan[t++] = (pressed ? PLANNER_TURN : 0) | shoot;
+      }
+      break;
+    }
+  }
+}
+
+/**
+ * Writes the index-th candidate of a batch. The first batch starts with
+ * the previous plan and with doing nothing; after that, half of the
+ * candidates rewrite the tail of the best plan and half are new.
+ */
+static void make_candidate(planner_t *planner, uint8_t *candidate,
+                           size_t index, bool first_batch) {
+  size_t horizon = planner->params.horizon;
+  if (first_batch && index == 0) {
+    memcpy(candidate, planner->plan, horizon);
+  } else if (first_batch && index == 1) {
+    memset(candidate, 0, horizon);
+  } else if (index % 2 == 0) {
+    memcpy(candidate, planner->plan, horizon);
+    random_segments(planner, candidate, random_below(planner, horizon));
+  } else {
+    random_segments(planner, candidate, 0);
+  }
+}
+
+static vector_t heading(double angle) { return (vector_t){cos(angle), sin(angle)}; }
+
+static void move_ship(const planner_params_t *params, planner_body_t *ship,
+                      double *spin) {
+  vector_t force = vec_subtract(vec_multiply(params->thrust, heading(ship->angle)),
+                                vec_multiply(params->drag, ship->velocity));
+  ship->velocity = vec_add(ship->velocity,
+                           vec_multiply(params->dt / ship->mass, force));
+  ship->position =
+      vec_add(ship->position, vec_multiply(params->dt, ship->velocity));
+  ship->angle += *spin * params->dt;
+  *spin -= *spin * params->rot_drag * params->dt;
+}
+
+static bool in_box(const planner_box_t *box, vector_t p, double radius) {
+  return p.x + radius > box->min.x && p.x - radius < box->max.x &&
+         p.y + radius > box->min.y && p.y - radius < box->max.y;
+}
+
+static bool in_arena(const planner_world_t *world, vector_t p, double radius) {
+  return p.x - radius > world->min.x && p.x + radius < world->max.x &&
+         p.y - radius > world->min.y && p.y + radius < world->max.y;
+}
+
+static bool touching(const planner_body_t *a, const planner_body_t *b) {
+  vector_t d = vec_subtract(a->position, b->position);
+  double r = a->radius + b->radius;
+  return vec_dot(d, d) < r * r;
+}
+
+/**
+ * Reflects a body's velocity off the arena edges it is moving out through.
+ * Returns whether it hit one.
+ */
+static bool bounce_off_arena(const planner_world_t *world,
+                             planner_body_t *body) {
+  vector_t p = body->position;
+  double r = body->radius;
+  bool hit = false;
+  if ((p.x - r < world->min.x && body->velocity.x < 0) ||
+      (p.x + r > world->max.x && body->velocity.x > 0)) {
+    body->velocity.x = -body->velocity.x;
+    hit = true;
+  }
+  if ((p.y - r < world->min.y && body->velocity.y < 0) ||
+      (p.y + r > world->max.y && body->velocity.y > 0)) {
+    body->velocity.y = -body->velocity.y;
+    hit = true;
+  }
+  return hit;
+}
+
+/**
+ * Plays one candidate forward and scores it. The opponent is assumed to
+ * keep flying without turning or shooting.
+ */
+static double rollout(planner_t *planner, const uint8_t *plan,
+                      planner_body_t *scratch) {
+  const planner_params_t *params = &planner->params;
+  const planner_world_t *world = planner->world;
+  double dt = params->dt;
+  size_t horizon = params->horizon;
+
+  planner_body_t self = world->self;
+  planner_body_t target = world->target;
+  double self_spin = 0;
+  double target_spin = 0;
+  planner_body_t *asteroids = scratch;
+  size_t num_asteroids = world->num_asteroids;
+  memcpy(asteroids, world->asteroids, num_asteroids * sizeof(planner_body_t));
+  planner_body_t *bullets = scratch + num_asteroids;
+  size_t num_bullets = world->num_bullets;
+  memcpy(bullets, world->bullets, num_bullets * sizeof(planner_body_t));
+
+  bool turn_held = world->turn_held;
+  double pressed_at = -world->time_since_turn_press;
+  double released_at = -world->time_since_turn_release;
+  double shot_at = -world->time_since_shot;
+  double score = 0;
+
+  for (size_t t = 0; t < horizon; t++) {
+    double now = t * dt;
+    double discount = 1 - LATE_DISCOUNT * t / horizon;
+
+    // the same key handling as the game's handle_turn_key and handle_shoot
+    if (plan[t] & PLANNER_TURN) {
+      if (!turn_held) {
+        pressed_at = now;
+      }
+      turn_held = true;
+      double time_held = fmax(dt, now - pressed_at);
+      double rot_speed = params->rot_speed *
+                         fmin(2, 1 + log(time_held * params->rot_accel + 1));
+      self.angle += rot_speed * dt;
+    } else if (turn_held) {
+      turn_held = false;
+      if (now - released_at < params->double_tap_time) {
+        self.velocity = vec_add(
+            self.velocity,
+            vec_multiply(params->boost_velocity,
+                         heading(self.angle + params->boost_angle)));
+        self_spin += params->boost_rot_speed;
+      }
+      released_at = now;
+    }
+    if ((plan[t] & PLANNER_SHOOT) && now - shot_at >= params->reload_time) {
+      shot_at = now;
+      vector_t direction = heading(self.angle);
+      bullets[num_bullets++] = (planner_body_t){
+          .position = vec_add(self.position,
+                              vec_multiply(params->ship_height, direction)),
+          .velocity = vec_multiply(params->bullet_speed, direction),
+          .radius = params->bullet_radius};
+    }
+
+    move_ship(params, &self, &self_spin);
+    move_ship(params, &target, &target_spin);
+    for (size_t i = 0; i < num_asteroids; i++) {
+      planner_body_t *asteroid = &asteroids[i];
+      asteroid->velocity =
+          vec_multiply(1 - params->drag / asteroid->mass * dt,
+                       asteroid->velocity);
+      asteroid->position = vec_add(asteroid->position,
+                                   vec_multiply(dt, asteroid->velocity));
+      bounce_off_arena(world, asteroid);
+    }
+
+    size_t i = 0;
+    while (i < num_bullets) {
+      planner_body_t *bullet = &bullets[i];
+      bullet->position =
+          vec_add(bullet->position, vec_multiply(dt, bullet->velocity));
+      if (touching(bullet, &self)) {
+        return score - HIT_PENALTY * discount;
+      }
+      if (touching(bullet, &target)) {
+        return score + HIT_REWARD * discount;
+      }
+      bool gone = !in_arena(world, bullet->position, 0);
+      for (size_t j = 0; !gone && j < world->num_obstacles; j++) {
+        gone = in_box(&world->obstacles[j], bullet->position, bullet->radius);
+      }
+      for (size_t j = 0; !gone && j < num_asteroids; j++) {
+        gone = touching(bullet, &asteroids[j]);
+      }
+      if (gone) {
+        *bullet = bullets[--num_bullets];
+      } else {
+        i++;
+      }
+    }
+
+    bool crashed = bounce_off_arena(world, &self);
+    for (size_t j = 0; !crashed && j < world->num_obstacles; j++) {
+      if (in_box(&world->obstacles[j], self.position, self.radius)) {
+        self.velocity = vec_negate(self.velocity);
+        crashed = true;
+      }
+    }
+    for (size_t j = 0; !crashed && j < num_asteroids; j++) {
+      if (touching(&self, &asteroids[j])) {
+        self.velocity = vec_negate(self.velocity);
+        crashed = true;
+      }
+    }
+    if (crashed) {
+      score -= CRASH_PENALTY * discount;
+    }
+  }
+
+  // prefer ending up pointed at the opponent, ready for the next shot
+  vector_t to_target = vec_subtract(target.position, self.position);
+  double distance = sqrt(vec_dot(to_target, to_target));
+  if (distance > 0) {
+    score += AIM_WEIGHT * vec_dot(heading(self.angle), to_target) / distance;
+  }
+  return score;
+}
+
+static void rollout_job(void *aux, size_t start, size_t end) {
+  planner_t *planner = aux;
+  size_t horizon = planner->params.horizon;
+  for (size_t i = start; i < end; i++) {
+    planner->scores[i] =
+        rollout(planner, planner->candidates + i * horizon,
+                planner->scratch + i * planner->scratch_stride);
+  }
+}
+
+/**
+ * Makes sure each candidate's scratch space fits the bodies in `world`
+ * plus every bullet the bot could fire within the horizon.
+ */
+static void reserve_scratch(planner_t *planner, const planner_world_t *world) {
+  const planner_params_t *params = &planner->params;
+  size_t max_shots =
+      (size_t)(params->horizon * params->dt / params->reload_time) + 2;
+  size_t stride = world->num_asteroids + world->num_bullets + max_shots;
+  if (stride > planner->scratch_stride) {
+    planner->scratch_stride = stride * 2;
+    free(planner->scratch);
+    planner->scratch = malloc(PLANNER_BATCH_SIZE * planner->scratch_stride *
+                              sizeof(planner_body_t));
+    assert(planner->scratch);
+  }
+}
+
+void planner_plan(planner_t *planner, const planner_world_t *world,
+                  double deadline, size_t max_rollouts) {
+  size_t horizon = planner->params.horizon;
+  planner->world = world;
+  reserve_scratch(planner, world);
+
+  double best_score = -INFINITY;
+  size_t rollouts = 0;
+  bool first_batch = true;
+  // the first batch always runs, so the kept plan is rescored against the
+  // current world even when the budget is already spent
+  while (rollouts < max_rollouts && (first_batch || timer_now() < deadline)) {
+    size_t batch = max_rollouts - rollouts < PLANNER_BATCH_SIZE
+                       ? max_rollouts - rollouts
+                       : PLANNER_BATCH_SIZE;
+    for (size_t i = 0; i < batch; i++) {
+      make_candidate(planner, planner->candidates + i * horizon, i,
+                     first_batch);
+    }
+    job_pool_run(planner->pool, batch, ROLLOUT_GRAIN, rollout_job, planner);
+    // ties go to the earliest candidate, so the result is independent of
+    // which thread finished first
+    for (size_t i = 0; i < batch; i++) {
+      if (planner->scores[i] > best_score) {
+        best_score = planner->scores[i];
+        memcpy(planner->plan, planner->candidates + i * horizon, horizon);
+      }
+    }
+    rollouts += batch;
+    first_batch = false;
+  }
+
+  planner->rollouts += rollouts;
+  planner->world = NULL;
+}
@@ -0,0 +1,230 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL_image.h>
+
+#include "preloader.h"
+
+const size_t INITIAL_PRELOAD_CAPACITY = 16;
+
+typedef enum item_status {
+  ITEM_QUEUED,
+  ITEM_DECODING,
+  ITEM_DECODED,
+  ITEM_DELIVERED
+} item_status_t;
+
+typedef struct item {
+  preload_result_t result;
+  item_status_t status;
+} item_t;
+
+struct preloader {
+  pthread_t *threads;
+  size_t num_threads; // the workers that actually started
+
+  // guards everything below; items are only appended
+  pthread_mutex_t lock;
+  pthread_cond_t queued; // signalled when a file is requested
+  pthread_cond_t decoded; // signalled when a file is decoded
+  item_t *items;
+  size_t num_items;
+  size_t capacity;
+  size_t next_queued; // items before this have been taken by a decoder
+  size_t next_delivered; // items before this have been handed back
+  size_t num_decoded;
+  bool stopping;
+};
+
+/**
+ * Decodes one file. Runs without the lock held.
+ */
+static void decode(preload_result_t *result) {
+  switch (result->type) {
+    case PRELOAD_IMAGE: {
+      SDL_Surface *loaded = IMG_Load(result->path);
+      if (loaded != NULL) {
+        result->image =
+            SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_RGBA32, 0);
+        SDL_FreeSurface(loaded);
+      }
+      break;
+    }
+    case PRELOAD_SOUND:
+      result->sound = Mix_LoadWAV_RW(SDL_RWFromFile(result->path, "rb"), 1);
+      break;
+    case PRELOAD_MUSIC:
+      result->music = Mix_LoadMUS(result->path);
+      break;
+  }
+}
+
+/**
+ * Takes the next queued file, decodes it and stores the result. Called
+ * with the lock held, which it releases while decoding.
+ */
+static void decode_next(preloader_t *preloader) {
+  size_t i = preloader->next_queued++;
+  preloader->items[i].status = ITEM_DECODING;
+  // the items array can move while unlocked, so decode a copy
+  preload_result_t result = preloader->items[i].result;
+  pthread_mutex_unlock(&preloader->lock);
+  decode(&result);
+  pthread_mutex_lock(&preloader->lock);
+  preloader->items[i].result = result;
+  preloader->items[i].status = ITEM_DECODED;
+  preloader->num_decoded++;
+  pthread_cond_broadcast(&preloader->decoded);
+}
+
+static void *worker_main(void *aux) {
+  preloader_t *preloader = aux;
+  pthread_mutex_lock(&preloader->lock);
+  while (true) {
+    while (!preloader->stopping &&
+           preloader->next_queued == preloader->num_items) {
+      pthread_cond_wait(&preloader->queued, &preloader->lock);
+    }
+    if (preloader->stopping) {
+      break;
+    }
+    decode_next(preloader);
+  }
+  pthread_mutex_unlock(&preloader->lock);
+  return NULL;
+}
+
+preloader_t *preloader_init(size_t num_threads) {
+  preloader_t *preloader = malloc(sizeof(preloader_t));
+  assert(preloader);
+  pthread_mutex_init(&preloader->lock, NULL);
+  pthread_cond_init(&preloader->queued, NULL);
+  pthread_cond_init(&preloader->decoded, NULL);
+  preloader->capacity = INITIAL_PRELOAD_CAPACITY;
+  preloader->items = malloc(preloader->capacity * sizeof(item_t));
+  assert(preloader->items);
+  preloader->num_items = 0;
+  preloader->next_queued = 0;
+  preloader->next_delivered = 0;
+  preloader->num_decoded = 0;
+  preloader->stopping = false;
+
+  // builds without threads fail to create them, leaving no workers
+  preloader->threads = malloc(num_threads * sizeof(pthread_t));
+  assert(num_threads == 0 || preloader->threads);
+  preloader->num_threads = 0;
+  for (size_t i = 0; i < num_threads; i++) {
+    if (pthread_create(&preloader->threads[preloader->num_threads], NULL,
+                       worker_main, preloader) == 0) {
+      preloader->num_threads++;
+    }
+  }
+  return preloader;
+}
+
+void preloader_free(preloader_t *preloader) {
+  pthread_mutex_lock(&preloader->lock);
+  preloader->stopping = true;
+  pthread_cond_broadcast(&preloader->queued);
+  pthread_mutex_unlock(&preloader->lock);
+  for (size_t i = 0; i < preloader->num_threads; i++) {
+    pthread_join(preloader->threads[i], NULL);
+  }
+
+  for (size_t i = 0; i < preloader->num_items; i++) {
+    item_t *item = &preloader->items[i];
+    if (item->status == ITEM_DECODED) {
+      if (item->result.image != NULL) {
+        SDL_FreeSurface(item->result.image);
+      }
+      if (item->result.sound != NULL) {
+        Mix_FreeChunk(item->result.sound);
+      }
+      if (item->result.music != NULL) {
+        Mix_FreeMusic(item->result.music);
+      }
+    }
+    free((char *)item->result.path);
+  }
+  pthread_mutex_destroy(&preloader->lock);
+  pthread_cond_destroy(&preloader->queued);
+  pthread_cond_destroy(&preloader->decoded);
+  free(preloader->items);
+  free(preloader->threads);
+  free(preloader);
+}
+
+void preloader_request(preloader_t *preloader, const char *path,
+                       preload_type_t type) {
+  pthread_mutex_lock(&preloader->lock);
+  for (size_t i = 0; i < preloader->num_items; i++) {
+    if (strcmp(preloader->items[i].result.path, path) == 0) {
+      pthread_mutex_unlock(&preloader->lock);
+      return;
+    }
+  }
+  if (preloader->num_items == preloader->capacity) {
+    preloader->capacity *= 2;
+    preloader->items =
+        realloc(preloader->items, preloader->capacity * sizeof(item_t));
+    assert(preloader->items);
+  }
+  char *copy = strdup(path);
+  assert(copy);
+  preloader->items[preloader->num_items++] = (item_t){
+      .result = {.path = copy, .type = type},
+      .status = ITEM_QUEUED};
+  pthread_cond_signal(&preloader->queued);
+  pthread_mutex_unlock(&preloader->lock);
+}
+
+void preloader_step(preloader_t *preloader) {
+  if (preloader->num_threads > 0) {
+    return;
+  }
+  pthread_mutex_lock(&preloader->lock);
+  if (preloader->next_queued < preloader->num_items) {
+    decode_next(preloader);
+  }
+  pthread_mutex_unlock(&preloader->lock);
+}
+
+void preloader_finish(preloader_t *preloader) {
+  pthread_mutex_lock(&preloader->lock);
+  while (preloader->num_decoded < preloader->num_items) {
+    // help out rather than wait, which also covers having no workers
+    if (preloader->next_queued < preloader->num_items) {
+      decode_next(preloader);
+    } else {
+      pthread_cond_wait(&preloader->decoded, &preloader->lock);
+    }
+  }
+  pthread_mutex_unlock(&preloader->lock);
+}
+
+bool preloader_poll(preloader_t *preloader, preload_result_t *result) {
+  pthread_mutex_lock(&preloader->lock);
+  // hand files back in request order, so the first ones requested are
+  // usable as early as possible
+  bool found = false;
+  if (preloader->next_delivered < preloader->num_items) {
+    item_t *item = &preloader->items[preloader->next_delivered];
+    if (item->status == ITEM_DECODED) {
+      *result = item->result;
+      item->status = ITEM_DELIVERED;
+      preloader->next_delivered++;
+      found = true;
+    }
+  }
+  pthread_mutex_unlock(&preloader->lock);
+  return found;
+}
+
+void preloader_progress(preloader_t *preloader, size_t *decoded,
+                        size_t *requested) {
+  pthread_mutex_lock(&preloader->lock);
+  *decoded = preloader->num_decoded;
+  *requested = preloader->num_items;
+  pthread_mutex_unlock(&preloader->lock);
+}
@@ -0,0 +1,124 @@
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "profiler.h"
+
+const char *PROFILE_PHASE_NAMES[] = {
+  "frame", "tick", "input", "broadphase", "narrowphase", "handlers",
+  "scene_tick", "bot", "planner", "background", "bodies", "scores",
+  "overlay", "show", "job"
+};
+
+static profile_event_t *events = NULL;
+static size_t capacity = 0;
+// events ever recorded; event i lives in events[i % capacity]
+static atomic_size_t num_recorded;
+static _Thread_local uint32_t thread_id = 0;
+
+void profiler_init(size_t new_capacity) {
+  assert(new_capacity > 0);
+  free(events);
+  events = malloc(new_capacity * sizeof(profile_event_t));
+  assert(events);
+  capacity = new_capacity;
+  atomic_store(&num_recorded, 0);
+}
+
+void profiler_free(void) {
+  free(events);
+  events = NULL;
+  capacity = 0;
+}
+
+void profiler_set_thread(uint32_t thread) { thread_id = thread; }
+
+void profiler_record(profile_phase_t phase, double start, double end) {
+  if (events == NULL) {
+    return;
+  }
+  size_t i =
+      atomic_fetch_add_explicit(&num_recorded, 1, memory_order_relaxed);
+  events[i % capacity] = (profile_event_t){
+      .phase = phase, .thread = thread_id, .start = start, .end = end};
+}
+
+const char *profiler_phase_name(profile_phase_t phase) {
+  assert(phase < NUM_PROFILE_PHASES);
+  return PROFILE_PHASE_NAMES[phase];
+}
+
+/**
+ * Gets the range [first, last) of event numbers still in the buffer.
+ */
+static void recorded_range(size_t *first, size_t *last) {
+  *last = events != NULL ? atomic_load(&num_recorded) : 0;
+  *first = *last > capacity ? *last - capacity : 0;
+}
+
+size_t profiler_frame_times(double *times, size_t max) {
+  size_t first, last;
+  recorded_range(&first, &last);
+  // collect newest first from the back of `times`, then slide to the front
+  size_t count = 0;
+  for (size_t i = last; i > first && count < max; i--) {
+    profile_event_t event = events[(i - 1) % capacity];
+    if (event.phase == PROFILE_FRAME) {
+      times[max - 1 - count++] = event.end - event.start;
+    }
+  }
+  memmove(times, times + max - count, count * sizeof(double));
+  return count;
+}
+
+bool profiler_phase_times(double *seconds) {
+  for (size_t phase = 0; phase < NUM_PROFILE_PHASES; phase++) {
+    seconds[phase] = 0;
+  }
+  size_t first, last;
+  recorded_range(&first, &last);
+  size_t i = last;
+  while (i > first && events[(i - 1) % capacity].phase != PROFILE_FRAME) {
+    i--;
+  }
+  if (i == first) {
+    return false;
+  }
+
+  // a frame's phases end before it does, so they come just before it
+  profile_event_t frame = events[--i % capacity];
+  seconds[PROFILE_FRAME] = frame.end - frame.start;
+  for (; i > first; i--) {
+    profile_event_t event = events[(i - 1) % capacity];
+    if (event.phase == PROFILE_FRAME) {
+      break;
+    }
+    if (event.start >= frame.start) {
+      seconds[event.phase] += event.end - event.start;
+    }
+  }
+  return true;
+}
+
+bool profiler_export_trace(const char *path) {
+  FILE *file = fopen(path, "w");
+  if (file == NULL) {
+    return false;
+  }
+  size_t first, last;
+  recorded_range(&first, &last);
+  fprintf(file, "{\"traceEvents\": [\n");
+  for (size_t i = first; i < last; i++) {
+    profile_event_t event = events[i % capacity];
+    fprintf(file,
+            "  {\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, "
+            "\"ts\": %.3f, \"dur\": %.3f}%s\n",
+            profiler_phase_name(event.phase), event.thread,
+            event.start * 1e6, (event.end - event.start) * 1e6,
+            i + 1 < last ? "," : "");
+  }
+  fprintf(file, "], \"displayTimeUnit\": \"ms\"}\n");
+  return fclose(file) == 0;
+}
@@ -0,0 +1,165 @@
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include "render_batch.h"
+#include "renderer.h"
+
+const size_t INITIAL_BATCH_VERTICES = 1024;
+
+typedef struct geometry {
+  SDL_Vertex *vertices;
+  size_t num_vertices;
+  size_t vertex_capacity;
+  int *indices;
+  size_t num_indices;
+  size_t index_capacity;
+} geometry_t;
+
+struct render_batch {
+  SDL_Renderer *renderer;
+
+  // scene to pixel transform set by render_batch_begin()
+  vector_t cam_center;
+  vector_t window_center;
+  double scale;
+
+  geometry_t opaque;
+  geometry_t blended;
+};
+
+static void geometry_init(geometry_t *geometry) {
+  geometry->vertex_capacity = INITIAL_BATCH_VERTICES;
+  geometry->vertices = malloc(geometry->vertex_capacity * sizeof(SDL_Vertex));
+  geometry->index_capacity = 3 * INITIAL_BATCH_VERTICES;
+  geometry->indices = malloc(geometry->index_capacity * sizeof(int));
+  assert(geometry->vertices && geometry->indices);
+  geometry->num_vertices = 0;
+  geometry->num_indices = 0;
+}
+
+static void geometry_reserve(geometry_t *geometry, size_t vertices,
+                             size_t indices) {
+  if (geometry->num_vertices + vertices > geometry->vertex_capacity) {
+    while (geometry->num_vertices + vertices > geometry->vertex_capacity) {
+      geometry->vertex_capacity *= 2;
+    }
+    geometry->vertices = realloc(geometry->vertices,
+                                 geometry->vertex_capacity * sizeof(SDL_Vertex));
+    assert(geometry->vertices);
+  }
+  if (geometry->num_indices + indices > geometry->index_capacity) {
+    while (geometry->num_indices + indices > geometry->index_capacity) {
+      geometry->index_capacity *= 2;
+    }
+    geometry->indices =
+        realloc(geometry->indices, geometry->index_capacity * sizeof(int));
+    assert(geometry->indices);
+  }
+}
+
+render_batch_t *render_batch_init(void) {
+  render_batch_t *batch = malloc(sizeof(render_batch_t));
+  assert(batch);
+  batch->renderer = renderer_get();
+  batch->cam_center = VEC_ZERO;
+  batch->window_center = VEC_ZERO;
+  batch->scale = 1;
+  geometry_init(&batch->opaque);
+  geometry_init(&batch->blended);
+  return batch;
+}
+
+void render_batch_free(render_batch_t *batch) {
+  free(batch->opaque.vertices);
+  free(batch->opaque.indices);
+  free(batch->blended.vertices);
+  free(batch->blended.indices);
+  free(batch);
+}
+
+bool render_batch_is_available(render_batch_t *batch) {
+  return batch->renderer != NULL;
+}
+
+void render_batch_begin(render_batch_t *batch, vector_t cam_center,
+                        vector_t cam_size) {
+  int width = 0;
+  int height = 0;
+  if (batch->renderer != NULL) {
+    SDL_GetRendererOutputSize(batch->renderer, &width, &height);
+  }
+  batch->cam_center = cam_center;
+  batch->window_center = (vector_t){width / 2.0, height / 2.0};
+  double x_scale = batch->window_center.x / (cam_size.x / 2);
+  double y_scale = batch->window_center.y / (cam_size.y / 2);
+  batch->scale = fmin(x_scale, y_scale);
+
+  batch->opaque.num_vertices = 0;
+  batch->opaque.num_indices = 0;
+  batch->blended.num_vertices = 0;
+  batch->blended.num_indices = 0;
+}
+
+void render_batch_get_view(render_batch_t *batch, vector_t *min,
+                           vector_t *max) {
+  vector_t half_size = vec_multiply(1 / batch->scale, batch->window_center);
+  *min = vec_subtract(batch->cam_center, half_size);
+  *max = vec_add(batch->cam_center, half_size);
+}
+
+void render_batch_add_polygon(render_batch_t *batch, const double *xs,
+                              const double *ys, size_t num_vertices,
+                              rgb_color_t color, Uint8 alpha) {
+  if (num_vertices < 3) {
+    return;
+  }
+  geometry_t *geometry = alpha == 255 ? &batch->opaque : &batch->blended;
+  geometry_reserve(geometry, num_vertices, 3 * (num_vertices - 2));
+
+  SDL_Color sdl_color = {.r = (Uint8)(color.r * 255),
+                         .g = (Uint8)(color.g * 255),
+                         .b = (Uint8)(color.b * 255),
+                         .a = alpha};
+  int first = (int)geometry->num_vertices;
+  SDL_Vertex *vertices = geometry->vertices + geometry->num_vertices;
+  for (size_t i = 0; i < num_vertices; i++) {
+    // scene y points up, window y points down
+    double px = batch->window_center.x +
+                batch->scale * (xs[i] - batch->cam_center.x);
+    double py = batch->window_center.y -
+                batch->scale * (ys[i] - batch->cam_center.y);
+    vertices[i] = (SDL_Vertex){.position = {(float)px, (float)py},
+                               .color = sdl_color,
+                               .tex_coord = {0, 0}};
+  }
+  geometry->num_vertices += num_vertices;
+
+  // convex polygons triangulate as a fan around their first vertex
+  int *indices = geometry->indices + geometry->num_indices;
+  for (size_t i = 1; i + 1 < num_vertices; i++) {
+    *indices++ = first;
+    *indices++ = first + (int)i;
+    *indices++ = first + (int)i + 1;
+  }
+  geometry->num_indices += 3 * (num_vertices - 2);
+}
+
+static void submit(SDL_Renderer *renderer, geometry_t *geometry,
+                   SDL_BlendMode blend_mode) {
+  if (geometry->num_indices == 0) {
+    return;
+  }
+  SDL_SetRenderDrawBlendMode(renderer, blend_mode);
+  SDL_RenderGeometry(renderer, NULL, geometry->vertices,
+                     (int)geometry->num_vertices, geometry->indices,
+                     (int)geometry->num_indices);
+}
+
+void render_batch_flush(render_batch_t *batch) {
+  if (batch->renderer == NULL) {
+    return;
+  }
+  submit(batch->renderer, &batch->opaque, SDL_BLENDMODE_NONE);
+  submit(batch->renderer, &batch->blended, SDL_BLENDMODE_BLEND);
+}
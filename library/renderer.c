@@ -0,0 +1,11 @@
+#include <stddef.h>
+
+#include "renderer.h"
+
+// SDL numbers windows from 1, and the game only ever opens one
+const Uint32 GAME_WINDOW_ID = 1;
+
+SDL_Renderer *renderer_get(void) {
+  SDL_Window *window = SDL_GetWindowFromID(GAME_WINDOW_ID);
+  return window != NULL ? SDL_GetRenderer(window) : NULL;
+}
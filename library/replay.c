@@ -0,0 +1,423 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "replay.h"
+#include "sim.h"
+#include "snapshot.h"
+
+const char REPLAY_MAGIC[4] = {'R', 'P', 'L', 'Y'};
+const uint32_t REPLAY_VERSION = 1;
+const size_t REPLAY_KEYFRAME_INTERVAL = 600; // ticks, 10 s at 60 Hz
+const uint32_t MAX_RECORDED_INPUT = 0xf;
+const size_t INITIAL_REPLAY_CAPACITY = 1024;
+// longer replays are taken to be corrupt; a day at 60 Hz, one byte per tick
+const uint64_t MAX_REPLAY_TICKS = 24 * 60 * 60 * 60;
+
+/**
+ * After the header, the file is a sequence of records, each starting with
+ * a tag byte. An input record's tag holds the input mask in its low 4 bits
+ * and is followed by the number of ticks it was held. A keyframe record's
+ * tag is followed by its tick and a snapshot_delta() against the previous
+ * keyframe, or against an empty snapshot for the first one. Integers are
+ * little-endian; counts and sizes are LEB128 varints.
+ */
+typedef enum record_tag {
+  RECORD_INPUT = 0x10,
+  RECORD_KEYFRAME = 0x20
+} record_tag_t;
+
+struct replay_writer {
+  FILE *file;
+  size_t map;
+  unsigned int seed;
+  double dt;
+  size_t num_ticks;
+
+  // the input being held, not yet written
+  uint32_t run_input;
+  size_t run_length;
+
+  snapshot_t *keyframe;
+  snapshot_t *prev_keyframe;
+  snapshot_t *delta;
+};
+
+typedef struct keyframe {
+  size_t tick;
+  snapshot_t *snapshot;
+} keyframe_t;
+
+struct replay {
+  size_t map;
+  unsigned int seed;
+  double dt;
+
+  uint8_t *inputs; // one mask per tick
+  size_t num_ticks;
+  keyframe_t *keyframes; // in order of tick
+  size_t num_keyframes;
+
+  state_t *state;
+  size_t tick;
+};
+
+static void write_u8(FILE *file, uint8_t value) { fputc(value, file); }
+
+static void write_u32(FILE *file, uint32_t value) {
+  for (size_t i = 0; i < 4; i++) {
+    write_u8(file, value >> (8 * i));
+  }
+}
+
+static void write_u64(FILE *file, uint64_t value) {
+  for (size_t i = 0; i < 8; i++) {
+    write_u8(file, value >> (8 * i));
+  }
+}
+
+static void write_varint(FILE *file, uint64_t value) {
+  while (value >= 0x80) {
+    write_u8(file, (value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  write_u8(file, value);
+}
+
+static void write_header(replay_writer_t *writer) {
+  uint64_t dt_bits;
+  memcpy(&dt_bits, &writer->dt, sizeof(dt_bits));
+  fwrite(REPLAY_MAGIC, 1, sizeof(REPLAY_MAGIC), writer->file);
+  write_u32(writer->file, REPLAY_VERSION);
+  write_u32(writer->file, writer->map);
+  write_u32(writer->file, writer->seed);
+  write_u64(writer->file, dt_bits);
+}
+
+static void flush_run(replay_writer_t *writer) {
+  if (writer->run_length == 0) {
+    return;
+  }
+  write_u8(writer->file, RECORD_INPUT | writer->run_input);
+  write_varint(writer->file, writer->run_length);
+  writer->run_length = 0;
+}
+
+static void write_keyframe(replay_writer_t *writer, state_t *state) {
+  flush_run(writer);
+  sim_snapshot(state, writer->keyframe);
+  snapshot_delta(writer->prev_keyframe, writer->keyframe, writer->delta);
+  write_u8(writer->file, RECORD_KEYFRAME);
+  write_varint(writer->file, writer->num_ticks);
+  write_varint(writer->file, snapshot_size(writer->delta));
+  fwrite(snapshot_data(writer->delta), 1, snapshot_size(writer->delta),
+         writer->file);
+  fflush(writer->file);
+
+  snapshot_t *prev = writer->prev_keyframe;
+  writer->prev_keyframe = writer->keyframe;
+  writer->keyframe = prev;
+}
+
+replay_writer_t *replay_writer_init(const char *path, size_t map,
+                                    unsigned int seed) {
+  FILE *file = fopen(path, "wb");
+  if (file == NULL) {
+    return NULL;
+  }
+  replay_writer_t *writer = malloc(sizeof(replay_writer_t));
+  assert(writer);
+  writer->file = file;
+  writer->map = map;
+  writer->seed = seed;
+  writer->dt = 0;
+  writer->num_ticks = 0;
+  writer->run_input = 0;
+  writer->run_length = 0;
+  writer->keyframe = snapshot_init(0);
+  writer->prev_keyframe = snapshot_init(0);
+  writer->delta = snapshot_init(0);
+  return writer;
+}
+
+void replay_writer_free(replay_writer_t *writer) {
+  flush_run(writer);
+  fclose(writer->file);
+  snapshot_free(writer->keyframe);
+  snapshot_free(writer->prev_keyframe);
+  snapshot_free(writer->delta);
+  free(writer);
+}
+
+void replay_writer_record(replay_writer_t *writer, state_t *state,
+                          uint32_t input, double dt) {
+  assert(input <= MAX_RECORDED_INPUT);
+  if (writer->num_ticks == 0) {
+    // the header waits for the first tick, which sets the timestep
+    writer->dt = dt;
+    write_header(writer);
+  }
+  assert(dt == writer->dt);
+  if (writer->num_ticks % REPLAY_KEYFRAME_INTERVAL == 0) {
+    write_keyframe(writer, state);
+  }
+  if (writer->run_length > 0 && input != writer->run_input) {
+    flush_run(writer);
+  }
+  writer->run_input = input;
+  writer->run_length++;
+  writer->num_ticks++;
+}
+
+/**
+ * A cursor over the bytes of a replay file. Every read fails once the
+ * file runs out, so a truncated record is simply the end of the replay.
+ */
+typedef struct reader {
+  const uint8_t *data;
+  size_t size;
+  size_t pos;
+} reader_t;
+
+static bool read_u8(reader_t *reader, uint8_t *value) {
+  if (reader->pos >= reader->size) {
+    return false;
+  }
+  *value = reader->data[reader->pos++];
+  return true;
+}
+
+static bool read_uint(reader_t *reader, size_t num_bytes, uint64_t *value) {
+  *value = 0;
+  for (size_t i = 0; i < num_bytes; i++) {
+    uint8_t byte;
+    if (!read_u8(reader, &byte)) {
+      return false;
+    }
+    *value |= (uint64_t)byte << (8 * i);
+  }
+  return true;
+}
+
+static bool read_varint(reader_t *reader, uint64_t *value) {
+  *value = 0;
+  for (size_t shift = 0; shift < 64; shift += 7) {
+    uint8_t byte;
+    if (!read_u8(reader, &byte)) {
+      return false;
+    }
+    *value |= (uint64_t)(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool read_header(reader_t *reader, replay_t *replay) {
+  uint64_t version, map, seed, dt_bits;
+  if (reader->size < sizeof(REPLAY_MAGIC) ||
+      memcmp(reader->data, REPLAY_MAGIC, sizeof(REPLAY_MAGIC)) != 0) {
+    return false;
+  }
+  reader->pos = sizeof(REPLAY_MAGIC);
+  if (!read_uint(reader, 4, &version) || version != REPLAY_VERSION ||
+      !read_uint(reader, 4, &map) || !read_uint(reader, 4, &seed) ||
+      !read_uint(reader, 8, &dt_bits)) {
+    return false;
+  }
+  replay->map = map;
+  replay->seed = seed;
+  memcpy(&replay->dt, &dt_bits, sizeof(replay->dt));
+  return map < sim_num_maps() && replay->dt > 0;
+}
+
+static bool read_input_run(reader_t *reader, replay_t *replay,
+                           uint32_t input, size_t *capacity) {
+  uint64_t length;
+  if (!read_varint(reader, &length) || length == 0 ||
+      length > MAX_REPLAY_TICKS - replay->num_ticks) {
+    return false;
+  }
+  if (replay->num_ticks + length > *capacity) {
+    size_t new_capacity = *capacity;
+    while (replay->num_ticks + length > new_capacity) {
+      new_capacity *= 2;
+    }
+    uint8_t *inputs = realloc(replay->inputs, new_capacity);
+    if (inputs == NULL) {
+      return false;
+    }
+    replay->inputs = inputs;
+    *capacity = new_capacity;
+  }
+  memset(replay->inputs + replay->num_ticks, input, length);
+  replay->num_ticks += length;
+  return true;
+}
+
+static bool read_keyframe(reader_t *reader, replay_t *replay,
+                          snapshot_t *delta, size_t *capacity) {
+  uint64_t tick, size;
+  if (!read_varint(reader, &tick) || tick != replay->num_ticks ||
+      !read_varint(reader, &size) || size % sizeof(uint64_t) != 0 ||
+      size > reader->size - reader->pos) {
+    return false;
+  }
+  snapshot_load(delta, reader->data + reader->pos, size);
+  reader->pos += size;
+
+  snapshot_t *snapshot = snapshot_init(0);
+  snapshot_t *base = replay->num_keyframes > 0
+                         ? replay->keyframes[replay->num_keyframes - 1].snapshot
+                         : NULL;
+  snapshot_t *empty = base == NULL ? snapshot_init(0) : NULL;
+  bool valid = snapshot_apply_delta(base != NULL ? base : empty, delta,
+                                    snapshot);
+  if (empty != NULL) {
+    snapshot_free(empty);
+  }
+  if (!valid) {
+    snapshot_free(snapshot);
+    return false;
+  }
+
+  if (replay->num_keyframes == *capacity) {
+    keyframe_t *keyframes =
+        realloc(replay->keyframes, 2 * *capacity * sizeof(keyframe_t));
+    if (keyframes == NULL) {
+      snapshot_free(snapshot);
+      return false;
+    }
+    replay->keyframes = keyframes;
+    *capacity *= 2;
+  }
+  replay->keyframes[replay->num_keyframes++] =
+      (keyframe_t){.tick = tick, .snapshot = snapshot};
+  return true;
+}
+
+/**
+ * Reads records until the end of the file or the first one that is
+ * truncated or malformed.
+ */
+static void read_records(reader_t *reader, replay_t *replay) {
+  size_t input_capacity = INITIAL_REPLAY_CAPACITY;
+  size_t keyframe_capacity = 1;
+  replay->inputs = malloc(input_capacity);
+  replay->keyframes = malloc(keyframe_capacity * sizeof(keyframe_t));
+  assert(replay->inputs && replay->keyframes);
+  snapshot_t *delta = snapshot_init(0);
+
+  uint8_t tag;
+  bool valid = true;
+  while (valid && read_u8(reader, &tag)) {
+    switch (tag & ~MAX_RECORDED_INPUT) {
+    case RECORD_INPUT:
+      valid = read_input_run(reader, replay, tag & MAX_RECORDED_INPUT,
+                             &input_capacity);
+      break;
+    case RECORD_KEYFRAME:
+      valid = tag == RECORD_KEYFRAME &&
+              read_keyframe(reader, replay, delta, &keyframe_capacity);
+      break;
+    default:
+      valid = false;
+      break;
+    }
+  }
+  snapshot_free(delta);
+}
+
+replay_t *replay_load(const char *path) {
+  FILE *file = fopen(path, "rb");
+  if (file == NULL) {
+    return NULL;
+  }
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  uint8_t *data = malloc(size > 0 ? size : 1);
+  assert(data);
+  size_t num_read = fread(data, 1, size > 0 ? size : 0, file);
+  fclose(file);
+
+  replay_t *replay = malloc(sizeof(replay_t));
+  assert(replay);
+  reader_t reader = {.data = data, .size = num_read, .pos = 0};
+  if (!read_header(&reader, replay)) {
+    free(data);
+    free(replay);
+    return NULL;
+  }
+  replay->num_ticks = 0;
+  replay->num_keyframes = 0;
+  read_records(&reader, replay);
+  free(data);
+
+  replay->state = sim_init(replay->map, replay->seed, OPPONENT_PLAYER);
+  replay->tick = 0;
+  return replay;
+}
+
+void replay_free(replay_t *replay) {
+  for (size_t i = 0; i < replay->num_keyframes; i++) {
+    snapshot_free(replay->keyframes[i].snapshot);
+  }
+  free(replay->keyframes);
+  free(replay->inputs);
+  sim_free(replay->state);
+  free(replay);
+}
+
+size_t replay_num_ticks(replay_t *replay) { return replay->num_ticks; }
+
+size_t replay_get_tick(replay_t *replay) { return replay->tick; }
+
+state_t *replay_get_state(replay_t *replay) { return replay->state; }
+
+bool replay_step(replay_t *replay) {
+  if (replay->tick >= replay->num_ticks) {
+    return false;
+  }
+  sim_tick(replay->state, replay->dt, replay->inputs[replay->tick]);
+  replay->tick++;
+  return true;
+}
+
+bool replay_seek(replay_t *replay, size_t tick) {
+  if (tick > replay->num_ticks) {
+    return false;
+  }
+  // the number of keyframes at or before the tick
+  size_t lo = 0;
+  size_t hi = replay->num_keyframes;
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    if (replay->keyframes[mid].tick <= tick) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  // simulating on from the current tick is cheaper than a restore when no
+  // keyframe lies between it and the target
+  bool behind = replay->tick <= tick;
+  if (lo > 0 && (!behind || replay->keyframes[lo - 1].tick > replay->tick)) {
+    keyframe_t keyframe = replay->keyframes[lo - 1];
+    if (!sim_restore(replay->state, keyframe.snapshot)) {
+      return false;
+    }
+    replay->tick = keyframe.tick;
+  } else if (!behind) {
+    sim_free(replay->state);
+    replay->state = sim_init(replay->map, replay->seed, OPPONENT_PLAYER);
+    replay->tick = 0;
+  }
+  while (replay->tick < tick) {
+    replay_step(replay);
+  }
+  return true;
+}
@@ -0,0 +1,132 @@
+#include <math.h>
+
+#include "sat.h"
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#endif
+
+/**
+ * Projects every vertex of a polygon onto the axis (ax, ay) and stores the
+ * smallest and largest projections.
+ */
+static void project(const sat_polygon_t *shape, double ax, double ay,
+                    double *min, double *max) {
+  const double *restrict xs = shape->xs;
+  const double *restrict ys = shape->ys;
+  size_t n = shape->num_vertices;
+  size_t i = 0;
+  double lo = INFINITY;
+  double hi = -INFINITY;
+
+#if defined(__AVX2__)
+  if (n >= 4) {
+    __m256d vax = _mm256_set1_pd(ax);
+    __m256d vay = _mm256_set1_pd(ay);
+    __m256d vlo = _mm256_set1_pd(INFINITY);
+    __m256d vhi = _mm256_set1_pd(-INFINITY);
+    for (; i + 4 <= n; i += 4) {
+      __m256d d = _mm256_add_pd(_mm256_mul_pd(_mm256_loadu_pd(xs + i), vax),
+                                _mm256_mul_pd(_mm256_loadu_pd(ys + i), vay));
+      vlo = _mm256_min_pd(vlo, d);
+      vhi = _mm256_max_pd(vhi, d);
+    }
+    double lanes_lo[4], lanes_hi[4];
+    _mm256_storeu_pd(lanes_lo, vlo);
+    _mm256_storeu_pd(lanes_hi, vhi);
+    for (size_t k = 0; k < 4; k++) {
+      lo = fmin(lo, lanes_lo[k]);
+      hi = fmax(hi, lanes_hi[k]);
+    }
+  }
+#elif defined(__SSE2__)
+  if (n >= 2) {
+    __m128d vax = _mm_set1_pd(ax);
+    __m128d vay = _mm_set1_pd(ay);
+    __m128d vlo = _mm_set1_pd(INFINITY);
+    __m128d vhi = _mm_set1_pd(-INFINITY);
+    for (; i + 2 <= n; i += 2) {
+      __m128d d = _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(xs + i), vax),
+                             _mm_mul_pd(_mm_loadu_pd(ys + i), vay));
+      vlo = _mm_min_pd(vlo, d);
+      vhi = _mm_max_pd(vhi, d);
+    }
+    double lanes_lo[2], lanes_hi[2];
+    _mm_storeu_pd(lanes_lo, vlo);
+    _mm_storeu_pd(lanes_hi, vhi);
+    lo = fmin(lanes_lo[0], lanes_lo[1]);
+    hi = fmax(lanes_hi[0], lanes_hi[1]);
+  }
+#elif defined(__wasm_simd128__)
+  if (n >= 2) {
+    v128_t vax = wasm_f64x2_splat(ax);
+    v128_t vay = wasm_f64x2_splat(ay);
+    v128_t vlo = wasm_f64x2_splat(INFINITY);
+    v128_t vhi = wasm_f64x2_splat(-INFINITY);
+    for (; i + 2 <= n; i += 2) {
+      v128_t d = wasm_f64x2_add(wasm_f64x2_mul(wasm_v128_load(xs + i), vax),
+                                wasm_f64x2_mul(wasm_v128_load(ys + i), vay));
+      vlo = wasm_f64x2_pmin(vlo, d);
+      vhi = wasm_f64x2_pmax(vhi, d);
+    }
+    lo = fmin(wasm_f64x2_extract_lane(vlo, 0), wasm_f64x2_extract_lane(vlo, 1));
+    hi = fmax(wasm_f64x2_extract_lane(vhi, 0), wasm_f64x2_extract_lane(vhi, 1));
+  }
+#endif
+
+  for (; i < n; i++) {
+    double d = xs[i] * ax + ys[i] * ay;
+    lo = fmin(lo, d);
+    hi = fmax(hi, d);
+  }
+  *min = lo;
+  *max = hi;
+}
+
+/**
+ * Tests the edge normals of `axes` as separating axes for the two shapes.
+ * Updates `best_overlap` and `best_axis` with the smallest overlap found.
+ * Zero normals, which a shape with a single vertex has, are skipped: every
+ * projection onto them is 0, which would read as a separation.
+ *
+ * @return false if one of the normals separates the shapes
+ */
+static bool overlap_on_normals(const sat_polygon_t *axes,
+                               const sat_polygon_t *shape1,
+                               const sat_polygon_t *shape2,
+                               double *best_overlap, vector_t *best_axis) {
+  for (size_t i = 0; i < axes->num_vertices; i++) {
+    double ax = axes->normal_xs[i];
+    double ay = axes->normal_ys[i];
+    if (ax == 0 && ay == 0) {
+      continue;
+    }
+    double min1, max1, min2, max2;
+    project(shape1, ax, ay, &min1, &max1);
+    project(shape2, ax, ay, &min2, &max2);
+    double overlap = fmin(max1, max2) - fmax(min1, min2);
+    if (overlap <= 0) {
+      return false;
+    }
+    if (overlap < *best_overlap) {
+      *best_overlap = overlap;
+      *best_axis = (vector_t){ax, ay};
+    }
+  }
+  return true;
+}
+
+collision_info_t sat_find_collision(const sat_polygon_t *shape1,
+                                    const sat_polygon_t *shape2) {
+  collision_info_t info = {.collided = false, .axis = VEC_ZERO};
+  double best_overlap = INFINITY;
+  if (!overlap_on_normals(shape1, shape1, shape2, &best_overlap, &info.axis) ||
+      !overlap_on_normals(shape2, shape1, shape2, &best_overlap, &info.axis)) {
+    info.axis = VEC_ZERO;
+    return info;
+  }
+  info.collided = true;
+  return info;
+}
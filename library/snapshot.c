@@ -0,0 +1,187 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "snapshot.h"
+
+const size_t WORD_SIZE = sizeof(uint64_t);
+const size_t MIN_SNAPSHOT_CAPACITY = 8; // in words
+const uint64_t MAX_RUN = UINT32_MAX;
+// deltas rebuilding anything larger are taken to be corrupt; 128 MiB
+const uint64_t MAX_SNAPSHOT_WORDS = 1 << 24;
+
+struct snapshot {
+  uint64_t *words;
+  size_t num_words;
+  size_t capacity; // in words
+};
+
+static size_t words_for(size_t size) {
+  return (size + WORD_SIZE - 1) / WORD_SIZE;
+}
+
+/**
+ * Grows the snapshot to hold at least `num_words` words.
+ *
+ * @return false, leaving the snapshot as it was, if memory runs out
+ */
+static bool try_reserve(snapshot_t *snapshot, size_t num_words) {
+  if (num_words <= snapshot->capacity) {
+    return true;
+  }
+  size_t capacity = snapshot->capacity * 2;
+  if (capacity < num_words) {
+    capacity = num_words;
+  }
+  uint64_t *words = realloc(snapshot->words, capacity * WORD_SIZE);
+  if (words == NULL) {
+    return false;
+  }
+  snapshot->words = words;
+  snapshot->capacity = capacity;
+  return true;
+}
+
+static void snapshot_reserve(snapshot_t *snapshot, size_t num_words) {
+  bool reserved = try_reserve(snapshot, num_words);
+  assert(reserved);
+}
+
+snapshot_t *snapshot_init(size_t initial_capacity) {
+  snapshot_t *snapshot = malloc(sizeof(snapshot_t));
+  assert(snapshot);
+  snapshot->capacity = words_for(initial_capacity);
+  if (snapshot->capacity < MIN_SNAPSHOT_CAPACITY) {
+    snapshot->capacity = MIN_SNAPSHOT_CAPACITY;
+  }
+  snapshot->words = malloc(snapshot->capacity * WORD_SIZE);
+  assert(snapshot->words);
+  snapshot->num_words = 0;
+  return snapshot;
+}
+
+void snapshot_free(snapshot_t *snapshot) {
+  free(snapshot->words);
+  free(snapshot);
+}
+
+void snapshot_clear(snapshot_t *snapshot) { snapshot->num_words = 0; }
+
+size_t snapshot_size(snapshot_t *snapshot) {
+  return snapshot->num_words * WORD_SIZE;
+}
+
+const void *snapshot_data(snapshot_t *snapshot) { return snapshot->words; }
+
+void snapshot_load(snapshot_t *snapshot, const void *data, size_t size) {
+  assert(size % WORD_SIZE == 0);
+  snapshot_reserve(snapshot, size / WORD_SIZE);
+  memcpy(snapshot->words, data, size);
+  snapshot->num_words = size / WORD_SIZE;
+}
+
+void snapshot_copy(snapshot_t *dest, snapshot_t *src) {
+  snapshot_load(dest, src->words, snapshot_size(src));
+}
+
+void snapshot_write(snapshot_t *snapshot, const void *data, size_t size) {
+  size_t num_words = words_for(size);
+  snapshot_reserve(snapshot, snapshot->num_words + num_words);
+  uint64_t *dest = snapshot->words + snapshot->num_words;
+  // zero the padding so identical fields give identical words
+  if (num_words > 0) {
+    dest[num_words - 1] = 0;
+  }
+  memcpy(dest, data, size);
+  snapshot->num_words += num_words;
+}
+
+bool snapshot_read(snapshot_t *snapshot, size_t *offset, void *data,
+                   size_t size) {
+  size_t num_words = words_for(size);
+  if (*offset % WORD_SIZE != 0 ||
+      *offset / WORD_SIZE + num_words > snapshot->num_words) {
+    return false;
+  }
+  memcpy(data, snapshot->words + *offset / WORD_SIZE, size);
+  *offset += num_words * WORD_SIZE;
+  return true;
+}
+
+static void push_word(snapshot_t *snapshot, uint64_t word) {
+  snapshot_reserve(snapshot, snapshot->num_words + 1);
+  snapshot->words[snapshot->num_words++] = word;
+}
+
+/**
+ * Gets a word of the base, treating anything past its end as zero so a
+ * delta can grow the snapshot.
+ */
+static uint64_t base_word(snapshot_t *base, size_t i) {
+  return i < base->num_words ? base->words[i] : 0;
+}
+
+/*
+ * A delta is the target's length in words, followed by runs. Each run is a
+ * header word holding the number of unchanged words in its high half and
+ * the number of changed words in its low half, followed by the changed
+ * words XORed with the base.
+ */
+void snapshot_delta(snapshot_t *base, snapshot_t *target, snapshot_t *delta) {
+  assert(delta != base && delta != target);
+  snapshot_clear(delta);
+  size_t n = target->num_words;
+  push_word(delta, n);
+  size_t i = 0;
+  while (i < n) {
+    uint64_t unchanged = 0;
+    while (i < n && unchanged < MAX_RUN &&
+           target->words[i] == base_word(base, i)) {
+      unchanged++;
+      i++;
+    }
+    size_t header = delta->num_words;
+    push_word(delta, 0);
+    uint64_t changed = 0;
+    while (i < n && changed < MAX_RUN &&
+           target->words[i] != base_word(base, i)) {
+      push_word(delta, target->words[i] ^ base_word(base, i));
+      changed++;
+      i++;
+    }
+    delta->words[header] = unchanged << 32 | changed;
+  }
+}
+
+bool snapshot_apply_delta(snapshot_t *base, snapshot_t *delta,
+                          snapshot_t *target) {
+  assert(target != base && target != delta);
+  if (delta->num_words == 0 || delta->words[0] > MAX_SNAPSHOT_WORDS ||
+      !try_reserve(target, delta->words[0])) {
+    return false;
+  }
+  size_t n = delta->words[0];
+  target->num_words = n;
+  size_t i = 0;
+  size_t d = 1;
+  while (i < n) {
+    if (d >= delta->num_words) {
+      return false;
+    }
+    uint64_t header = delta->words[d++];
+    size_t unchanged = header >> 32;
+    size_t changed = header & MAX_RUN;
+    if (unchanged + changed > n - i || changed > delta->num_words - d ||
+        unchanged + changed == 0) {
+      return false;
+    }
+    for (size_t end = i + unchanged; i < end; i++) {
+      target->words[i] = base_word(base, i);
+    }
+    for (size_t end = i + changed; i < end; i++) {
+      target->words[i] = delta->words[d++] ^ base_word(base, i);
+    }
+  }
+  return d == delta->num_words;
+}
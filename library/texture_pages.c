@@ -0,0 +1,221 @@
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include "texture_pages.h"
+
+typedef struct page {
+  SDL_Texture *texture;
+  // shelf packing state
+  int shelf_x;
+  int shelf_y;
+  int shelf_height;
+} page_t;
+
+struct texture_pages {
+  SDL_Renderer *renderer;
+  int page_size;
+  int padding;
+  page_t *pages;
+  size_t num_pages;
+
+  // quads waiting to be drawn, all from one page
+  SDL_Vertex *vertices;
+  int *indices;
+  size_t num_quads;
+  size_t quad_capacity;
+  size_t batch_page;
+};
+
+texture_pages_t *texture_pages_init(SDL_Renderer *renderer, int page_size,
+                                    int padding, size_t initial_quads) {
+  assert(initial_quads > 0);
+  texture_pages_t *pages = malloc(sizeof(texture_pages_t));
+  assert(pages);
+  pages->renderer = renderer;
+  pages->page_size = page_size;
+  SDL_RendererInfo info;
+  if (renderer != NULL && SDL_GetRendererInfo(renderer, &info) == 0 &&
+      info.max_texture_width > 0 && info.max_texture_height > 0) {
+    pages->page_size = fmin(pages->page_size, fmin(info.max_texture_width,
+                                                   info.max_texture_height));
+  }
+  pages->padding = padding;
+  pages->pages = NULL;
+  pages->num_pages = 0;
+
+  pages->quad_capacity = initial_quads;
+  pages->vertices = malloc(4 * pages->quad_capacity * sizeof(SDL_Vertex));
+  pages->indices = malloc(6 * pages->quad_capacity * sizeof(int));
+  assert(pages->vertices && pages->indices);
+  pages->num_quads = 0;
+  pages->batch_page = 0;
+  return pages;
+}
+
+void texture_pages_free(texture_pages_t *pages) {
+  for (size_t i = 0; i < pages->num_pages; i++) {
+    SDL_DestroyTexture(pages->pages[i].texture);
+  }
+  free(pages->pages);
+  free(pages->vertices);
+  free(pages->indices);
+  free(pages);
+}
+
+static page_t *add_page(texture_pages_t *pages) {
+  SDL_Texture *texture =
+      SDL_CreateTexture(pages->renderer, SDL_PIXELFORMAT_RGBA32,
+                        SDL_TEXTUREACCESS_STATIC, pages->page_size,
+                        pages->page_size);
+  if (texture == NULL) {
+    return NULL;
+  }
+  SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+  pages->pages =
+      realloc(pages->pages, (pages->num_pages + 1) * sizeof(page_t));
+  assert(pages->pages);
+  page_t *page = &pages->pages[pages->num_pages++];
+  *page = (page_t){
+      .texture = texture, .shelf_x = 0, .shelf_y = 0, .shelf_height = 0};
+  return page;
+}
+
+/**
+ * Finds room for an image on the newest page, starting a new shelf or page
+ * when it runs out.
+ */
+static bool place(texture_pages_t *pages, int width, int height,
+                  size_t *page_index, SDL_Rect *rect) {
+  int padded_width = width + pages->padding;
+  int padded_height = height + pages->padding;
+  if (padded_width > pages->page_size || padded_height > pages->page_size) {
+    return false;
+  }
+  page_t *page =
+      pages->num_pages > 0 ? &pages->pages[pages->num_pages - 1] : NULL;
+  if (page != NULL && page->shelf_x + padded_width > pages->page_size) {
+    page->shelf_y += page->shelf_height;
+    page->shelf_x = 0;
+    page->shelf_height = 0;
+  }
+  if (page == NULL || page->shelf_y + padded_height > pages->page_size) {
+    page = add_page(pages);
+    if (page == NULL) {
+      return false;
+    }
+  }
+
+  *page_index = page - pages->pages;
+  *rect = (SDL_Rect){page->shelf_x, page->shelf_y, width, height};
+  page->shelf_x += padded_width;
+  page->shelf_height = fmax(page->shelf_height, padded_height);
+  return true;
+}
+
+/**
+ * Copies an image into its place on a page. The padding to its right and
+ * below is cleared, since new textures can hold anything.
+ */
+static void upload(texture_pages_t *pages, size_t page, SDL_Rect rect,
+                   SDL_Surface *surface) {
+  SDL_Texture *texture = pages->pages[page].texture;
+  SDL_LockSurface(surface);
+  SDL_UpdateTexture(texture, &rect, surface->pixels, surface->pitch);
+  SDL_UnlockSurface(surface);
+  if (pages->padding == 0) {
+    return;
+  }
+
+  size_t longest = fmax(rect.w, rect.h) + pages->padding;
+  Uint32 *clear = calloc(longest * pages->padding, sizeof(Uint32));
+  assert(clear);
+  SDL_Rect right = {rect.x + rect.w, rect.y, pages->padding,
+                    rect.h + pages->padding};
+  SDL_Rect below = {rect.x, rect.y + rect.h, rect.w, pages->padding};
+  if (right.x + right.w <= pages->page_size &&
+      right.y + right.h <= pages->page_size) {
+    SDL_UpdateTexture(texture, &right, clear,
+                      pages->padding * sizeof(Uint32));
+  }
+  if (below.y + below.h <= pages->page_size) {
+    SDL_UpdateTexture(texture, &below, clear, rect.w * sizeof(Uint32));
+  }
+  free(clear);
+}
+
+bool texture_pages_add(texture_pages_t *pages, SDL_Surface *surface,
+                       size_t *page, SDL_Rect *rect) {
+  if (pages->renderer == NULL || surface->w <= 0 || surface->h <= 0) {
+    return false;
+  }
+  SDL_Surface *converted = NULL;
+  if (surface->format->format != SDL_PIXELFORMAT_RGBA32) {
+    converted = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0);
+    if (converted == NULL) {
+      return false;
+    }
+    surface = converted;
+  }
+  bool placed = place(pages, surface->w, surface->h, page, rect);
+  if (placed) {
+    upload(pages, *page, *rect, surface);
+  }
+  if (converted != NULL) {
+    SDL_FreeSurface(converted);
+  }
+  return placed;
+}
+
+size_t texture_pages_count(texture_pages_t *pages) { return pages->num_pages; }
+
+void texture_pages_begin(texture_pages_t *pages) { pages->num_quads = 0; }
+
+void texture_pages_add_quad(texture_pages_t *pages, size_t page,
+                            SDL_Rect rect, float x0, float y0, float x1,
+                            float y1, SDL_Color color) {
+  assert(page < pages->num_pages);
+  // a page change breaks the batch, so later quads still draw on top
+  if (pages->num_quads > 0 && page != pages->batch_page) {
+    texture_pages_flush(pages);
+  }
+  pages->batch_page = page;
+
+  if (pages->num_quads == pages->quad_capacity) {
+    pages->quad_capacity *= 2;
+    pages->vertices = realloc(pages->vertices,
+                              4 * pages->quad_capacity * sizeof(SDL_Vertex));
+    pages->indices =
+        realloc(pages->indices, 6 * pages->quad_capacity * sizeof(int));
+    assert(pages->vertices && pages->indices);
+  }
+
+  float u0 = (float)rect.x / pages->page_size;
+  float v0 = (float)rect.y / pages->page_size;
+  float u1 = (float)(rect.x + rect.w) / pages->page_size;
+  float v1 = (float)(rect.y + rect.h) / pages->page_size;
+  SDL_Vertex *vertices = pages->vertices + 4 * pages->num_quads;
+  vertices[0] = (SDL_Vertex){{x0, y0}, color, {u0, v0}};
+  vertices[1] = (SDL_Vertex){{x1, y0}, color, {u1, v0}};
+  vertices[2] = (SDL_Vertex){{x1, y1}, color, {u1, v1}};
+  vertices[3] = (SDL_Vertex){{x0, y1}, color, {u0, v1}};
+
+  int first = 4 * (int)pages->num_quads;
+  int *indices = pages->indices + 6 * pages->num_quads;
+  indices[0] = first;
+  indices[1] = first + 1;
+  indices[2] = first + 2;
+  indices[3] = first;
+  indices[4] = first + 2;
+  indices[5] = first + 3;
+  pages->num_quads++;
+}
+
+void texture_pages_flush(texture_pages_t *pages) {
+  if (pages->renderer != NULL && pages->num_quads > 0) {
+    SDL_RenderGeometry(pages->renderer, pages->pages[pages->batch_page].texture,
+                       pages->vertices, 4 * (int)pages->num_quads,
+                       pages->indices, 6 * (int)pages->num_quads);
+  }
+  pages->num_quads = 0;
+}
@@ -0,0 +1,15 @@
+#include "timer.h"
+
+#ifdef __EMSCRIPTEN__
+#include <emscripten.h>
+
+double timer_now(void) { return emscripten_get_now() / 1000; }
+#else
+#include <time.h>
+
+double timer_now(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+#endif
@@ -0,0 +1,199 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "replay.h"
+#include "sim.h"
+#include "snapshot.h"
+
+// run from the repository root, so the maps load
+const char *TEST_RECORDING_PATH = "out/test_replay_recording.replay";
+const char *TEST_CORRUPT_PATH = "out/test_replay_corrupt.replay";
+const unsigned int TEST_SEED = 3;
+const double TEST_DT = 1.0 / 60;
+const size_t TEST_TICKS = 1300; // keyframes at ticks 0, 600 and 1200
+// magic, version, map, seed and dt, as written by replay.c
+const size_t TEST_HEADER_SIZE = 24;
+const uint8_t TEST_INPUT_TAG = 0x10;
+const uint8_t TEST_KEYFRAME_TAG = 0x20;
+
+typedef struct buffer {
+  uint8_t *data;
+  size_t size;
+} buffer_t;
+
+/**
+ * Plays TEST_TICKS ticks of a scripted match on the first map, recording
+ * them to TEST_RECORDING_PATH, and returns the bytes of the recording.
+ */
+buffer_t record_match(void) {
+  state_t *state = sim_init(0, TEST_SEED, OPPONENT_PLAYER);
+  bool recording_started = sim_record(state, TEST_RECORDING_PATH);
+  assert(recording_started);
+  for (size_t tick = 0; tick < TEST_TICKS; tick++) {
+    uint32_t input = (tick / 20) % 3 == 0 ? INPUT_P1_TURN : 0;
+    if (tick % 30 == 0) {
+      input |= INPUT_P2_SHOOT;
+    }
+    sim_tick(state, TEST_DT, input);
+  }
+  sim_free(state);
+
+  FILE *file = fopen(TEST_RECORDING_PATH, "rb");
+  assert(file);
+  fseek(file, 0, SEEK_END);
+  buffer_t recording = {.size = ftell(file)};
+  fseek(file, 0, SEEK_SET);
+  recording.data = malloc(recording.size);
+  assert(recording.data);
+  size_t num_read = fread(recording.data, 1, recording.size, file);
+  assert(num_read == recording.size);
+  fclose(file);
+  return recording;
+}
+
+void write_file(const char *path, const uint8_t *data, size_t size) {
+  FILE *file = fopen(path, "wb");
+  assert(file);
+  size_t num_written = fwrite(data, 1, size, file);
+  assert(num_written == size);
+  fclose(file);
+}
+
+void append_varint(uint8_t *data, size_t *size, uint64_t value) {
+  while (value >= 0x80) {
+    data[(*size)++] = (value & 0x7f) | 0x80;
+    value >>= 7;
+  }
+  data[(*size)++] = value;
+}
+
+/**
+ * Loads a recording's header followed by `records`, and returns the number
+ * of ticks it loaded with.
+ */
+size_t load_with_records(buffer_t recording, const uint8_t *records,
+                         size_t size) {
+  uint8_t *data = malloc(TEST_HEADER_SIZE + size);
+  assert(data);
+  memcpy(data, recording.data, TEST_HEADER_SIZE);
+  memcpy(data + TEST_HEADER_SIZE, records, size);
+  write_file(TEST_CORRUPT_PATH, data, TEST_HEADER_SIZE + size);
+  free(data);
+
+  replay_t *replay = replay_load(TEST_CORRUPT_PATH);
+  assert(replay);
+  size_t num_ticks = replay_num_ticks(replay);
+  assert(replay_seek(replay, num_ticks));
+  replay_free(replay);
+  return num_ticks;
+}
+
+void test_round_trip(void) {
+  replay_t *replay = replay_load(TEST_RECORDING_PATH);
+  assert(replay);
+  assert(replay_num_ticks(replay) == TEST_TICKS);
+  assert(replay_seek(replay, TEST_TICKS));
+  assert(replay_get_tick(replay) == TEST_TICKS);
+  assert(replay_seek(replay, 0));
+  assert(replay_step(replay));
+  assert(replay_get_tick(replay) == 1);
+  assert(!replay_seek(replay, TEST_TICKS + 1));
+  replay_free(replay);
+}
+
+void test_truncated(buffer_t recording) {
+  for (size_t size = 0; size < recording.size; size++) {
+    write_file(TEST_CORRUPT_PATH, recording.data, size);
+    replay_t *replay = replay_load(TEST_CORRUPT_PATH);
+    if (size < TEST_HEADER_SIZE) {
+      assert(replay == NULL);
+      continue;
+    }
+    assert(replay);
+    size_t num_ticks = replay_num_ticks(replay);
+    assert(num_ticks <= TEST_TICKS);
+    assert(replay_seek(replay, num_ticks));
+    replay_free(replay);
+  }
+}
+
+void test_huge_input_runs(buffer_t recording) {
+  uint8_t records[64];
+  size_t size = 0;
+  records[size++] = TEST_INPUT_TAG;
+  append_varint(records, &size, UINT64_MAX);
+  assert(load_with_records(recording, records, size) == 0);
+
+  // a run that would overflow the tick count after an earlier run
+  size = 0;
+  records[size++] = TEST_INPUT_TAG;
+  append_varint(records, &size, 5);
+  records[size++] = TEST_INPUT_TAG | INPUT_P1_TURN;
+  append_varint(records, &size, UINT64_MAX - 2);
+  assert(load_with_records(recording, records, size) == 5);
+
+  // a varint with more than 64 bits
+  size = 0;
+  records[size++] = TEST_INPUT_TAG;
+  for (size_t i = 0; i < 12; i++) {
+    records[size++] = 0xff;
+  }
+  records[size++] = 0x01;
+  assert(load_with_records(recording, records, size) == 0);
+}
+
+void test_huge_keyframe(buffer_t recording) {
+  // a delta claiming to rebuild a snapshot of 2^60 words from 2 words
+  uint64_t delta[2] = {(uint64_t)1 << 60, (uint64_t)1 << 32};
+  uint8_t records[64];
+  size_t size = 0;
+  records[size++] = TEST_KEYFRAME_TAG;
+  append_varint(records, &size, 0);
+  append_varint(records, &size, sizeof(delta));
+  memcpy(records + size, delta, sizeof(delta));
+  size += sizeof(delta);
+  records[size++] = TEST_INPUT_TAG;
+  append_varint(records, &size, 10);
+  // the keyframe is rejected, and with it everything after it
+  assert(load_with_records(recording, records, size) == 0);
+
+  snapshot_t *base = snapshot_init(0);
+  snapshot_t *bad_delta = snapshot_init(0);
+  snapshot_t *target = snapshot_init(0);
+  snapshot_write(bad_delta, delta, sizeof(delta));
+  assert(!snapshot_apply_delta(base, bad_delta, target));
+  snapshot_free(base);
+  snapshot_free(bad_delta);
+  snapshot_free(target);
+}
+
+void test_corrupt_bytes(buffer_t recording) {
+  uint8_t *data = malloc(recording.size);
+  assert(data);
+  for (size_t i = TEST_HEADER_SIZE; i < recording.size; i++) {
+    memcpy(data, recording.data, recording.size);
+    data[i] ^= 0xff;
+    write_file(TEST_CORRUPT_PATH, data, recording.size);
+    replay_t *replay = replay_load(TEST_CORRUPT_PATH);
+    assert(replay);
+    replay_free(replay);
+  }
+  free(data);
+}
+
+int main(int argc, char *argv[]) {
+  buffer_t recording = record_match();
+  test_round_trip();
+  test_truncated(recording);
+  test_huge_input_runs(recording);
+  test_huge_keyframe(recording);
+  test_corrupt_bytes(recording);
+  free(recording.data);
+  remove(TEST_RECORDING_PATH);
+  remove(TEST_CORRUPT_PATH);
+  puts("replay_test PASS");
+}